@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "python_engine.h"
+
+#ifdef LUMOS_BENCHMARK_JSON
+#include <QJsonArray>
+#include <QJsonValue>
+#include <QStringList>
+#include "json_to_python.h"
+#endif
+
+namespace {
+
+// Per-call stdout redirection as PythonEngine did it before output capture was
+// installed once; kept here as the baseline the native streams are measured against
+std::string evaluateWithStringIO(PythonEngine& engine, const std::string& command) {
+    PyObject* io_module = PyImport_ImportModule("io");
+    PyObject* string_io = PyObject_CallMethod(io_module, "StringIO", NULL);
+    PyObject* sys_module = PyImport_ImportModule("sys");
+    PyObject* old_stdout = PyObject_GetAttrString(sys_module, "stdout");
+    PyObject* old_stderr = PyObject_GetAttrString(sys_module, "stderr");
+    PyObject_SetAttrString(sys_module, "stdout", string_io);
+    PyObject_SetAttrString(sys_module, "stderr", string_io);
+    
+    std::string output = engine.evaluateExpression(command);
+    
+    PyObject* captured_output = PyObject_CallMethod(string_io, "getvalue", NULL);
+    if (captured_output) {
+        const char* captured_str = PyUnicode_AsUTF8(captured_output);
+        if (captured_str) {
+            output.insert(0, captured_str);
+        }
+        Py_DECREF(captured_output);
+    }
+    
+    PyObject_SetAttrString(sys_module, "stdout", old_stdout);
+    PyObject_SetAttrString(sys_module, "stderr", old_stderr);
+    Py_DECREF(old_stdout);
+    Py_DECREF(old_stderr);
+    Py_DECREF(string_io);
+    Py_DECREF(sys_module);
+    Py_DECREF(io_module);
+    return output;
+}
+
+template <typename Function>
+double nanosecondsPerCall(int iterations, Function&& function) {
+    // Warm up the code cache and any lazily created objects
+    for (int i = 0; i < iterations / 10 + 1; ++i) {
+        function();
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        function();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+// Loop iterations per second of a pure-Python loop run as a user command
+double measureComputation(PythonEngine& engine, double seconds) {
+    std::string command =
+        "import time\n"
+        "n = 0\n"
+        "end = time.perf_counter() + " + std::to_string(seconds) + "\n"
+        "while time.perf_counter() < end:\n"
+        "    n += 1\n"
+        "n";
+    std::string result = engine.evaluateExpression(command);
+    return std::atof(result.c_str()) / seconds;
+}
+
+// Injections per second from `threads` ingest threads, each binding a
+// 1000-element list the way the TCP server does
+class IngestLoad {
+public:
+    IngestLoad(PythonEngine& engine, int threads) : engine(engine), threadCount(threads) {
+        std::string items;
+        for (int i = 0; i < 1000; ++i) {
+            items += (i ? ", " : "") + std::to_string(i);
+        }
+        payload = "[" + items + "]";
+    }
+    
+    void start() {
+        running = true;
+        completed = 0;
+        startTime = std::chrono::steady_clock::now();
+        for (int t = 0; t < threadCount; ++t) {
+            threads.emplace_back([this, t]() { ingestLoop(t); });
+        }
+    }
+    
+    double stop() {
+        running = false;
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        threads.clear();
+        
+        // Let queued injections drain so the next measurement starts clean
+        engine.evaluateExpression("None");
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+        return completed / elapsed.count();
+    }
+    
+private:
+    void ingestLoop(int index) {
+        std::string name = "ingest_" + std::to_string(index);
+        while (running) {
+            // With a GIL ingest jobs queue up; keep a few in flight per thread
+            if (inFlight >= 4 * threadCount) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+                continue;
+            }
+            ++inFlight;
+            engine.postIngest([this, name]() {
+                std::string error;
+                engine.setVariable(name, payload, error);
+                ++completed;
+                --inFlight;
+            });
+        }
+    }
+    
+    PythonEngine& engine;
+    int threadCount;
+    std::string payload;
+    std::vector<std::thread> threads;
+    std::atomic<bool> running{false};
+    std::atomic<int> inFlight{0};
+    std::atomic<uint64_t> completed{0};
+    std::chrono::steady_clock::time_point startTime;
+};
+
+#ifdef LUMOS_BENCHMARK_JSON
+// Python source for a JSON list as TCPServer::injectPythonVariable built it
+// before values were converted natively; kept as the baseline
+std::string legacyListLiteral(const QJsonArray& array) {
+    QStringList items;
+    for (const QJsonValue& value : array) {
+        if (value.isString()) {
+            items.append("'" + value.toString() + "'");
+        } else {
+            items.append(QString::number(value.toDouble()));
+        }
+    }
+    return ("[" + items.join(", ") + "]").toStdString();
+}
+
+// Best of a few runs, in milliseconds
+template <typename Function>
+double bestMilliseconds(int runs, Function&& function) {
+    double best = 0.0;
+    for (int i = 0; i < runs; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        best = (i == 0) ? elapsed : std::min(best, elapsed);
+    }
+    return best;
+}
+
+void benchmarkJsonInjection(PythonEngine& engine, int elements) {
+    QJsonArray floats;
+    QJsonArray integers;
+    for (int i = 0; i < elements; ++i) {
+        floats.append(i * 0.001 + 0.5);
+        integers.append(i);
+    }
+    
+    std::cout << std::endl << "JSON list injection, " << elements << " elements" << std::endl;
+    std::cout << std::left << std::setw(12) << "values"
+              << std::right << std::setw(16) << "native ms"
+              << std::setw(18) << "source ms" << std::endl;
+    
+    engine.run([&]() {
+        const std::pair<const char*, const QJsonArray*> inputs[] = {{"float", &floats}, {"int", &integers}};
+        for (const auto& input : inputs) {
+            std::string error;
+            double native = bestMilliseconds(3, [&]() {
+                PyObject* object = jsonToPython(*input.second);
+                engine.setVariable("injected", object, error);
+                Py_XDECREF(object);
+            });
+            double source = bestMilliseconds(3, [&]() {
+                engine.setVariable("injected", legacyListLiteral(*input.second), error);
+            });
+            
+            std::cout << std::left << std::setw(12) << input.first
+                      << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(16) << native
+                      << std::setw(18) << source << std::endl;
+        }
+    });
+}
+#endif
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int iterations = 100000;
+    if (argc > 1) {
+        iterations = std::max(1, std::atoi(argv[1]));
+    }
+    int ingestThreads = 2;
+    if (argc > 2) {
+        ingestThreads = std::max(1, std::atoi(argv[2]));
+    }
+    
+    PythonEngine engine;
+    if (!engine.initialize()) {
+        std::cerr << "Failed to initialize Python engine" << std::endl;
+        return 1;
+    }
+    
+    std::cout << "Startup" << std::endl;
+    for (const PythonEngine::StartupPhase& phase : engine.getStartupTrace()) {
+        std::cout << std::left << std::setw(20) << phase.name
+                  << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << phase.milliseconds << " ms" << std::endl;
+    }
+    std::cout << std::endl;
+    
+    engine.evaluateExpression("x = 1");
+    
+    const std::vector<std::string> commands = {
+        "1 + 1",
+        "x = 1",
+        "print(1)",
+        "x"
+    };
+    
+    std::cout << "PythonEngine::evaluateExpression, " << iterations << " iterations" << std::endl;
+    std::cout << std::left << std::setw(12) << "command"
+              << std::right << std::setw(16) << "native ns/op"
+              << std::setw(18) << "StringIO ns/op" << std::endl;
+    
+    // Time on the interpreter thread itself so the queue hand-off is not measured
+    engine.run([&]() {
+        for (const std::string& command : commands) {
+            double native = nanosecondsPerCall(iterations, [&]() { engine.evaluateExpression(command); });
+            double legacy = nanosecondsPerCall(iterations, [&]() { evaluateWithStringIO(engine, command); });
+            
+            std::cout << std::left << std::setw(12) << command
+                      << std::right << std::fixed << std::setprecision(0)
+                      << std::setw(16) << native
+                      << std::setw(18) << legacy << std::endl;
+        }
+    });
+    
+    // Round trip from another thread through the job queue
+    double queued = nanosecondsPerCall(iterations / 10 + 1, [&]() { engine.evaluateExpression("1 + 1"); });
+    std::cout << std::left << std::setw(12) << "queued 1 + 1"
+              << std::right << std::setw(16) << queued << std::endl;
+    
+    // Ingest next to a running command: with a GIL both share one core's
+    // worth of interpreter time, free-threaded builds should keep both rates.
+    // Ingest must not stall behind the command, so a collapse fails the run.
+    std::cout << std::endl << "Ingest and computation, " << ingestThreads << " ingest threads ("
+              << (PythonEngine::isFreeThreaded() ? "free-threaded" : "GIL") << " build)" << std::endl;
+    
+    const double seconds = 1.0;
+    IngestLoad ingest(engine, ingestThreads);
+    
+    double computeAlone = measureComputation(engine, seconds);
+    
+    ingest.start();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    double ingestAlone = ingest.stop();
+    
+    ingest.start();
+    double computeShared = measureComputation(engine, seconds);
+    double ingestShared = ingest.stop();
+    
+    std::cout << std::left << std::setw(12) << ""
+              << std::right << std::setw(16) << "alone"
+              << std::setw(18) << "together" << std::endl;
+    std::cout << std::left << std::setw(12) << "loops/s"
+              << std::right << std::setw(16) << computeAlone
+              << std::setw(18) << computeShared << std::endl;
+    std::cout << std::left << std::setw(12) << "ingests/s"
+              << std::right << std::setw(16) << ingestAlone
+              << std::setw(18) << ingestShared << std::endl;
+    
+#ifdef LUMOS_BENCHMARK_JSON
+    benchmarkJsonInjection(engine, 1000000);
+#endif
+    
+    engine.finalize();
+    
+    const double minimumSharedIngest = 0.1;
+    if (ingestShared < minimumSharedIngest * ingestAlone) {
+        std::cerr << "Ingest collapsed while a command ran: " << ingestShared
+                  << "/s against " << ingestAlone << "/s alone" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""
+Freeze the Python standard library into a C source file.
+
+Every module under Lib is compiled to a code object, marshalled and written
+out as a byte array, together with the `struct _frozen` table that
+PythonEngine hands to PyImport_FrozenModules. The interpreter then imports the
+standard library from the binary without scanning directories or compiling
+.py files.
+
+Must run with the same Python version that is linked into the application,
+since marshalled code objects are version specific.
+
+Usage:
+    python freeze_stdlib.py <path to Lib> <output .c file>
+"""
+
+import marshal
+import os
+import sys
+
+# Not needed in an embedded REPL, or large and rarely used
+EXCLUDED = {
+    "test", "tests", "idle_test", "idlelib", "tkinter", "turtledemo", "turtle",
+    "ensurepip", "lib2to3", "pydoc_data", "site-packages", "__phello__",
+    "__pycache__",
+}
+
+
+def module_files(lib_dir):
+    """Yield (module name, path, is_package) for every module under lib_dir."""
+    for root, dirs, files in os.walk(lib_dir):
+        dirs[:] = sorted(d for d in dirs if d not in EXCLUDED and d.isidentifier()
+                         and os.path.exists(os.path.join(root, d, "__init__.py")))
+        package = os.path.relpath(root, lib_dir).replace(os.sep, ".")
+        package = "" if package == "." else package
+
+        for name in sorted(files):
+            stem, ext = os.path.splitext(name)
+            if ext != ".py" or stem in EXCLUDED or not stem.isidentifier():
+                continue
+            if stem == "__init__":
+                if package:
+                    yield package, os.path.join(root, name), True
+                continue
+            yield (package + "." + stem if package else stem), os.path.join(root, name), False
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__)
+        sys.exit(1)
+
+    lib_dir, output = sys.argv[1], sys.argv[2]
+    entries = []
+    total = 0
+
+    with open(output + ".tmp", "w") as out:
+        out.write("/* Generated by freeze_stdlib.py from the Python %d.%d standard library. Do not edit. */\n"
+                  % sys.version_info[:2])
+        out.write("#include <Python.h>\n\n")
+
+        for index, (module, path, is_package) in enumerate(module_files(lib_dir)):
+            with open(path, "rb") as source_file:
+                source = source_file.read()
+            try:
+                code = compile(source, "<frozen %s>" % module, "exec", dont_inherit=True)
+            except (SyntaxError, ValueError) as e:
+                print("freeze_stdlib: skipping %s (%s)" % (module, e), file=sys.stderr)
+                continue
+
+            data = marshal.dumps(code)
+            total += len(data)
+            symbol = "frozen_%d" % index
+            entries.append((module, symbol, is_package))
+
+            out.write("static const unsigned char %s[] = {\n" % symbol)
+            for offset in range(0, len(data), 32):
+                out.write(",".join(str(b) for b in data[offset:offset + 32]) + ",\n")
+            out.write("};\n")
+
+        out.write("\nconst struct _frozen lumosFrozenStdlib[] = {\n")
+        for module, symbol, is_package in entries:
+            out.write('    {"%s", %s, (int)sizeof(%s), %d},\n' % (module, symbol, symbol, int(is_package)))
+        out.write("    {0, 0, 0, 0}\n};\n")
+
+    os.replace(output + ".tmp", output)
+    print("freeze_stdlib: %d modules, %.1f MB of bytecode" % (len(entries), total / 1e6))
+
+
+if __name__ == "__main__":
+    main()
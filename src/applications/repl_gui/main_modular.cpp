@@ -1,5 +1,8 @@
 #include <QApplication>
+#include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QStandardPaths>
 #include <QStyleFactory>
 #include <csignal>
@@ -18,6 +21,9 @@ void signalHandler(int signal) {
 }
 
 int main(int argc, char *argv[]) {
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+    
     QApplication app(argc, argv);
     g_app = &app;
     
@@ -40,6 +46,11 @@ int main(int argc, char *argv[]) {
     MainWindow window;
     window.show();
     
+    // Runs once the first frame with the prompt has been queued for painting
+    QTimer::singleShot(0, [&startupTimer]() {
+        qCDebug(lcStartup) << "Time to first prompt:" << startupTimer.elapsed() << "ms";
+    });
+    
     int result = app.exec();
     
     // Clean up
@@ -7,10 +7,16 @@ Usage:
 2. Run this script: python3 test_debug_api.py
 """
 
+import base64
+import os
+import shutil
 import socket
 import json
+import struct
+import tempfile
 import time
 import sys
+import threading
 
 def send_debug_command(command_dict, timeout=5):
     """Send a debug command and return the response."""
@@ -179,6 +185,297 @@ def test_error_handling():
     
     return True
 
+def test_mixed_special_lines():
+    """Test that special commands and Python lines in one request run in order."""
+    print("\nTesting mixed special and Python lines...")
+    
+    response = send_debug_command({"command": "execute", "code": "mixed_probe = 41\nls\nmixed_probe + 1\nclear vars\n'mixed_probe' in globals()"})
+    result = response.get("result", "") if response else ""
+    lines = result.splitlines()
+    try:
+        in_order = ">>> ls" in lines and lines[lines.index(">>> mixed_probe + 1") + 1] == "42" and lines[-1] == "False"
+    except (ValueError, IndexError):
+        in_order = False
+    if in_order:
+        print("✓ Lines ran in order")
+        return True
+    
+    print(f"✗ Unexpected result: {result!r}")
+    return False
+
+def inject_data(message, timeout=10):
+    """Send an inject_data message to the data port and return the response."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.settimeout(timeout)
+    
+    try:
+        sock.connect(('127.0.0.1', 8080))
+        sock.send(json.dumps(message).encode())
+        response = sock.recv(4096).decode()
+        return json.loads(response)
+    except Exception as e:
+        print(f"ERROR: {e}")
+        return None
+    finally:
+        sock.close()
+
+def test_threading_model():
+    """Test that the GUI and data injection keep working while Python runs."""
+    print("\nTesting threading model...")
+    
+    # Keep the interpreter busy for two seconds
+    busy = {}
+    worker = threading.Thread(target=lambda: busy.update(
+        response=send_debug_command({"command": "execute", "code": "import time; time.sleep(2)"}, timeout=10)))
+    worker.start()
+    time.sleep(0.3)
+    
+    # The GUI thread does not wait for Python
+    start = time.time()
+    response = send_debug_command({"command": "ping"})
+    ping_time = time.time() - start
+    if response and response.get("status") == "success" and ping_time < 0.5:
+        print(f"✓ Ping answered in {ping_time * 1000:.0f} ms while Python was busy")
+    else:
+        print(f"✗ Ping blocked by running command ({ping_time:.2f} s)")
+        worker.join()
+        return False
+    
+    # Injection does not wait for the running command to end
+    start = time.time()
+    response = inject_data({"command": "inject_data", "name": "threading_probe", "data": {"list": [1, 2, 3]}})
+    inject_time = time.time() - start
+    worker.join()
+    if not response or not response.get("success"):
+        print(f"✗ Injection during running command failed: {response}")
+        return False
+    if inject_time >= 1.0:
+        print(f"✗ Injection waited for the running command ({inject_time:.2f} s)")
+        return False
+    if not busy.get("response") or busy["response"].get("status") != "success":
+        print("✗ Long-running command failed")
+        return False
+    
+    response = send_debug_command({"command": "get_variables"})
+    variables = response.get("variables", []) if response else []
+    if any(var.get("name") == "threading_probe" for var in variables):
+        print("✓ Injection during running command applied")
+        return True
+    
+    print("✗ Injected variable not found")
+    return False
+
+def test_stream_interning():
+    """Test that a stream announced with a stream_id can send data by id alone."""
+    print("\nTesting stream interning...")
+    
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.settimeout(10)
+    try:
+        sock.connect(('127.0.0.1', 8080))
+        replies = []
+        for message in [
+            {"command": "inject_data", "stream_id": 3, "name": "interned_probe", "type": "int_list", "data": {"list": [1]}},
+            {"command": "inject_data", "stream_id": 3, "data": {"list": [2]}},
+            {"command": "inject_data", "stream_id": 4, "data": {"list": [3]}},
+        ]:
+            sock.send(json.dumps(message).encode())
+            replies.append(json.loads(sock.recv(4096).decode()))
+    except Exception as e:
+        print(f"ERROR: {e}")
+        return False
+    finally:
+        sock.close()
+    
+    response = send_debug_command({"command": "execute", "code": "interned_probe"})
+    result = response.get("result", "").strip() if response else ""
+    if replies[1].get("success") and not replies[2].get("success") and result == "[2]":
+        print("✓ Interned stream resolved, unknown stream id refused")
+        return True
+    
+    print(f"✗ Unexpected results: {replies!r}, {result!r}")
+    return False
+
+def test_array_injection():
+    """Test that numeric arrays arrive as buffer-backed lumos.Array objects."""
+    print("\nTesting array injection...")
+    
+    samples = [0.5, 1.5, -2.25, 1e-9]
+    messages = {
+        "array_from_list": {"array": samples, "dtype": "float64"},
+        "array_from_bytes": {"array": base64.b64encode(struct.pack("<4d", *samples)).decode(), "dtype": "float64"},
+    }
+    for name, data in messages.items():
+        response = inject_data({"command": "inject_data", "name": name, "data": data})
+        if not response or not response.get("success"):
+            print(f"✗ Injecting {name} failed: {response}")
+            return False
+        
+        response = send_debug_command({"command": "execute",
+                                       "code": f"m = memoryview({name}); (m.format, m.tolist())"})
+        result = response.get("result", "").strip() if response else ""
+        if result != f"('d', {samples!r})":
+            print(f"✗ {name} read back as {result!r}")
+            return False
+    print("✓ Arrays readable through memoryview without conversion")
+    
+    response = inject_data({"command": "inject_data", "name": "bad_array",
+                            "data": {"array": [1, 2], "dtype": "complex128"}})
+    if not response or response.get("success"):
+        print("✗ Unsupported dtype accepted")
+        return False
+    print("✓ Unsupported dtype rejected")
+    
+    invalid = {
+        "negative unsigned": {"array": [1, -1], "dtype": "uint8"},
+        "out of range": {"array": [1, 300], "dtype": "int8"},
+        "fraction": {"array": [1, 2.5], "dtype": "int32"},
+        "not a number": {"array": [1, "2"], "dtype": "float64"},
+        "bad base64": {"array": "not*base64!", "dtype": "uint8"},
+    }
+    for case, data in invalid.items():
+        response = inject_data({"command": "inject_data", "name": "bad_array", "data": data})
+        if not response or response.get("success"):
+            print(f"✗ Array with {case} element accepted: {response}")
+            return False
+    
+    response = inject_data({"command": "inject_data", "name": "big_int64",
+                            "data": {"array": [2**53 + 1], "dtype": "int64"}})
+    response = send_debug_command({"command": "execute", "code": "big_int64.tolist()"})
+    result = response.get("result", "").strip() if response else ""
+    if result != f"[{2**53 + 1}]":
+        print(f"✗ int64 element read back as {result!r}")
+        return False
+    print("✓ Invalid elements rejected, int64 kept exact")
+    return True
+
+def test_lumos_module():
+    """Test stream access and ingest control through the built-in lumos module."""
+    print("\nTesting lumos module...")
+    
+    for value in (1, 2, 3):
+        inject_data({"command": "inject_data", "name": "lumos_probe", "data": {"number": value}})
+    
+    response = send_debug_command({"command": "execute",
+                                   "code": "import lumos; (lumos.get_latest('lumos_probe'), "
+                                           "lumos.stats('lumos_probe')['messages'] >= 3)"})
+    result = response.get("result", "").strip() if response else ""
+    if result != "(3, True)":
+        print(f"✗ Stream not visible through lumos: {result!r}")
+        return False
+    print("✓ Latest value and stats available")
+    
+    send_debug_command({"command": "execute", "code": "lumos.pause()"})
+    paused = inject_data({"command": "inject_data", "name": "lumos_probe", "data": {"number": 4}})
+    send_debug_command({"command": "execute", "code": "lumos.resume()"})
+    if paused and not paused.get("success"):
+        print("✓ Injection refused while paused")
+        return True
+    
+    print(f"✗ Injection accepted while paused: {paused}")
+    return False
+
+def test_bounded_repr():
+    """Test that large variables are listed with a cut repr."""
+    print("\nTesting bounded variable repr...")
+    
+    send_debug_command({"command": "execute", "code": "repr_probe = list(range(10**6))"})
+    started = time.time()
+    response = send_debug_command({"command": "get_variables"})
+    elapsed = time.time() - started
+    variables = response.get("variables", []) if response else []
+    send_debug_command({"command": "execute", "code": "del repr_probe"})
+    
+    probe = next((var for var in variables if var.get("name") == "repr_probe"), None)
+    if not probe:
+        print("✗ Variable not listed")
+        return False
+    value = probe.get("value", "")
+    if value.startswith("[0, 1, 2") and value.endswith("...") and len(value) < 2000:
+        print(f"✓ Repr cut at {len(value)} characters in {elapsed * 1000:.0f} ms")
+        return True
+    
+    print(f"✗ Unexpected repr of {len(value)} characters: {value[:80]!r}")
+    return False
+
+def test_numeric_summary():
+    """Test the count, range and mean reported for numeric containers."""
+    print("\nTesting numeric summaries...")
+    
+    send_debug_command({"command": "execute",
+                        "code": "summary_probe = [float(i) for i in range(1000)]; "
+                                "nan_probe = [float('nan'), 1.0, 3.0, float('nan')] * 10"})
+    response = send_debug_command({"command": "get_variables"})
+    variables = response.get("variables", []) if response else []
+    send_debug_command({"command": "execute", "code": "del summary_probe, nan_probe"})
+    
+    summaries = {var.get("name"): var.get("summary") for var in variables}
+    expected = {
+        "summary_probe": {"count": 1000, "min": 0.0, "max": 999.0, "mean": 499.5},
+        "nan_probe": {"count": 40, "min": 1.0, "max": 3.0, "mean": 2.0, "nan_count": 20},
+    }
+    for name, summary in expected.items():
+        if summaries.get(name) != summary:
+            print(f"✗ Unexpected summary of {name}: {summaries.get(name)}")
+            return False
+    print("✓ Summary reported, NaNs counted and left out")
+    return True
+
+def test_save_load():
+    """Test a save and load round trip through the pickle files."""
+    print("\nTesting save and load...")
+    
+    # Absolute paths keep the files out of the workspace directory
+    directory = tempfile.mkdtemp(prefix="lumos_test_")
+    path = os.path.join(directory, "save_load_probe")
+    saved = loaded = response = None
+    try:
+        send_debug_command({"command": "execute", "code": "save_probe = list(range(100000))"})
+        saved = send_debug_command({"command": "execute", "code": f"save save_probe {path}"}, timeout=30)
+        send_debug_command({"command": "execute", "code": "del save_probe"})
+        loaded = send_debug_command({"command": "execute", "code": f"load {path}"}, timeout=30)
+        response = send_debug_command({"command": "execute", "code": "len(save_probe)"})
+        send_debug_command({"command": "execute", "code": "del save_probe"})
+    finally:
+        shutil.rmtree(directory, ignore_errors=True)
+    
+    saved_text = saved.get("result", "") if saved else ""
+    loaded_text = loaded.get("result", "") if loaded else ""
+    result = response.get("result", "") if response else ""
+    if 'Saved variable "save_probe"' in saved_text and "Loaded 1 variables" in loaded_text and "100000" in result:
+        print("✓ Variable restored from file")
+        return True
+    
+    print(f"✗ Unexpected results: {saved_text!r}, {loaded_text!r}, {result!r}")
+    return False
+
+def test_columnar_file():
+    """Test that numeric arrays saved to a .lumos file load as mapped views."""
+    print("\nTesting columnar files...")
+    
+    directory = tempfile.mkdtemp(prefix="lumos_test_")
+    path = os.path.join(directory, "columnar_probe.lumos")
+    saved = response = None
+    try:
+        send_debug_command({"command": "execute", "code": "import array; columnar_probe = array.array('d', range(1000))"})
+        saved = send_debug_command({"command": "execute", "code": f"save columnar_probe {path}"}, timeout=30)
+        send_debug_command({"command": "execute", "code": "del columnar_probe"})
+        send_debug_command({"command": "execute", "code": f"load {path}"}, timeout=30)
+        response = send_debug_command({"command": "execute", "code": "type(columnar_probe).__name__, columnar_probe[999]"})
+        # Drop the view before its file goes
+        send_debug_command({"command": "execute", "code": "del columnar_probe"})
+    finally:
+        shutil.rmtree(directory, ignore_errors=True)
+    
+    saved_text = saved.get("result", "") if saved else ""
+    result = response.get("result", "") if response else ""
+    if 'Saved variable "columnar_probe"' in saved_text and "('Array', 999.0)" in result:
+        print("✓ Array restored as a view of the file")
+        return True
+    
+    print(f"✗ Unexpected results: {saved_text!r}, {result!r}")
+    return False
+
 def run_comprehensive_test():
     """Run a comprehensive test with realistic usage."""
     print("\nRunning comprehensive test...")
@@ -231,6 +528,15 @@ def main():
         test_input_text,
         test_output_management,
         test_error_handling,
+        test_mixed_special_lines,
+        test_threading_model,
+        test_stream_interning,
+        test_array_injection,
+        test_lumos_module,
+        test_bounded_repr,
+        test_numeric_summary,
+        test_save_load,
+        test_columnar_file,
         run_comprehensive_test,
     ]
     
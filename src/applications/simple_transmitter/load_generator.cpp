@@ -0,0 +1,373 @@
+#include "load_generator.h"
+#include "../../modules/tcp_client/tcp_client.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+uint64_t wallClockNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Returns true once the bytes received so far form one complete JSON object
+bool isCompleteJsonObject(const std::string& data) {
+    int depth = 0;
+    bool in_string = false;
+    bool escaped = false;
+    bool seen_object = false;
+
+    for (char c : data) {
+        if (in_string) {
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                in_string = false;
+            }
+            continue;
+        }
+
+        if (c == '"') {
+            in_string = true;
+        } else if (c == '{') {
+            depth++;
+            seen_object = true;
+        } else if (c == '}') {
+            depth--;
+        }
+    }
+
+    return seen_object && depth == 0;
+}
+
+}  // namespace
+
+double LoadGeneratorReport::messagesPerSecond() const {
+    return elapsed_s > 0.0 ? messages_sent / elapsed_s : 0.0;
+}
+
+double LoadGeneratorReport::megabytesPerSecond() const {
+    return elapsed_s > 0.0 ? bytes_sent / elapsed_s / (1024.0 * 1024.0) : 0.0;
+}
+
+double LoadGeneratorReport::latencyPercentile(double percentile) const {
+    if (latencies_ms.empty()) {
+        return 0.0;
+    }
+
+    // Nearest-rank percentile on the sorted samples
+    size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * latencies_ms.size()));
+    rank = std::clamp<size_t>(rank, 1, latencies_ms.size());
+    return latencies_ms[rank - 1];
+}
+
+JsonConnection::JsonConnection(const std::string& host, int port, int timeout_ms)
+    : host(host), port(port), timeout_ms(timeout_ms), socket_fd(-1) {
+}
+
+JsonConnection::~JsonConnection() {
+    disconnect();
+}
+
+bool JsonConnection::connect() {
+    socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (socket_fd < 0) {
+        return false;
+    }
+
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) <= 0 ||
+        ::connect(socket_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+void JsonConnection::disconnect() {
+    if (socket_fd >= 0) {
+        close(socket_fd);
+        socket_fd = -1;
+    }
+}
+
+bool JsonConnection::exchange(const std::string& request, std::string& reply) {
+    if (socket_fd < 0 && !connect()) {
+        return false;
+    }
+
+    if (send(socket_fd, request.c_str(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+        disconnect();
+        return false;
+    }
+
+    // Replies are not delimited, so read until one full object arrived
+    reply.clear();
+    char buffer[4096];
+    while (!isCompleteJsonObject(reply)) {
+        ssize_t n = recv(socket_fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            disconnect();
+            return false;
+        }
+        reply.append(buffer, n);
+    }
+    return true;
+}
+
+LoadGenerator::LoadGenerator(const LoadGeneratorConfig& config)
+    : config(config), running(false), messages_sent(0), messages_failed(0), bytes_sent(0) {
+}
+
+LoadGeneratorReport LoadGenerator::run() {
+    LoadGeneratorReport report;
+
+    messages_sent.store(0);
+    messages_failed.store(0);
+    bytes_sent.store(0);
+    running.store(true);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Each sender keeps its own samples; merged once they are done
+    std::vector<std::vector<double>> latencies(config.connections);
+    std::vector<std::thread> senders;
+    for (int i = 0; i < config.connections; ++i) {
+        senders.emplace_back(&LoadGenerator::senderLoop, this, i, std::ref(latencies[i]));
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(config.duration_s));
+    running.store(false);
+
+    for (auto& sender : senders) {
+        sender.join();
+    }
+
+    report.elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report.messages_sent = messages_sent.load();
+    report.messages_failed = messages_failed.load();
+    report.bytes_sent = bytes_sent.load();
+    for (const auto& samples : latencies) {
+        report.latencies_ms.insert(report.latencies_ms.end(), samples.begin(), samples.end());
+    }
+    std::sort(report.latencies_ms.begin(), report.latencies_ms.end());
+
+    return report;
+}
+
+void LoadGenerator::senderLoop(int connection_index, std::vector<double>& latencies_ms) {
+    std::string stream_name = "bench_" + std::to_string(connection_index);
+    auto interval = config.rate > 0.0
+        ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / config.rate))
+        : std::chrono::steady_clock::duration::zero();
+    auto next_send = std::chrono::steady_clock::now();
+
+    // One persistent connection per sender thread, of the kind the mode uses
+    std::unique_ptr<TCPClient> client;
+    std::unique_ptr<JsonConnection> connection;
+    TCPClient::StreamId stream = 0;
+    if (config.use_streams) {
+        client = std::make_unique<TCPClient>(config.host, config.port);
+        stream = client->openStream(stream_name, config.message_type);
+    } else {
+        connection = std::make_unique<JsonConnection>(config.host, config.port, config.reply_timeout_ms);
+    }
+
+    for (uint64_t seq = 0; running.load(); ++seq) {
+        size_t bytes = 0;
+        bool sent = false;
+        if (client) {
+            std::string payload = buildPayload(seq);
+            sent = (client->isConnected() || client->connect()) && client->sendStreamPayload(stream, payload);
+            bytes = 2 * sizeof(uint32_t) + payload.size();
+            if (!sent) {
+                client->disconnect();
+            }
+        } else {
+            // The reply comes once the frame is bound, so the wait for it is
+            // the latency of the timestamp the header carries
+            auto sent_at = std::chrono::steady_clock::now();
+            sent = injectFrame(*connection, stream_name, config.message_type, buildData(seq),
+                               wallClockNanoseconds(), bytes);
+            if (sent && config.measure_latency) {
+                latencies_ms.push_back(std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - sent_at).count());
+            }
+        }
+
+        if (sent) {
+            messages_sent++;
+            bytes_sent += bytes;
+        } else {
+            messages_failed++;
+        }
+
+        // Open-loop schedule so a slow send does not lower the offered rate
+        if (interval.count() > 0) {
+            next_send += interval;
+            std::this_thread::sleep_until(next_send);
+        }
+    }
+}
+
+bool LoadGenerator::injectFrame(JsonConnection& connection, const std::string& name, const std::string& type,
+                                const std::string& data, uint64_t t_send_ns, size_t& bytes) {
+    std::string message = "{\"command\": \"inject_data\", \"name\": \"" + name + "\", \"type\": \"" + type
+        + "\", \"t_send_ns\": " + std::to_string(t_send_ns) + ", \"data\": " + data + "}";
+    bytes = message.size();
+
+    // The server parses one message per read, so wait for each reply before
+    // sending the next
+    std::string reply;
+    return connection.exchange(message, reply) && reply.find("\"success\":true") != std::string::npos;
+}
+
+std::string LoadGenerator::buildData(uint64_t seq) const {
+    const char* key = config.message_type == "string" ? "string" : "list";
+    return std::string("{\"") + key + "\": " + buildPayload(seq) + "}";
+}
+
+std::string LoadGenerator::buildPayload(uint64_t seq) const {
+    if (config.message_type == "string") {
+        std::string text(config.message_size, 'x');
+        for (size_t i = 0; i < text.size(); ++i) {
+            text[i] = static_cast<char>('a' + (seq + i) % 26);
+        }
+        return "\"" + text + "\"";
+    }
+
+    std::ostringstream payload;
+    payload << "[";
+    for (size_t i = 0; i < config.message_size; ++i) {
+        if (i > 0) payload << ", ";
+        payload << static_cast<int>((seq + i) % 1000);
+    }
+    payload << "]";
+    return payload.str();
+}
+
+bool LoadGenerator::parseArguments(int argc, char* argv[], LoadGeneratorConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&](const char* name) -> const char* {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << name << std::endl;
+                return nullptr;
+            }
+            return argv[++i];
+        };
+
+        const char* value = nullptr;
+        if (arg == "--bench") {
+            continue;
+        } else if (arg == "--no-latency") {
+            config.measure_latency = false;
+            continue;
+        } else if (arg == "--streams") {
+            // The standalone server does not run Python or reply, so there is nothing to time
+            config.use_streams = true;
+            config.measure_latency = false;
+            continue;
+        } else if (arg == "--help" || arg == "-h") {
+            return false;
+        }
+
+        if (!(value = next(arg.c_str()))) {
+            return false;
+        }
+
+        if (arg == "--host") {
+            config.host = value;
+        } else if (arg == "--port") {
+            config.port = std::atoi(value);
+        } else if (arg == "--connections") {
+            config.connections = std::max(1, std::atoi(value));
+        } else if (arg == "--rate") {
+            config.rate = std::atof(value);
+        } else if (arg == "--size") {
+            config.message_size = static_cast<size_t>(std::max(1, std::atoi(value)));
+        } else if (arg == "--type") {
+            config.message_type = value;
+            if (config.message_type != "int_list" && config.message_type != "string") {
+                std::cerr << "Unsupported message type: " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--duration") {
+            config.duration_s = std::atof(value);
+        } else if (arg == "--timeout") {
+            config.reply_timeout_ms = std::atoi(value);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void LoadGenerator::printUsage(const char* program) {
+    std::cout << "Usage: " << program << " --bench [options]" << std::endl;
+    std::cout << "  --host <addr>          Target host (default 127.0.0.1)" << std::endl;
+    std::cout << "  --port <port>          App ingest port, inject_data messages (default 8080)" << std::endl;
+    std::cout << "  --connections <n>      Sender threads, one connection each (default 1)" << std::endl;
+    std::cout << "  --rate <hz>            Messages per second per connection, 0 = unthrottled (default 100)" << std::endl;
+    std::cout << "  --size <n>             Elements per int_list or characters per string (default 7)" << std::endl;
+    std::cout << "  --type <t>             int_list or string (default int_list)" << std::endl;
+    std::cout << "  --duration <s>         Run time in seconds (default 5)" << std::endl;
+    std::cout << "  --timeout <ms>         Count a message as failed after this long without a reply (default 1000)" << std::endl;
+    std::cout << "  --streams              Send binary stream frames (header interned) to the standalone" << std::endl;
+    std::cout << "                         tcp_server module instead of the app; implies --no-latency" << std::endl;
+    std::cout << "  --no-latency           Only measure throughput" << std::endl;
+}
+
+void LoadGenerator::printReport(const LoadGeneratorConfig& config, const LoadGeneratorReport& report) {
+    std::cout << "Load: " << config.connections << " connection(s), " << config.message_type
+              << " x" << config.message_size << ", target ";
+    if (config.rate > 0.0) {
+        std::cout << config.rate * config.connections << " msg/s" << std::endl;
+    } else {
+        std::cout << "unthrottled" << std::endl;
+    }
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Elapsed:     " << report.elapsed_s << " s" << std::endl;
+    std::cout << "Sent:        " << report.messages_sent << " messages (" << report.messages_failed << " failed)" << std::endl;
+    std::cout << "Throughput:  " << report.messagesPerSecond() << " msg/s, "
+              << report.megabytesPerSecond() << " MB/s" << std::endl;
+
+    if (!config.measure_latency) {
+        return;
+    }
+
+    if (report.latencies_ms.empty()) {
+        std::cout << "Latency:     no samples (is the app listening on " << config.host << ":"
+                  << config.port << "?)" << std::endl;
+        return;
+    }
+
+    // From the send timestamp to the reply sent once the value was bound
+    std::cout << "Latency ms:  min " << report.latencies_ms.front()
+              << "  p50 " << report.latencyPercentile(50.0)
+              << "  p99 " << report.latencyPercentile(99.0)
+              << "  p99.9 " << report.latencyPercentile(99.9)
+              << "  max " << report.latencies_ms.back() << std::endl;
+}
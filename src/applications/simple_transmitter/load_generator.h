@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class TCPClient;
+
+struct LoadGeneratorConfig {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+
+    int connections = 1;             // Number of sender threads, one connection each
+    double rate = 100.0;             // Messages per second per connection (0 = as fast as possible)
+    size_t message_size = 7;         // Elements for int_list, characters for string
+    std::string message_type = "int_list";
+    double duration_s = 5.0;
+    // Send binary stream frames (interned headers) to the standalone
+    // tcp_server module instead of inject_data messages to the app
+    bool use_streams = false;
+
+    // Time each inject_data frame from the send timestamp in its header to
+    // the server's reply, which the app sends once the value is bound
+    bool measure_latency = true;
+    int reply_timeout_ms = 1000;     // Count a frame as failed after this long without a reply
+};
+
+struct LoadGeneratorReport {
+    double elapsed_s = 0.0;
+    uint64_t messages_sent = 0;
+    uint64_t messages_failed = 0;
+    uint64_t bytes_sent = 0;
+
+    std::vector<double> latencies_ms;  // Sorted ascending
+
+    double messagesPerSecond() const;
+    double megabytesPerSecond() const;
+    double latencyPercentile(double percentile) const;
+};
+
+// A persistent connection that sends one JSON object and reads one JSON
+// object back, the way the app's ingest server talks
+class JsonConnection {
+private:
+    std::string host;
+    int port;
+    int timeout_ms;
+    int socket_fd;
+
+    bool connect();
+
+public:
+    JsonConnection(const std::string& host, int port, int timeout_ms);
+    ~JsonConnection();
+    JsonConnection(const JsonConnection&) = delete;
+    JsonConnection& operator=(const JsonConnection&) = delete;
+
+    // Connects first if needed; drops the connection when anything fails
+    bool exchange(const std::string& request, std::string& reply);
+    void disconnect();
+};
+
+// Drives the app's TCP ingest port with inject_data messages from several
+// threads and measures how long it takes until injected data is bound in
+// Python.
+class LoadGenerator {
+private:
+    LoadGeneratorConfig config;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> messages_sent;
+    std::atomic<uint64_t> messages_failed;
+    std::atomic<uint64_t> bytes_sent;
+
+    void senderLoop(int connection_index, std::vector<double>& latencies_ms);
+
+    bool injectFrame(JsonConnection& connection, const std::string& name, const std::string& type,
+                     const std::string& data, uint64_t t_send_ns, size_t& bytes);
+    std::string buildData(uint64_t seq) const;
+    std::string buildPayload(uint64_t seq) const;
+
+public:
+    explicit LoadGenerator(const LoadGeneratorConfig& config);
+
+    // Run for the configured duration and collect results
+    LoadGeneratorReport run();
+
+    static bool parseArguments(int argc, char* argv[], LoadGeneratorConfig& config);
+    static void printUsage(const char* program);
+    static void printReport(const LoadGeneratorConfig& config, const LoadGeneratorReport& report);
+};
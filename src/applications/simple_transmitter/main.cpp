@@ -1,9 +1,35 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <cstring>
 #include "../../modules/tcp_client/tcp_client.h"
+#include "load_generator.h"
+
+static int runBenchmark(int argc, char* argv[]) {
+    LoadGeneratorConfig config;
+    if (!LoadGenerator::parseArguments(argc, argv, config)) {
+        LoadGenerator::printUsage(argv[0]);
+        return 1;
+    }
+    
+    std::cout << "Simple TCP Transmitter - benchmark mode" << std::endl;
+    std::cout << "Target: " << config.host << ":" << config.port << std::endl;
+    
+    LoadGenerator generator(config);
+    LoadGeneratorReport report = generator.run();
+    LoadGenerator::printReport(config, report);
+    
+    return report.messages_sent > 0 ? 0 : 1;
+}
 
 int main(int argc, char* argv[]) {
+    // Non-interactive load generator
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--bench") == 0) {
+            return runBenchmark(argc, argv);
+        }
+    }
+    
     std::string host = "127.0.0.1";
     int port = 8080;
     
@@ -0,0 +1,273 @@
+#include "bounded_repr.h"
+#include "python_engine.h"
+#include <cstdio>
+
+namespace {
+
+// Containers nested deeper than this are written as [...], like reprlib
+const int maxDepth = 6;
+
+class ReprWriter {
+public:
+    explicit ReprWriter(size_t limit) : limit(limit) {}
+
+    bool full() const { return cut; }
+    size_t room() const { return limit - text.size(); }
+    std::string& result() { return text; }
+
+    void append(const char* data, size_t size) {
+        if (cut) {
+            return;
+        }
+        if (size <= room()) {
+            text.append(data, size);
+            return;
+        }
+
+        // Never split a UTF-8 sequence
+        size_t keep = room();
+        while (keep > 0 && (static_cast<unsigned char>(data[keep]) & 0xC0) == 0x80) {
+            keep--;
+        }
+        text.append(data, keep);
+        text += "...";
+        cut = true;
+    }
+    void append(const char* data) { append(data, std::char_traits<char>::length(data)); }
+
+    // Text that was cut on purpose before writing; the writer is full after it
+    void appendCut(const char* data, size_t size) {
+        append(data, size);
+        if (!cut) {
+            text += "...";
+            cut = true;
+        }
+    }
+
+private:
+    std::string text;
+    size_t limit;
+    bool cut = false;
+};
+
+bool writeValue(ReprWriter& writer, PyObject* value, int depth);
+
+bool writeRepr(ReprWriter& writer, PyObject* value) {
+    PyObject* repr = PyObject_Repr(value);
+    Py_ssize_t size = 0;
+    const char* utf8 = repr ? PyUnicode_AsUTF8AndSize(repr, &size) : nullptr;
+    if (utf8) {
+        writer.append(utf8, static_cast<size_t>(size));
+    }
+    Py_XDECREF(repr);
+    return utf8 != nullptr;
+}
+
+bool writeSequenceHead(ReprWriter& writer, PyObject* sequence) {
+    // Only the part that can show is repr'd; drop the closing quote of the slice
+    Py_ssize_t length = PyObject_Length(sequence);
+    if (length < 0) {
+        return false;
+    }
+    if (static_cast<size_t>(length) <= writer.room()) {
+        return writeRepr(writer, sequence);
+    }
+
+    PyObject* head = PySequence_GetSlice(sequence, 0, static_cast<Py_ssize_t>(writer.room()));
+    PyObject* repr = head ? PyObject_Repr(head) : nullptr;
+    Py_ssize_t size = 0;
+    const char* utf8 = repr ? PyUnicode_AsUTF8AndSize(repr, &size) : nullptr;
+    Py_ssize_t closing = PyByteArray_CheckExact(sequence) ? 2 : 1;
+    if (utf8) {
+        writer.appendCut(utf8, static_cast<size_t>(size > closing ? size - closing : 0));
+    }
+    Py_XDECREF(repr);
+    Py_XDECREF(head);
+    return utf8 != nullptr;
+}
+
+bool writeInt(ReprWriter& writer, PyObject* value) {
+    int overflow = 0;
+    long long small = PyLong_AsLongLongAndOverflow(value, &overflow);
+    if (!overflow) {
+        char digits[32];
+        int size = std::snprintf(digits, sizeof(digits), "%lld", small);
+        writer.append(digits, static_cast<size_t>(size));
+        return true;
+    }
+
+    // Past sys.get_int_max_str_digits() repr() refuses; say how big it is instead
+    if (writeRepr(writer, value)) {
+        return true;
+    }
+    if (!PyErr_ExceptionMatches(PyExc_ValueError)) {
+        return false;
+    }
+    PyErr_Clear();
+    PyObject* bits = PyObject_CallMethod(value, "bit_length", nullptr);
+    if (!bits) {
+        return false;
+    }
+    char text[64];
+    int size = std::snprintf(text, sizeof(text), "<int of %lld bits>", PyLong_AsLongLong(bits));
+    Py_DECREF(bits);
+    writer.append(text, static_cast<size_t>(size));
+    return true;
+}
+
+bool writeItems(ReprWriter& writer, PyObject* container, int depth) {
+    // list and tuple; elements are fetched one at a time and only while there is room
+    bool tuple = PyTuple_CheckExact(container);
+    writer.append(tuple ? "(" : "[");
+    Py_ssize_t size = PySequence_Fast_GET_SIZE(container);
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(container) && !writer.full(); ++i) {
+        if (i > 0) {
+            writer.append(", ");
+        }
+#if PY_VERSION_HEX >= 0x030D0000
+        PyObject* item = tuple ? Py_NewRef(PyTuple_GET_ITEM(container, i)) : PyList_GetItemRef(container, i);
+#else
+        PyObject* item = Py_XNewRef(PySequence_Fast_GET_ITEM(container, i));
+#endif
+        // A repr that shrank the list ends the listing
+        if (!item) {
+            PyErr_Clear();
+            break;
+        }
+        bool written = writeValue(writer, item, depth + 1);
+        Py_DECREF(item);
+        if (!written) {
+            return false;
+        }
+    }
+    writer.append(tuple && size == 1 ? ",)" : tuple ? ")" : "]");
+    return true;
+}
+
+bool writeDict(ReprWriter& writer, PyObject* dict, int depth) {
+    writer.append("{");
+    bool written = true;
+#if PY_VERSION_HEX >= 0x030D0000
+    Py_BEGIN_CRITICAL_SECTION(dict);
+#endif
+    Py_ssize_t position = 0;
+    PyObject* key = nullptr;
+    PyObject* value = nullptr;
+    bool first = true;
+    while (written && !writer.full() && PyDict_Next(dict, &position, &key, &value)) {
+        // Element reprs may run Python code that changes the dict
+        Py_INCREF(key);
+        Py_INCREF(value);
+        if (!first) {
+            writer.append(", ");
+        }
+        first = false;
+        written = writeValue(writer, key, depth + 1);
+        if (written) {
+            writer.append(": ");
+            written = writeValue(writer, value, depth + 1);
+        }
+        Py_DECREF(key);
+        Py_DECREF(value);
+    }
+#if PY_VERSION_HEX >= 0x030D0000
+    Py_END_CRITICAL_SECTION();
+#endif
+    writer.append("}");
+    return written;
+}
+
+bool writeSet(ReprWriter& writer, PyObject* set, int depth) {
+    bool frozen = PyFrozenSet_CheckExact(set);
+    if (PySet_GET_SIZE(set) == 0) {
+        writer.append(frozen ? "frozenset()" : "set()");
+        return true;
+    }
+
+    PyObject* iterator = PyObject_GetIter(set);
+    if (!iterator) {
+        return false;
+    }
+    writer.append(frozen ? "frozenset({" : "{");
+    bool first = true;
+    PyObject* item = nullptr;
+    while (!writer.full() && (item = PyIter_Next(iterator))) {
+        if (!first) {
+            writer.append(", ");
+        }
+        first = false;
+        bool written = writeValue(writer, item, depth + 1);
+        Py_DECREF(item);
+        if (!written) {
+            Py_DECREF(iterator);
+            return false;
+        }
+    }
+    Py_DECREF(iterator);
+    writer.append(frozen ? "})" : "}");
+    return !PyErr_Occurred();
+}
+
+bool writeContainer(ReprWriter& writer, PyObject* container, int depth) {
+    const char* elided = PyList_CheckExact(container) ? "[...]" : PyTuple_CheckExact(container) ? "(...)" : "{...}";
+    if (depth >= maxDepth) {
+        writer.append(elided);
+        return true;
+    }
+
+    // A container that holds itself
+    int entered = Py_ReprEnter(container);
+    if (entered != 0) {
+        if (entered > 0) {
+            writer.append(elided);
+        }
+        return entered > 0;
+    }
+
+    bool written;
+    if (PyDict_CheckExact(container)) {
+        written = writeDict(writer, container, depth);
+    } else if (PyAnySet_CheckExact(container)) {
+        written = writeSet(writer, container, depth);
+    } else {
+        written = writeItems(writer, container, depth);
+    }
+    Py_ReprLeave(container);
+    return written;
+}
+
+bool writeValue(ReprWriter& writer, PyObject* value, int depth) {
+    if (writer.full()) {
+        return true;
+    }
+    if (PyUnicode_CheckExact(value) || PyBytes_CheckExact(value) || PyByteArray_CheckExact(value)) {
+        return writeSequenceHead(writer, value);
+    }
+    if (PyLong_CheckExact(value)) {
+        return writeInt(writer, value);
+    }
+    if (PyList_CheckExact(value) || PyTuple_CheckExact(value) || PyDict_CheckExact(value) || PyAnySet_CheckExact(value)) {
+        return writeContainer(writer, value, depth);
+    }
+
+    // Short by nature (float, bool, None, complex, ...) or foreign code
+    return writeRepr(writer, value);
+}
+
+}  // namespace
+
+bool boundedRepr(PyObject* value, size_t limit, std::string& text) {
+    ReprWriter writer(limit);
+    if (!writeValue(writer, value, 0)) {
+        return false;
+    }
+    text = std::move(writer.result());
+    return true;
+}
+
+bool hasNativeRepr(PyObject* value) {
+    return PyUnicode_CheckExact(value) || PyBytes_CheckExact(value) || PyByteArray_CheckExact(value) ||
+           PyLong_CheckExact(value) || PyFloat_CheckExact(value) || PyBool_Check(value) || value == Py_None ||
+           PyComplex_CheckExact(value) || PyList_CheckExact(value) || PyTuple_CheckExact(value) ||
+           PyDict_CheckExact(value) || PyAnySet_CheckExact(value);
+}
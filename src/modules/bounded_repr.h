@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Matches the declaration in Python.h
+typedef struct _object PyObject;
+
+// repr() of `value`, stopped after about `limit` characters, in the spirit of
+// reprlib. Built-in scalars and containers (str, bytes, int, float, list,
+// tuple, dict, set, ...) are written natively and only visit the elements
+// that fit, so a ten million element list costs no more than a short one.
+// Other objects go through their own __repr__ and are cut afterwards.
+// A cut repr ends in "...". Call attached to the interpreter. Returns false
+// with a Python exception set if a repr raised.
+bool boundedRepr(PyObject* value, size_t limit, std::string& text);
+
+// True when boundedRepr() writes `value` without calling Python code, so its
+// cost depends on the limit only.
+bool hasNativeRepr(PyObject* value);
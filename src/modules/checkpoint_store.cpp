@@ -0,0 +1,349 @@
+#include "checkpoint_store.h"
+#include "python_engine.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char fileMagic[8] = {'L', 'U', 'M', 'O', 'S', 'C', 'K', 'P'};
+const uint32_t byteOrderMark = 0x01020304;
+const uint32_t fileVersion = 1;
+const uint32_t recordMagic = 0x4c524543;
+
+const uint8_t putRecord = 1;
+const uint8_t removeRecord = 2;
+const uint8_t commitRecord = 3;
+
+// Records are copied in slices while compacting
+const size_t copySlice = 1 << 20;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t version;
+};
+
+struct RecordHeader {
+    uint32_t magic;
+    uint8_t kind;
+    uint8_t reserved;
+    uint16_t nameLength;
+    uint64_t payloadLength;
+};
+static_assert(sizeof(RecordHeader) == 16, "records start with a fixed 16-byte header");
+
+struct Payload {
+    uint64_t offset;
+    uint64_t length;
+};
+
+bool writeFileHeader(std::FILE* file) {
+    FileHeader header = {};
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.byteOrder = byteOrderMark;
+    header.version = fileVersion;
+    return std::fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+bool writeRecordHeader(std::FILE* file, uint8_t kind, const std::string& name, uint64_t payloadLength) {
+    RecordHeader header = {};
+    header.magic = recordMagic;
+    header.kind = kind;
+    header.nameLength = static_cast<uint16_t>(name.size());
+    header.payloadLength = payloadLength;
+    return std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+           std::fwrite(name.data(), 1, name.size(), file) == name.size();
+}
+
+// The payload of each name as of the last commit record; what follows that
+// record is an unfinished checkpoint. Runs without the GIL.
+bool scanRecords(std::FILE* file, std::map<std::string, Payload>& committed) {
+    struct stat info;
+    FileHeader header;
+    if (fstat(fileno(file), &info) != 0 || std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0 ||
+        header.byteOrder != byteOrderMark || header.version != fileVersion) {
+        return false;
+    }
+    uint64_t fileSize = static_cast<uint64_t>(info.st_size);
+    
+    // Names touched since the last commit; false for a removal
+    std::map<std::string, std::pair<bool, Payload>> pending;
+    uint64_t offset = sizeof(FileHeader);
+    RecordHeader record;
+    std::string name;
+    while (std::fread(&record, sizeof(record), 1, file) == 1 && record.magic == recordMagic) {
+        name.resize(record.nameLength);
+        if (std::fread(&name[0], 1, name.size(), file) != name.size()) {
+            break;
+        }
+        offset += sizeof(record) + name.size();
+        if (record.payloadLength > fileSize - offset) {
+            break;
+        }
+        
+        if (record.kind == putRecord) {
+            pending[name] = {true, {offset, record.payloadLength}};
+        } else if (record.kind == removeRecord) {
+            pending[name] = {false, {0, 0}};
+        } else if (record.kind == commitRecord) {
+            for (const auto& entry : pending) {
+                if (entry.second.first) {
+                    committed[entry.first] = entry.second.second;
+                } else {
+                    committed.erase(entry.first);
+                }
+            }
+            pending.clear();
+        } else {
+            break;
+        }
+        offset += record.payloadLength;
+        if (fseeko(file, static_cast<off_t>(offset), SEEK_SET) != 0) {
+            break;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+CheckpointStore::~CheckpointStore() {
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+bool CheckpointStore::create(const std::string& filePath) {
+    if (file) {
+        std::fclose(file);
+    }
+    path = filePath;
+    records.clear();
+    liveBytes = 0;
+    endOffset = sizeof(FileHeader);
+    
+    file = std::fopen(path.c_str(), "w+b");
+    if (!file) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+        return false;
+    }
+    return writeFileHeader(file) || fail();
+}
+
+bool CheckpointStore::put(const std::string& name, PyObject* value, const FileProgress& progress) {
+    uint64_t start = endOffset;
+    if (!writeRecord(putRecord, name)) {
+        return false;
+    }
+    if (!dumpPickle(pickleStreamType, value, file, progress)) {
+        if (std::ferror(file)) {
+            // The stream has set the OSError already
+            std::fclose(file);
+            file = nullptr;
+        } else {
+            cutOff(start);
+        }
+        return false;
+    }
+    
+    // The payload length is known now; fill it in
+    off_t end = ftello(file);
+    uint64_t payloadLength = static_cast<uint64_t>(end) - endOffset;
+    if (end < 0 || fseeko(file, static_cast<off_t>(start + offsetof(RecordHeader, payloadLength)), SEEK_SET) != 0 ||
+        std::fwrite(&payloadLength, sizeof(payloadLength), 1, file) != 1 || fseeko(file, end, SEEK_SET) != 0) {
+        return fail();
+    }
+    endOffset = static_cast<uint64_t>(end);
+    setRecord(name, {start, endOffset - start});
+    return true;
+}
+
+bool CheckpointStore::remove(const std::string& name) {
+    if (!writeRecord(removeRecord, name)) {
+        return false;
+    }
+    dropRecord(name);
+    return true;
+}
+
+bool CheckpointStore::commit() {
+    if (!writeRecord(commitRecord, std::string())) {
+        return false;
+    }
+    int result;
+    Py_BEGIN_ALLOW_THREADS
+    result = std::fflush(file) == 0 ? fsync(fileno(file)) : -1;
+    Py_END_ALLOW_THREADS
+    return result == 0 || fail();
+}
+
+bool CheckpointStore::compact() {
+    if (!file) {
+        PyErr_SetString(PyExc_ValueError, "the checkpoint file is closed");
+        return false;
+    }
+    std::string partPath = path + ".part";
+    std::FILE* compacted = std::fopen(partPath.c_str(), "w+b");
+    if (!compacted) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, partPath.c_str());
+        return false;
+    }
+    
+    // New offsets, in the order of `records`
+    std::vector<uint64_t> offsets;
+    offsets.reserve(records.size());
+    uint64_t offset = sizeof(FileHeader);
+    bool copied;
+    Py_BEGIN_ALLOW_THREADS
+    std::vector<char> buffer(copySlice);
+    copied = writeFileHeader(compacted) && std::fflush(file) == 0;
+    for (const auto& entry : records) {
+        const Record& record = entry.second;
+        for (uint64_t done = 0; copied && done < record.size;) {
+            size_t slice = static_cast<size_t>(std::min<uint64_t>(buffer.size(), record.size - done));
+            copied = pread(fileno(file), buffer.data(), slice, static_cast<off_t>(record.offset + done)) == static_cast<ssize_t>(slice) &&
+                     std::fwrite(buffer.data(), 1, slice, compacted) == slice;
+            done += slice;
+        }
+        offsets.push_back(offset);
+        offset += record.size;
+    }
+    copied = copied && writeRecordHeader(compacted, commitRecord, std::string(), 0) &&
+             std::fflush(compacted) == 0 && fsync(fileno(compacted)) == 0;
+    Py_END_ALLOW_THREADS
+    
+    // The old file stays in use if anything went wrong
+    if (!copied || std::rename(partPath.c_str(), path.c_str()) != 0) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, partPath.c_str());
+        std::fclose(compacted);
+        std::remove(partPath.c_str());
+        return false;
+    }
+    std::fclose(file);
+    file = compacted;
+    endOffset = offset + sizeof(RecordHeader);
+    size_t index = 0;
+    for (auto& entry : records) {
+        entry.second.offset = offsets[index++];
+    }
+    return true;
+}
+
+std::vector<std::string> CheckpointStore::names() const {
+    std::vector<std::string> result;
+    result.reserve(records.size());
+    for (const auto& entry : records) {
+        result.push_back(entry.first);
+    }
+    return result;
+}
+
+uint64_t CheckpointStore::recordSize(const std::string& name) const {
+    auto found = records.find(name);
+    return found != records.end() ? found->second.size : 0;
+}
+
+PyObject* CheckpointStore::load(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+        return nullptr;
+    }
+    std::map<std::string, Payload> payloads;
+    bool valid;
+    Py_BEGIN_ALLOW_THREADS
+    valid = scanRecords(file, payloads);
+    Py_END_ALLOW_THREADS
+    if (!valid) {
+        std::fclose(file);
+        PyErr_Format(PyExc_ValueError, "%s is not a workspace checkpoint", path.c_str());
+        return nullptr;
+    }
+    
+    PyObject* pickle = PyImport_ImportModule("pickle");
+    PyObject* variables = pickle ? PyDict_New() : nullptr;
+    for (const auto& entry : payloads) {
+        const Payload& payload = entry.second;
+        PyObject* data = variables ? PyBytes_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(payload.length)) : nullptr;
+        if (!data) {
+            Py_CLEAR(variables);
+            break;
+        }
+        bool read;
+        Py_BEGIN_ALLOW_THREADS
+        read = fseeko(file, static_cast<off_t>(payload.offset), SEEK_SET) == 0 &&
+               std::fread(PyBytes_AS_STRING(data), 1, payload.length, file) == payload.length;
+        Py_END_ALLOW_THREADS
+        if (!read) {
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+            Py_DECREF(data);
+            Py_CLEAR(variables);
+            break;
+        }
+        
+        // A value whose class has gone away since is left out
+        PyObject* value = PyObject_CallMethod(pickle, "loads", "O", data);
+        Py_DECREF(data);
+        if (value && PyDict_SetItemString(variables, entry.first.c_str(), value) < 0) {
+            Py_DECREF(value);
+            Py_CLEAR(variables);
+            break;
+        }
+        Py_XDECREF(value);
+        PyErr_Clear();
+    }
+    Py_XDECREF(pickle);
+    std::fclose(file);
+    return variables;
+}
+
+bool CheckpointStore::writeRecord(uint8_t kind, const std::string& name) {
+    if (!file) {
+        PyErr_SetString(PyExc_ValueError, "the checkpoint file is closed");
+        return false;
+    }
+    if (name.size() > UINT16_MAX) {
+        PyErr_SetString(PyExc_ValueError, "variable name too long for a checkpoint");
+        return false;
+    }
+    if (!writeRecordHeader(file, kind, name, 0)) {
+        return fail();
+    }
+    endOffset += sizeof(RecordHeader) + name.size();
+    return true;
+}
+
+void CheckpointStore::cutOff(uint64_t offset) {
+    if (std::fflush(file) != 0 || ftruncate(fileno(file), static_cast<off_t>(offset)) != 0 ||
+        fseeko(file, static_cast<off_t>(offset), SEEK_SET) != 0) {
+        std::fclose(file);
+        file = nullptr;
+    }
+    endOffset = offset;
+}
+
+bool CheckpointStore::fail() {
+    PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+    std::fclose(file);
+    file = nullptr;
+    return false;
+}
+
+void CheckpointStore::setRecord(const std::string& name, Record record) {
+    dropRecord(name);
+    records[name] = record;
+    liveBytes += record.size;
+}
+
+void CheckpointStore::dropRecord(const std::string& name) {
+    auto found = records.find(name);
+    if (found != records.end()) {
+        liveBytes -= found->second.size;
+        records.erase(found);
+    }
+}
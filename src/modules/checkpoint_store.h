@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "pickle_stream.h"
+
+// Append-only file behind the workspace checkpoints. Each checkpoint appends
+// a record per changed variable, its pickle or its removal, and ends with a
+// commit record; reading stops at the last commit, so a checkpoint cut short
+// by a crash leaves the one before it intact. Superseded records stay until
+// compact() rewrites the file with the latest record of each name.
+//
+// Layout, native byte order:
+//   header   magic "LUMOSCKP", byte order mark, version
+//   records  magic, kind (put, remove, commit), name length, payload
+//            length, then the name and, for a put, the pickle
+//
+// Call attached to the interpreter; file I/O runs without the GIL.
+class CheckpointStore {
+public:
+    // Values are pickled through `pickleStreamType`, borrowed from the engine
+    explicit CheckpointStore(PyObject* pickleStreamType) : pickleStreamType(pickleStreamType) {}
+    ~CheckpointStore();
+    CheckpointStore(const CheckpointStore&) = delete;
+    CheckpointStore& operator=(const CheckpointStore&) = delete;
+
+    // Start an empty store at `path`, replacing any file there. Returns false
+    // with a Python exception set on failure.
+    bool create(const std::string& path);
+    // False once created and until a write fails; the store closes itself then
+    bool isOpen() const { return file != nullptr; }
+
+    // Append the pickle of `value` under `name`. When pickling fails, or
+    // `progress` stops it, the partial record is cut off again and the
+    // previous record of `name` stays current. Returns false with a Python
+    // exception set.
+    bool put(const std::string& name, PyObject* value, const FileProgress& progress);
+    bool remove(const std::string& name);
+    // Close the checkpoint and flush it to disk
+    bool commit();
+    // Rewrite the file with only the current records, then replace it
+    bool compact();
+
+    bool contains(const std::string& name) const { return records.count(name) != 0; }
+    std::vector<std::string> names() const;
+    // Bytes of the current record of `name`, 0 if there is none
+    uint64_t recordSize(const std::string& name) const;
+    uint64_t fileSize() const { return endOffset; }
+    // Bytes of the current records; compaction shrinks the file to about this
+    uint64_t liveSize() const { return liveBytes; }
+
+    // The variables of the last commit in `path`, as a dict of name to
+    // unpickled value; only the current record of each name is read. Values
+    // that no longer unpickle are left out. Returns a new reference, or
+    // nullptr with a Python exception set.
+    static PyObject* load(const std::string& path);
+
+private:
+    struct Record {
+        uint64_t offset;
+        uint64_t size;   // Header, name and payload
+    };
+
+    bool writeRecord(uint8_t kind, const std::string& name);
+    void cutOff(uint64_t offset);
+    bool fail();
+    void setRecord(const std::string& name, Record record);
+    void dropRecord(const std::string& name);
+
+    PyObject* pickleStreamType;
+    std::FILE* file = nullptr;
+    std::string path;
+    uint64_t endOffset = 0;
+    uint64_t liveBytes = 0;
+    std::unordered_map<std::string, Record> records;
+};
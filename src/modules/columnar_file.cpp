@@ -0,0 +1,371 @@
+#include "columnar_file.h"
+#include "lumos_array.h"
+#include "python_engine.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char fileMagic[8] = {'L', 'U', 'M', 'O', 'S', 'C', 'O', 'L'};
+const uint32_t byteOrderMark = 0x01020304;
+const uint32_t fileVersion = 1;
+const uint64_t dataAlignment = 64;
+const int maxDimensions = 4;
+
+// Elements are written in slices so progress and cancellation keep up
+const size_t writeSlice = 8 << 20;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t version;
+    uint64_t entryCount;
+    uint64_t tableOffset;
+    uint64_t tableSize;
+    uint64_t reserved[3];
+};
+static_assert(sizeof(FileHeader) == dataAlignment, "the header fills the first aligned block");
+
+struct TableEntry {
+    uint64_t offset;
+    uint64_t count;
+    uint8_t elementType;
+    uint8_t dimensions;
+    uint16_t nameLength;
+    uint32_t reserved;
+    uint64_t shape[maxDimensions];
+};
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool elementTypeOf(const Py_buffer& view, LumosArray::ElementType& type) {
+    // Native size and byte order only: no prefix, or '@'
+    const char* format = view.format ? view.format : "B";
+    if (format[0] == '@') {
+        format++;
+    }
+    if (format[0] == '\0' || format[1] != '\0') {
+        return false;
+    }
+    
+    using Type = LumosArray::ElementType;
+    const Type signedTypes[] = {Type::Int8, Type::Int16, Type::Int32, Type::Int64};
+    const Type unsignedTypes[] = {Type::UInt8, Type::UInt16, Type::UInt32, Type::UInt64};
+    int sizeIndex = view.itemsize == 1 ? 0 : view.itemsize == 2 ? 1 : view.itemsize == 4 ? 2 : view.itemsize == 8 ? 3 : -1;
+    switch (format[0]) {
+    case 'b': case 'h': case 'i': case 'l': case 'q':
+        if (sizeIndex >= 0) {
+            type = signedTypes[sizeIndex];
+        }
+        return sizeIndex >= 0;
+    case 'B': case 'H': case 'I': case 'L': case 'Q':
+        if (sizeIndex >= 0) {
+            type = unsignedTypes[sizeIndex];
+        }
+        return sizeIndex >= 0;
+    case 'f':
+        type = Type::Float32;
+        return view.itemsize == 4;
+    case 'd':
+        type = Type::Float64;
+        return view.itemsize == 8;
+    default:
+        return false;
+    }
+}
+
+bool getColumnarBuffer(PyObject* value, Py_buffer& view, LumosArray::ElementType& type) {
+    // Text and byte strings support the buffer protocol but are not arrays
+    if (PyBytes_Check(value) || PyByteArray_Check(value) || !PyObject_CheckBuffer(value)) {
+        return false;
+    }
+    if (PyObject_GetBuffer(value, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0) {
+        PyErr_Clear();
+        return false;
+    }
+    if (view.ndim < 1 || view.ndim > maxDimensions || !elementTypeOf(view, type)) {
+        PyBuffer_Release(&view);
+        return false;
+    }
+    return true;
+}
+
+bool writeAll(std::FILE* file, const void* data, size_t size) {
+    return std::fwrite(data, 1, size, file) == size;
+}
+
+bool padTo(std::FILE* file, uint64_t& position, uint64_t alignment) {
+    static const char zeros[dataAlignment] = {};
+    uint64_t padding = alignUp(position, alignment) - position;
+    position += padding;
+    return writeAll(file, zeros, static_cast<size_t>(padding));
+}
+
+// Elements go out without the GIL; the exported buffer keeps them in place
+bool writeElements(std::FILE* file, const Py_buffer& view, uint64_t& written, const FileProgress& progress) {
+    const char* data = static_cast<const char*>(view.buf);
+    size_t size = static_cast<size_t>(view.len);
+    for (size_t done = 0; done < size;) {
+        size_t slice = size - done < writeSlice ? size - done : writeSlice;
+        bool ok;
+        Py_BEGIN_ALLOW_THREADS
+        ok = writeAll(file, data + done, slice);
+        Py_END_ALLOW_THREADS
+        if (!ok) {
+            PyErr_SetFromErrno(PyExc_OSError);
+            return false;
+        }
+        done += slice;
+        written += slice;
+        if (progress && !progress(written, 0)) {
+            PyErr_SetNone(PyExc_KeyboardInterrupt);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool writeFile(std::FILE* file, PyObject* variables, const FileProgress& progress, size_t& skipped) {
+    FileHeader header = {};
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.byteOrder = byteOrderMark;
+    header.version = fileVersion;
+    if (!writeAll(file, &header, sizeof(header))) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return false;
+    }
+    
+    // Commands keep running meanwhile; work on a copy of the item list
+    PyObject* items = PyDict_Items(variables);
+    if (!items) {
+        return false;
+    }
+    std::string table;
+    uint64_t position = sizeof(header);
+    uint64_t written = 0;
+    bool ok = true;
+    for (Py_ssize_t i = 0; ok && i < PyList_GET_SIZE(items); i++) {
+        PyObject* key = PyTuple_GET_ITEM(PyList_GET_ITEM(items, i), 0);
+        PyObject* value = PyTuple_GET_ITEM(PyList_GET_ITEM(items, i), 1);
+        Py_ssize_t nameLength = 0;
+        const char* name = PyUnicode_Check(key) ? PyUnicode_AsUTF8AndSize(key, &nameLength) : nullptr;
+        Py_buffer view;
+        LumosArray::ElementType type;
+        if (!name || nameLength > UINT16_MAX || !getColumnarBuffer(value, view, type)) {
+            PyErr_Clear();
+            skipped++;
+            continue;
+        }
+        
+        TableEntry entry = {};
+        ok = padTo(file, position, dataAlignment);
+        entry.offset = position;
+        entry.count = static_cast<uint64_t>(view.len / view.itemsize);
+        entry.elementType = static_cast<uint8_t>(type);
+        entry.dimensions = static_cast<uint8_t>(view.ndim);
+        entry.nameLength = static_cast<uint16_t>(nameLength);
+        for (int d = 0; d < view.ndim; d++) {
+            entry.shape[d] = static_cast<uint64_t>(view.shape[d]);
+        }
+        if (!ok) {
+            PyErr_SetFromErrno(PyExc_OSError);
+        } else {
+            ok = writeElements(file, view, written, progress);
+            position += static_cast<uint64_t>(view.len);
+        }
+        PyBuffer_Release(&view);
+        
+        table.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        table.append(name, static_cast<size_t>(nameLength));
+        table.resize(alignUp(table.size(), 8), '\0');
+        header.entryCount++;
+    }
+    Py_DECREF(items);
+    if (!ok) {
+        return false;
+    }
+    
+    ok = padTo(file, position, dataAlignment) && writeAll(file, table.data(), table.size());
+    header.tableOffset = position;
+    header.tableSize = table.size();
+    ok = ok && std::fseek(file, 0, SEEK_SET) == 0 && writeAll(file, &header, sizeof(header));
+    if (!ok) {
+        PyErr_SetFromErrno(PyExc_OSError);
+    }
+    return ok;
+}
+
+struct Mapping {
+    void* address;
+    size_t size;
+};
+
+PyObject* corruptFile(const std::string& path, const char* problem) {
+    PyErr_Format(PyExc_ValueError, "%s is not a valid array file: %s", path.c_str(), problem);
+    return nullptr;
+}
+
+// View of one entry; `owner` keeps the mapping alive for as long as the view
+PyObject* createView(PyObject* arrayType, const std::shared_ptr<const void>& owner, const char* base,
+                     const TableEntry& entry) {
+    LumosArray::ElementType type = static_cast<LumosArray::ElementType>(entry.elementType);
+    PyObject* array = LumosArray::create(arrayType, owner, base + entry.offset, static_cast<size_t>(entry.count), type);
+    if (!array || entry.dimensions == 1) {
+        return array;
+    }
+    
+    // memoryview only reshapes byte views: flat bytes first, then elements and shape
+    PyObject* shape = PyTuple_New(entry.dimensions);
+    for (int d = 0; shape && d < entry.dimensions; d++) {
+        PyTuple_SET_ITEM(shape, d, PyLong_FromUnsignedLongLong(entry.shape[d]));
+    }
+    PyObject* view = shape ? PyMemoryView_FromObject(array) : nullptr;
+    PyObject* bytes = view ? PyObject_CallMethod(view, "cast", "s", "B") : nullptr;
+    PyObject* shaped = bytes ? PyObject_CallMethod(bytes, "cast", "sO", LumosArray::elementFormat(type), shape) : nullptr;
+    Py_XDECREF(bytes);
+    Py_XDECREF(view);
+    Py_XDECREF(shape);
+    Py_DECREF(array);
+    return shaped;
+}
+
+PyObject* readTable(PyObject* arrayType, const std::string& path, const std::shared_ptr<const void>& owner,
+                    const char* base, size_t size) {
+    FileHeader header;
+    if (size < sizeof(header)) {
+        return corruptFile(path, "too short");
+    }
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0) {
+        return corruptFile(path, "unknown format");
+    }
+    if (header.byteOrder != byteOrderMark) {
+        return corruptFile(path, "written with another byte order");
+    }
+    if (header.version != fileVersion) {
+        return corruptFile(path, "unsupported version");
+    }
+    if (header.tableOffset > size || header.tableSize > size - header.tableOffset) {
+        return corruptFile(path, "table of contents out of range");
+    }
+    
+    PyObject* variables = PyDict_New();
+    uint64_t position = header.tableOffset;
+    uint64_t tableEnd = header.tableOffset + header.tableSize;
+    for (uint64_t i = 0; variables && i < header.entryCount; i++) {
+        TableEntry entry;
+        if (tableEnd - position < sizeof(entry)) {
+            Py_CLEAR(variables);
+            return corruptFile(path, "table of contents cut short");
+        }
+        std::memcpy(&entry, base + position, sizeof(entry));
+        position += sizeof(entry);
+        
+        // Everything the entry points at has to lie inside the data section
+        uint64_t elementSize = entry.elementType <= static_cast<uint8_t>(LumosArray::ElementType::Float64)
+            ? LumosArray::elementSize(static_cast<LumosArray::ElementType>(entry.elementType)) : 0;
+        uint64_t elements = 1;
+        for (int d = 0; d < entry.dimensions && d < maxDimensions; d++) {
+            elements *= entry.shape[d];
+        }
+        bool valid = elementSize > 0 && entry.dimensions >= 1 && entry.dimensions <= maxDimensions &&
+                     elements == entry.count && entry.offset % dataAlignment == 0 &&
+                     entry.offset <= header.tableOffset &&
+                     entry.count <= (header.tableOffset - entry.offset) / elementSize &&
+                     entry.nameLength <= tableEnd - position;
+        if (!valid) {
+            Py_CLEAR(variables);
+            return corruptFile(path, "entry out of range");
+        }
+        
+        PyObject* name = PyUnicode_DecodeUTF8(base + position, entry.nameLength, nullptr);
+        position += alignUp(entry.nameLength, 8);
+        PyObject* value = name ? createView(arrayType, owner, base, entry) : nullptr;
+        if (!value || PyDict_SetItem(variables, name, value) < 0) {
+            Py_CLEAR(variables);
+        }
+        Py_XDECREF(value);
+        Py_XDECREF(name);
+    }
+    return variables;
+}
+
+}  // namespace
+
+bool isColumnarValue(PyObject* value) {
+    Py_buffer view;
+    LumosArray::ElementType type;
+    if (!getColumnarBuffer(value, view, type)) {
+        return false;
+    }
+    PyBuffer_Release(&view);
+    return true;
+}
+
+bool dumpColumnarFile(PyObject* variables, const std::string& path, const FileProgress& progress, size_t& skipped) {
+    std::string partPath = path + ".part";
+    std::FILE* file = std::fopen(partPath.c_str(), "wb");
+    if (!file) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, partPath.c_str());
+        return false;
+    }
+    
+    bool written = writeFile(file, variables, progress, skipped);
+    bool closed = std::fclose(file) == 0;
+    if (written && !closed) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, partPath.c_str());
+    }
+    if (!written || !closed) {
+        std::remove(partPath.c_str());
+        return false;
+    }
+    
+    // Renaming leaves the old file's pages to whoever still maps them
+    if (std::rename(partPath.c_str(), path.c_str()) != 0) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+        std::remove(partPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+PyObject* loadColumnarFile(PyObject* arrayType, const std::string& path) {
+    int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat status;
+    if (descriptor < 0 || ::fstat(descriptor, &status) != 0) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+        if (descriptor >= 0) {
+            ::close(descriptor);
+        }
+        return nullptr;
+    }
+    
+    size_t size = static_cast<size_t>(status.st_size);
+    void* address = size > 0 ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0) : MAP_FAILED;
+    int mapError = errno;
+    ::close(descriptor);
+    if (address == MAP_FAILED) {
+        if (size == 0) {
+            return corruptFile(path, "empty");
+        }
+        errno = mapError;
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+        return nullptr;
+    }
+    
+    // Shared by every view; the last one to go unmaps the file
+    Mapping* mapping = new Mapping{address, size};
+    std::shared_ptr<const void> owner(mapping, [](const Mapping* mapped) {
+        ::munmap(mapped->address, mapped->size);
+        delete mapped;
+    });
+    return readTable(arrayType, path, owner, static_cast<const char*>(address), size);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "pickle_stream.h"
+
+// Workspace files for numeric arrays. Each array is stored as its raw
+// elements, 64-byte aligned, followed by a table of contents (name, element
+// type, shape, offset). Loading maps the file and wraps the elements where
+// they lie, so it costs the table of contents and not the data; pages are
+// read when Python touches them.
+//
+// Layout, native byte order:
+//   header   magic "LUMOSCOL", byte order mark, version, entry count,
+//            table offset and size
+//   data     one aligned block per array
+//   table    per array: offset, element count, element type, dimensions,
+//            shape, name length, then the name padded to 8 bytes
+
+// Whether `value` can be stored: a C-contiguous buffer of native integers or
+// floats (lumos.Array, array.array, numpy arrays up to 4 dimensions). Call
+// attached; never leaves a Python exception set.
+bool isColumnarValue(PyObject* value);
+
+// Write the entries of `variables` (a dict of name to array) to `path` +
+// ".part", then replace `path`; a file that is mapped somewhere stays intact.
+// Entries that cannot be stored are left out and counted in `skipped`. The
+// elements are written without the GIL. Call attached; returns false with a
+// Python exception set on failure.
+bool dumpColumnarFile(PyObject* variables, const std::string& path, const FileProgress& progress, size_t& skipped);
+
+// Map `path` and return a dict of name to a read-only view of each array:
+// a lumos.Array (of `arrayType`) for one dimension, a memoryview cast to the
+// shape otherwise. The mapping lives until the last view is collected.
+// Returns a new reference, or nullptr with a Python exception set.
+PyObject* loadColumnarFile(PyObject* arrayType, const std::string& path);
@@ -20,6 +20,11 @@ void CustomTitleBar::setupUI()
     // titleLabel = new QLabel("LumosWorkspace REPL", this);
     // titleLabel->setObjectName("TitleLabel");
 
+    statusLabel = new QLabel(this);
+    statusLabel->setObjectName("TitleStatusLabel");
+    statusLabel->setStyleSheet("color: #8e8e93; font-size: 11px;");
+    statusLabel->hide();
+
     // Create macOS-style buttons
     closeButton = new QPushButton("", this);
     minimizeButton = new QPushButton("", this);
@@ -75,6 +80,7 @@ void CustomTitleBar::setupUI()
     layout->addWidget(maximizeButton);
     layout->addWidget(titleLabel);
     layout->addStretch();
+    layout->addWidget(statusLabel);
 }
 
 void CustomTitleBar::setupConnections()
@@ -89,6 +95,12 @@ void CustomTitleBar::setTitle(const QString &title)
     titleLabel->setText(title);
 }
 
+void CustomTitleBar::setStatus(const QString &status)
+{
+    statusLabel->setText(status);
+    statusLabel->setVisible(!status.isEmpty());
+}
+
 void CustomTitleBar::setButtonsEnabled(bool enabled)
 {
     minimizeButton->setEnabled(enabled);
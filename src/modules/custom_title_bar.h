@@ -13,6 +13,7 @@ public:
     explicit CustomTitleBar(QWidget* parent = nullptr);
     
     void setTitle(const QString& title);
+    void setStatus(const QString& status);  // Right-aligned; hidden when empty
     void setButtonsEnabled(bool enabled);
 
 signals:
@@ -35,6 +36,7 @@ private:
     
     QHBoxLayout* layout;
     QLabel* titleLabel;
+    QLabel* statusLabel;
     QPushButton* minimizeButton;
     QPushButton* maximizeButton;
     QPushButton* closeButton;
@@ -1,14 +1,15 @@
 #include "debug_api.h"
 #include "python_engine.h"
 #include "settings_manager.h"
+#include "workspace_files.h"
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QHostAddress>
 #include <QDebug>
 #include <QCoreApplication>
-#include <QDateTime>
-#include <QDir>
-#include <QFile>
+#include <QPointer>
+#include <chrono>
+#include <functional>
 
 DebugAPI::DebugAPI(PythonEngine* pythonEngine, SettingsManager* settingsManager, QObject* parent)
     : QObject(parent), pythonEngine(pythonEngine), settingsManager(settingsManager) {
@@ -96,9 +97,111 @@ void DebugAPI::onClientDataReady() {
     QJsonObject command = doc.object();
     emit debugCommandReceived(command["command"].toString());
     
-    QJsonObject response = processDebugCommand(command);
-    emit debugResponse(response);
+    // Python work is answered once the interpreter thread gets to it
+    if (dispatchToInterpreter(client, command)) {
+        return;
+    }
+    
+    sendResponse(client, processDebugCommand(command));
+}
+
+bool DebugAPI::dispatchToInterpreter(QTcpSocket* client, const QJsonObject& command) {
+    if (!pythonEngine || !pythonEngine->isInitialized()) {
+        return false;
+    }
+    
+    QString cmd = command["command"].toString();
+    if (cmd == "execute") {
+        auto run = std::make_shared<ExecuteRun>();
+        run->socket = client;
+        run->lines = command["code"].toString().split('\n', Qt::SkipEmptyParts);
+        run->timeout = std::chrono::milliseconds(static_cast<long long>(command["timeout"].toDouble(0.0) * 1000.0));
+        continueExecute(run);
+        return true;
+    }
+    if (cmd != "get_variables") {
+        return false;
+    }
+    
+    QPointer<QTcpSocket> socket(client);
+    return pythonEngine->post([this, socket]() {
+        QJsonObject response = getVariables();
+        QMetaObject::invokeMethod(this, [this, socket, response]() {
+            if (socket) {
+                sendResponse(socket, response);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DebugAPI::continueExecute(std::shared_ptr<ExecuteRun> run) {
+    // Special lines touch settings and files, so they run here on the UI thread
+    while (run->next < run->lines.size() && isSpecialCommand(run->lines[run->next])) {
+        QString line = run->lines[run->next++].trimmed();
+        QString result;
+        bool finished = handleSpecialCommand(line, result, [this, run, line](const QString& message) {
+            appendResult(*run, line, message);
+            continueExecute(run);
+        });
+        if (!finished) {
+            return;
+        }
+        appendResult(*run, line, result);
+    }
+    
+    if (run->next == run->lines.size()) {
+        QJsonObject response;
+        response["status"] = "success";
+        response["result"] = formatPythonOutput(run->output);
+        if (run->socket) {
+            sendResponse(run->socket, response);
+        }
+        return;
+    }
+    
+    // The Python lines up to the next special one go to the interpreter as one job
+    QStringList python;
+    while (run->next < run->lines.size() && !isSpecialCommand(run->lines[run->next])) {
+        python.append(run->lines[run->next++].trimmed());
+    }
+    bool queued = pythonEngine->post([this, run, python]() {
+        QStringList results;
+        for (const QString& line : python) {
+            results.append(line.isEmpty() ? QString() : QString::fromStdString(pythonEngine->evaluateExpression(line.toStdString())));
+        }
+        QMetaObject::invokeMethod(this, [this, run, python, results]() {
+            for (qsizetype i = 0; i < python.size(); ++i) {
+                appendResult(*run, python[i], results[i]);
+            }
+            continueExecute(run);
+        }, Qt::QueuedConnection);
+    }, run->timeout);
+    
+    if (!queued && run->socket) {
+        QJsonObject response;
+        response["status"] = "error";
+        response["message"] = "Python engine not initialized";
+        sendResponse(run->socket, response);
+    }
+}
+
+void DebugAPI::appendResult(ExecuteRun& run, const QString& line, const QString& result) {
+    if (line.isEmpty()) {
+        return;
+    }
     
+    // Format output similar to REPL; several lines are separated by a blank line
+    if (run.lines.size() > 1 && !run.output.isEmpty()) {
+        run.output += "\n";
+    }
+    run.output += ">>> " + line + "\n";
+    if (!result.isEmpty()) {
+        run.output += result + "\n";
+    }
+}
+
+void DebugAPI::sendResponse(QTcpSocket* client, const QJsonObject& response) {
+    emit debugResponse(response);
     client->write(QJsonDocument(response).toJson(QJsonDocument::Compact));
 }
 
@@ -116,12 +219,22 @@ QJsonObject DebugAPI::processDebugCommand(const QJsonObject& command) {
     QString cmd = command["command"].toString();
     
     if (cmd == "execute") {
-        QString code = command["code"].toString();
-        return executeCommand(code);
+        // Executed through the interpreter queue whenever Python runs
+        QJsonObject response;
+        response["status"] = "error";
+        response["message"] = "Python engine not initialized";
+        return response;
     } else if (cmd == "get_variables") {
         return getVariables();
     } else if (cmd == "get_system_info") {
         return getSystemInfo();
+    } else if (cmd == "interrupt") {
+        bool interrupted = pythonEngine && pythonEngine->interrupt();
+        QJsonObject response;
+        response["status"] = "success";
+        response["interrupted"] = interrupted;
+        response["message"] = interrupted ? "KeyboardInterrupt raised" : "No command running";
+        return response;
     } else if (cmd == "ping") {
         QJsonObject response;
         response["status"] = "success";
@@ -135,57 +248,6 @@ QJsonObject DebugAPI::processDebugCommand(const QJsonObject& command) {
     }
 }
 
-QJsonObject DebugAPI::executeCommand(const QString& code) {
-    QJsonObject response;
-    
-    if (!pythonEngine || !pythonEngine->isInitialized()) {
-        response["status"] = "error";
-        response["message"] = "Python engine not initialized";
-        return response;
-    }
-    
-    // Accumulate output for multi-line commands
-    accumulatedOutput.clear();
-    
-    // Split code into lines and execute each
-    QStringList lines = code.split('\n', Qt::SkipEmptyParts);
-    QString output;
-    
-    for (const QString& line : lines) {
-        QString trimmedLine = line.trimmed();
-        if (trimmedLine.isEmpty()) continue;
-        
-        QString result;
-        
-        // Check for special commands first
-        if (handleSpecialCommand(trimmedLine)) {
-            // Special command was handled, get the result from lastSpecialCommandResult
-            result = lastSpecialCommandResult;
-        } else {
-            // Regular Python command
-            result = QString::fromStdString(pythonEngine->evaluateExpression(trimmedLine.toStdString()));
-        }
-        
-        // Format output similar to REPL
-        if (lines.size() == 1) {
-            // Single command
-            output += ">>> " + trimmedLine + "\n";
-        } else {
-            // Multi-line - show the command structure
-            if (!output.isEmpty()) output += "\n";
-            output += ">>> " + trimmedLine + "\n";
-        }
-        
-        if (!result.isEmpty()) {
-            output += result + "\n";
-        }
-    }
-    
-    response["status"] = "success";
-    response["result"] = formatPythonOutput(output);
-    return response;
-}
-
 QJsonObject DebugAPI::getVariables() {
     QJsonObject response;
     
@@ -204,6 +266,17 @@ QJsonObject DebugAPI::getVariables() {
         varObj["type"] = QString::fromStdString(var.type);
         varObj["value"] = QString::fromStdString(var.value);
         varObj["display"] = QString::fromStdString(var.displayString);
+        if (var.hasSummary) {
+            QJsonObject summary;
+            summary["count"] = static_cast<qint64>(var.summary.count);
+            summary["min"] = var.summary.minimum;
+            summary["max"] = var.summary.maximum;
+            summary["mean"] = var.summary.mean;
+            if (var.summary.nanCount > 0) {
+                summary["nan_count"] = static_cast<qint64>(var.summary.nanCount);
+            }
+            varObj["summary"] = summary;
+        }
         varsArray.append(varObj);
     }
     
@@ -230,339 +303,78 @@ QString DebugAPI::formatPythonOutput(const QString& output) {
     return output.trimmed();
 }
 
-bool DebugAPI::handleSpecialCommand(const QString& command) {
+bool DebugAPI::isSpecialCommand(const QString& command) {
+    QString cmd = command.toLower().trimmed();
+    return cmd == "clear" || cmd == "clear vars" || cmd == "ls" || cmd == "help" ||
+           cmd == "save" || cmd.startsWith("save ") ||
+           cmd == "load" || cmd.startsWith("load ") || cmd == "restore";
+}
+
+bool DebugAPI::handleSpecialCommand(const QString& command, QString& result, const SpecialFinished& onFinished) {
     QString cmd = command.toLower().trimmed();
     
     if (cmd == "clear") {
-        lastSpecialCommandResult = "Output cleared";
+        result = "Output cleared";
         return true;
     }
     else if (cmd == "clear vars") {
-        // Clear Python variables
-        if (pythonEngine && pythonEngine->isInitialized()) {
-            auto variables = pythonEngine->getUserVariables();
-            for (const auto& var : variables) {
-                QString deleteCmd = QString("del %1").arg(QString::fromStdString(var.name));
-                pythonEngine->evaluateExpression(deleteCmd.toStdString());
-            }
+        // Queued behind the Python lines before it, so the GUI does not wait
+        if (pythonEngine) {
+            pythonEngine->clearUserVariables();
         }
-        lastSpecialCommandResult = "Variables cleared";
+        result = "Variables cleared";
         return true;
     }
     else if (cmd == "save" || cmd.startsWith("save ")) {
-        // Parse save command arguments
-        QString args = cmd.startsWith("save ") ? cmd.mid(5).trimmed() : "";
-        QStringList parts = args.split(' ', Qt::SkipEmptyParts);
-        
-        QString varName = "";
-        QString fileName = "";
-        
-        if (parts.size() == 0) {
-            // "save" - save all variables with timestamp
-        } else if (parts.size() == 1) {
-            // Could be "save filename" or "save varname"
-            // Check if it's a valid variable name by checking if it exists
-            QString checkCode = QString("'%1' in globals()").arg(parts[0]);
-            std::string exists = pythonEngine->evaluateExpression(checkCode.toStdString());
-            if (exists == "True") {
-                // It's a variable name
-                varName = parts[0];
-            } else {
-                // It's a filename
-                fileName = parts[0];
-            }
-        } else if (parts.size() == 2) {
-            // "save varname filename"
-            varName = parts[0];
-            fileName = parts[1];
-        }
-        
-        lastSpecialCommandResult = saveVariablesToPickle(fileName, varName);
-        return true;
+        // Variable and file names keep their case, so parse the original command
+        QStringList arguments = command.trimmed().mid(4).split(' ', Qt::SkipEmptyParts);
+        QString directory = WorkspaceFiles::defaultDirectory(settingsManager);
+        startTransfer(onFinished, [this, directory, arguments](WorkspaceFiles::Finished done) {
+            WorkspaceFiles::save(pythonEngine, directory, arguments, nullptr, std::move(done));
+        });
+        return false;
     }
     else if (cmd == "load" || cmd.startsWith("load ")) {
-        if (cmd == "load") {
-            lastSpecialCommandResult = "Error: Please specify a filename";
-        } else {
-            QString filename = cmd.mid(5).trimmed(); // Extract filename after "load "
-            if (!filename.isEmpty()) {
-                lastSpecialCommandResult = loadVariablesFromPickle(filename);
-            } else {
-                lastSpecialCommandResult = "Error: Please specify a filename";
-            }
+        QString filename = command.trimmed().mid(5).trimmed();
+        if (filename.isEmpty()) {
+            result = "Error: Please specify a filename";
+            return true;
         }
-        return true;
+        QString directory = WorkspaceFiles::defaultDirectory(settingsManager);
+        startTransfer(onFinished, [this, directory, filename](WorkspaceFiles::Finished done) {
+            WorkspaceFiles::load(pythonEngine, directory, filename, nullptr, std::move(done));
+        });
+        return false;
+    }
+    else if (cmd == "restore") {
+        QString directory = WorkspaceFiles::defaultDirectory(settingsManager);
+        startTransfer(onFinished, [this, directory](WorkspaceFiles::Finished done) {
+            WorkspaceFiles::restore(pythonEngine, directory, std::move(done));
+        });
+        return false;
     }
     else if (cmd == "ls") {
-        lastSpecialCommandResult = listPickleFiles();
+        result = WorkspaceFiles::describeFiles(WorkspaceFiles::defaultDirectory(settingsManager));
         return true;
     }
     else if (cmd == "help") {
-        lastSpecialCommandResult = getHelpText();
+        result = getHelpText();
         return true;
     }
     
-    return false;
-}
-
-QString DebugAPI::getDefaultPickleDirectory() const
-{
-    // First priority: Check for custom data_dir in configuration
-    if (settingsManager && settingsManager->contains("data_dir")) {
-        QString customDir = settingsManager->getString("data_dir");
-        if (!customDir.isEmpty()) {
-            // Test if we can create/access this directory
-            QDir dir(customDir);
-            if (dir.exists() || dir.mkpath(customDir)) {
-                // Test write permissions by creating a temporary test file
-                QString testFile = customDir + "/.write_test";
-                QFile file(testFile);
-                if (file.open(QIODevice::WriteOnly)) {
-                    file.close();
-                    file.remove(); // Clean up test file
-                    return customDir;
-                }
-            }
-            // Custom directory failed, continue to fallbacks
-        }
-    }
-    
-    // Second priority: Try Documents directory (preferred location)
-    QString documentsPath = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
-    if (!documentsPath.isEmpty()) {
-        QString preferredDir = documentsPath + "/LumosWorkspace";
-        
-        // Test if we can create/access this directory
-        QDir dir(preferredDir);
-        if (dir.exists() || dir.mkpath(preferredDir)) {
-            // Test write permissions by creating a temporary test file
-            QString testFile = preferredDir + "/.write_test";
-            QFile file(testFile);
-            if (file.open(QIODevice::WriteOnly)) {
-                file.close();
-                file.remove(); // Clean up test file
-                return preferredDir;
-            }
-        }
-    }
-    
-    // Final fallback: /tmp/LumosWorkspace
-    return "/tmp/LumosWorkspace";
-}
-
-QString DebugAPI::saveVariablesToPickle(const QString& customName, const QString& varName) {
-    if (!pythonEngine || !pythonEngine->isInitialized()) {
-        return "Error: Python engine not initialized";
-    }
-
-    // Get default pickle directory
-    QString pickleDir = getDefaultPickleDirectory();
-    
-    // Ensure directory exists
-    QDir dir(pickleDir);
-    if (!dir.exists()) {
-        if (!dir.mkpath(pickleDir)) {
-            return QString("Error: Could not create directory %1").arg(pickleDir);
-        }
-    }
-    
-    // Determine filename
-    QString filename;
-    if (customName.isEmpty()) {
-        // Use timestamp with variable-specific prefix if saving single variable
-        QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss");
-        if (varName.isEmpty()) {
-            filename = QString("saved_variables_%1.pickle").arg(timestamp);
-        } else {
-            filename = QString("saved_%1_%2.pickle").arg(varName).arg(timestamp);
-        }
-    } else {
-        // Use custom name, ensure .pickle extension
-        filename = customName;
-        if (!filename.endsWith(".pickle")) {
-            filename += ".pickle";
-        }
-    }
-    
-    QString fullPath = pickleDir + "/" + filename;
-    
-    // Execute save operation step by step to avoid compilation issues
-    pythonEngine->evaluateExpression("import pickle, os");
-    pythonEngine->evaluateExpression("globals_snapshot = dict(globals())");
-    
-    QString filterCode;
-    if (varName.isEmpty()) {
-        // Save all user variables
-        filterCode = QString(R"(
-user_vars = {}
-for name, value in globals_snapshot.items():
-    if not name.startswith('__') and name not in ['pickle', 'os', 'user_vars', 'globals_snapshot', 'name', 'value', 'f', 'saved_count', 'result_message']:
-        try:
-            user_vars[name] = value
-        except:
-            pass
-)");
-    } else {
-        // Save only the specified variable
-        filterCode = QString(R"(
-user_vars = {}
-if '%1' in globals_snapshot:
-    try:
-        user_vars['%1'] = globals_snapshot['%1']
-    except:
-        pass
-)").arg(varName);
-    }
-    pythonEngine->evaluateExpression(filterCode.toStdString());
-    
-    QString saveCode;
-    if (varName.isEmpty()) {
-        saveCode = QString(R"(
-try:
-    with open(r'%1', 'wb') as f:
-        pickle.dump(user_vars, f)
-    saved_count = len(user_vars)
-    result_message = f'Saved {saved_count} variables to %2'
-except Exception as e:
-    result_message = f'Error saving variables: {str(e)}'
-)").arg(fullPath).arg(filename);
-    } else {
-        saveCode = QString(R"(
-try:
-    with open(r'%1', 'wb') as f:
-        pickle.dump(user_vars, f)
-    if len(user_vars) > 0:
-        result_message = f'Saved variable "%3" to %2'
-    else:
-        result_message = f'Error: Variable "%3" not found'
-except Exception as e:
-    result_message = f'Error saving variable: {str(e)}'
-)").arg(fullPath).arg(filename).arg(varName);
-    }
-    
-    pythonEngine->evaluateExpression(saveCode.toStdString());
-    std::string result = pythonEngine->evaluateExpression("result_message");
-    
-    // Clean up variables that were created during save operation
-    pythonEngine->evaluateExpression(R"(
-try:
-    del pickle, os, user_vars, globals_snapshot, name, value, f, saved_count, result_message
-except:
-    pass
-)");
-    
-    if (result.empty()) {
-        return QString("Variables saved to %1").arg(filename);
-    }
-    
-    return QString::fromStdString(result);
+    result.clear();
+    return true;
 }
 
-QString DebugAPI::loadVariablesFromPickle(const QString& filename) {
-    if (!pythonEngine || !pythonEngine->isInitialized()) {
-        return "Error: Python engine not initialized";
-    }
-
-    // Get default pickle directory
-    QString pickleDir = getDefaultPickleDirectory();
-    
-    // Determine full file path
-    QString actualFilename = filename;
-    if (!actualFilename.endsWith(".pickle")) {
-        actualFilename += ".pickle";
-    }
-    
-    QString fullPath = pickleDir + "/" + actualFilename;
-    
-    // Create Python code to load variables from pickle
-    QString pythonCode = QString(R"(
-import pickle
-import os
-
-# Check if file exists
-if not os.path.exists(r'%1'):
-    result_message = 'Error: File not found: %2'
-else:
-    try:
-        # Load variables from pickle file
-        with open(r'%1', 'rb') as f:
-            loaded_vars = pickle.load(f)
-        
-        # Add variables to global namespace
-        loaded_count = 0
-        if isinstance(loaded_vars, dict):
-            for var_name, var_value in loaded_vars.items():
-                if not var_name.startswith('__'):
-                    globals()[var_name] = var_value
-                    loaded_count += 1
-            
-            result_message = f'Loaded {loaded_count} variables from %2'
-        else:
-            result_message = 'Error: Pickle file does not contain a dictionary'
-            
-    except Exception as e:
-        result_message = f'Error loading variables: {str(e)}'
-
-print(result_message)
-)").arg(fullPath).arg(actualFilename);
-
-    // Execute the Python code
-    std::string result = pythonEngine->evaluateExpression(pythonCode.toStdString());
-    
-    // Clean up variables that were created during load operation (but keep loaded user variables)
-    pythonEngine->evaluateExpression(R"(
-try:
-    del pickle, os, loaded_vars, loaded_count, var_name, var_value, result_message, f
-except:
-    pass
-)");
-    
-    if (result.empty()) {
-        return QString("Variables loaded from %1").arg(actualFilename);
-    }
-    
-    return QString::fromStdString(result);
-}
-
-QString DebugAPI::listPickleFiles() const
-{
-    QString pickleDir = getDefaultPickleDirectory();
-    
-    // Check if directory exists
-    QDir dir(pickleDir);
-    if (!dir.exists()) {
-        return QString("No data directory found at: %1").arg(pickleDir);
-    }
-    
-    // Get all .pickle files in the directory
-    QStringList nameFilters;
-    nameFilters << "*.pickle";
-    QFileInfoList fileList = dir.entryInfoList(nameFilters, QDir::Files, QDir::Time | QDir::Reversed);
-    
-    if (fileList.isEmpty()) {
-        return QString("No pickle files found in: %1").arg(pickleDir);
-    }
-    
-    // Format the file list
-    QString result = QString("Pickle files in %1:\n").arg(pickleDir);
-    for (const QFileInfo& fileInfo : fileList) {
-        QString fileName = fileInfo.fileName();
-        QString fileSize;
-        
-        qint64 size = fileInfo.size();
-        if (size < 1024) {
-            fileSize = QString("%1 B").arg(size);
-        } else if (size < 1024 * 1024) {
-            fileSize = QString("%.1f KB").arg(size / 1024.0);
-        } else {
-            fileSize = QString("%.1f MB").arg(size / (1024.0 * 1024.0));
-        }
-        
-        QString lastModified = fileInfo.lastModified().toString("yyyy-MM-dd hh:mm:ss");
-        result += QString("  %1 (%2, %3)\n").arg(fileName, fileSize, lastModified);
-    }
-    
-    return result.trimmed(); // Remove trailing newline
+void DebugAPI::startTransfer(const SpecialFinished& onFinished,
+                             const std::function<void(std::function<void(const QString& message)>)>& start) {
+    // The transfer finishes on a worker thread; the result comes back here
+    // unless the API is gone by then
+    start([this, onFinished](const QString& message) {
+        QMetaObject::invokeMethod(this, [onFinished, message]() {
+            onFinished(message);
+        }, Qt::QueuedConnection);
+    });
 }
 
 QString DebugAPI::getHelpText() const {
@@ -579,6 +391,7 @@ LumosWorkspace REPL - Help & Commands
   Enter               - Execute command
   Shift+Enter         - Multi-line input (new line)
   Up/Down arrows      - Navigate command history
+  Ctrl+C              - Interrupt the running command (KeyboardInterrupt)
   
 🔧 SPECIAL COMMANDS:
   help                - Show this help message
@@ -589,12 +402,17 @@ LumosWorkspace REPL - Help & Commands
   save [name]         - Save all variables to pickle file
                        'save' → saved_variables_TIMESTAMP.pickle
                        'save my_data' → my_data.pickle
+                       'save my_data.lumos' → numeric arrays only,
+                       loaded as views of the file without copying
                        
   load filename       - Load variables from pickle file
                        'load my_data' → loads my_data.pickle
                        'load data.pickle' → loads data.pickle
                        
-  ls                  - List all pickle files in data directory
+  restore             - Restore the variables of the previous session
+                       from its last automatic checkpoint
+                       
+  ls                  - List all workspace files in data directory
                        Shows filename, size, and modification date
   
 📝 EXAMPLES:
@@ -4,7 +4,11 @@
 #include <QTcpServer>
 #include <QTcpSocket>
 #include <QJsonObject>
+#include <QPointer>
 #include <QStandardPaths>
+#include <QStringList>
+#include <chrono>
+#include <functional>
 #include <memory>
 
 class PythonEngine;
@@ -34,21 +38,36 @@ private slots:
 
 private:
     QJsonObject processDebugCommand(const QJsonObject& command);
-    QJsonObject executeCommand(const QString& code);
+    bool dispatchToInterpreter(QTcpSocket* client, const QJsonObject& command);
+    void sendResponse(QTcpSocket* client, const QJsonObject& response);
+    static bool isSpecialCommand(const QString& command);
+    
+    // An execute request worked through in order: each run of Python lines
+    // as one interpreter job, special lines on the UI thread in between. The
+    // reply goes out after the last line.
+    struct ExecuteRun {
+        QPointer<QTcpSocket> socket;
+        QStringList lines;
+        qsizetype next = 0;
+        QString output;
+        std::chrono::milliseconds timeout{0};
+    };
+    void continueExecute(std::shared_ptr<ExecuteRun> run);
+    static void appendResult(ExecuteRun& run, const QString& line, const QString& result);
     QJsonObject getVariables();
     QJsonObject getSystemInfo();
     QString formatPythonOutput(const QString& output);
-    bool handleSpecialCommand(const QString& command);
-    QString saveVariablesToPickle(const QString& customName = "", const QString& varName = "");
-    QString loadVariablesFromPickle(const QString& filename);
-    QString listPickleFiles() const;
-    QString getDefaultPickleDirectory() const;
+    // Returns true with `result` set when the command is done; save, load
+    // and restore return false and report through `onFinished` on the UI
+    // thread once the file is through, so the GUI never waits for them
+    using SpecialFinished = std::function<void(const QString& result)>;
+    bool handleSpecialCommand(const QString& command, QString& result, const SpecialFinished& onFinished);
+    void startTransfer(const SpecialFinished& onFinished,
+                       const std::function<void(std::function<void(const QString& message)>)>& start);
     QString getHelpText() const;
     
     PythonEngine* pythonEngine;
     SettingsManager* settingsManager;
     std::unique_ptr<QTcpServer> debugServer;
     QList<QTcpSocket*> debugClients;
-    QString accumulatedOutput;
-    QString lastSpecialCommandResult;
 };
\ No newline at end of file
@@ -0,0 +1,201 @@
+#include "json_to_python.h"
+#include "python_engine.h"
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QVariant>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+PyObject* stringToPython(const QString& string) {
+    QByteArray utf8 = string.toUtf8();
+    return PyUnicode_FromStringAndSize(utf8.constData(), utf8.size());
+}
+
+PyObject* numberToPython(const QJsonValue& value) {
+    // The JSON parser keeps integers written without fraction or exponent as
+    // integers; report those as int so 2 and 2.0 stay distinct
+    if (value.toVariant().typeId() == QMetaType::LongLong) {
+        return PyLong_FromLongLong(value.toInteger());
+    }
+    return PyFloat_FromDouble(value.toDouble());
+}
+
+PyObject* arrayToPython(const QJsonArray& array) {
+    PyObject* list = PyList_New(array.size());
+    if (!list) {
+        return nullptr;
+    }
+    for (qsizetype i = 0; i < array.size(); ++i) {
+        PyObject* item = jsonToPython(array.at(i));
+        if (!item) {
+            Py_DECREF(list);
+            return nullptr;
+        }
+        // Steals the reference
+        PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+}
+
+PyObject* objectToPython(const QJsonObject& object) {
+    PyObject* dict = PyDict_New();
+    if (!dict) {
+        return nullptr;
+    }
+    for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+        PyObject* key = stringToPython(it.key());
+        PyObject* item = key ? jsonToPython(it.value()) : nullptr;
+        bool ok = item && PyDict_SetItem(dict, key, item) == 0;
+        Py_XDECREF(item);
+        Py_XDECREF(key);
+        if (!ok) {
+            Py_DECREF(dict);
+            return nullptr;
+        }
+    }
+    return dict;
+}
+
+// Convert one element to T, or set a ValueError naming its index. Integers
+// are taken exactly as the parser kept them, and a double only when it is
+// integral and T holds it, so nothing past 2^53 is rounded and no value is
+// wrapped or cast out of range.
+template <typename T>
+bool packElement(const QJsonValue& value, qsizetype index, const char* typeName, T& element) {
+    if (!value.isDouble()) {
+        PyErr_Format(PyExc_ValueError, "element %zd is not a number", static_cast<Py_ssize_t>(index));
+        return false;
+    }
+    
+    if constexpr (std::is_floating_point_v<T>) {
+        double number = value.toDouble();
+        if (std::isfinite(number) && std::fabs(number) > static_cast<double>(std::numeric_limits<T>::max())) {
+            PyErr_Format(PyExc_ValueError, "element %zd is out of range for %s",
+                         static_cast<Py_ssize_t>(index), typeName);
+            return false;
+        }
+        element = static_cast<T>(number);
+        return true;
+    } else {
+        if (value.toVariant().typeId() == QMetaType::LongLong) {
+            qint64 integer = value.toInteger();
+            bool fits;
+            if constexpr (std::is_signed_v<T>) {
+                fits = integer >= std::numeric_limits<T>::min() && integer <= std::numeric_limits<T>::max();
+            } else {
+                fits = integer >= 0 && static_cast<uint64_t>(integer) <= std::numeric_limits<T>::max();
+            }
+            if (!fits) {
+                PyErr_Format(PyExc_ValueError, "element %zd is out of range for %s",
+                             static_cast<Py_ssize_t>(index), typeName);
+                return false;
+            }
+            element = static_cast<T>(integer);
+            return true;
+        }
+        
+        // Bounds are powers of two, exact as doubles; NaN fails both
+        double number = value.toDouble();
+        double lowest = static_cast<double>(std::numeric_limits<T>::min());
+        double limit = std::ldexp(1.0, std::numeric_limits<T>::digits);
+        if (!(number >= lowest && number < limit) || std::trunc(number) != number) {
+            PyErr_Format(PyExc_ValueError, "element %zd is not an integer in the range of %s",
+                         static_cast<Py_ssize_t>(index), typeName);
+            return false;
+        }
+        element = static_cast<T>(number);
+        return true;
+    }
+}
+
+template <typename T>
+bool packElements(const QJsonArray& array, LumosArray::ElementType type, char* out) {
+    const char* typeName = LumosArray::elementTypeName(type);
+    for (qsizetype i = 0; i < array.size(); ++i) {
+        T element;
+        if (!packElement(array.at(i), i, typeName, element)) {
+            return false;
+        }
+        std::memcpy(out + i * sizeof(T), &element, sizeof(T));
+    }
+    return true;
+}
+
+bool packElements(const QJsonArray& array, LumosArray::ElementType type, char* out) {
+    switch (type) {
+    case LumosArray::ElementType::Int8: return packElements<int8_t>(array, type, out);
+    case LumosArray::ElementType::UInt8: return packElements<uint8_t>(array, type, out);
+    case LumosArray::ElementType::Int16: return packElements<int16_t>(array, type, out);
+    case LumosArray::ElementType::UInt16: return packElements<uint16_t>(array, type, out);
+    case LumosArray::ElementType::Int32: return packElements<int32_t>(array, type, out);
+    case LumosArray::ElementType::UInt32: return packElements<uint32_t>(array, type, out);
+    case LumosArray::ElementType::Int64: return packElements<int64_t>(array, type, out);
+    case LumosArray::ElementType::UInt64: return packElements<uint64_t>(array, type, out);
+    case LumosArray::ElementType::Float32: return packElements<float>(array, type, out);
+    case LumosArray::ElementType::Float64: return packElements<double>(array, type, out);
+    }
+    return false;
+}
+
+}  // namespace
+
+PyObject* jsonToPython(const QJsonValue& value) {
+    switch (value.type()) {
+    case QJsonValue::Bool:
+        return PyBool_FromLong(value.toBool());
+    case QJsonValue::Double:
+        return numberToPython(value);
+    case QJsonValue::String:
+        return stringToPython(value.toString());
+    case QJsonValue::Array:
+        return arrayToPython(value.toArray());
+    case QJsonValue::Object:
+        return objectToPython(value.toObject());
+    case QJsonValue::Null:
+        Py_RETURN_NONE;
+    case QJsonValue::Undefined:
+        break;
+    }
+    PyErr_SetString(PyExc_ValueError, "undefined JSON value");
+    return nullptr;
+}
+
+PyObject* jsonToArray(PythonEngine& engine, const QJsonValue& elements, LumosArray::ElementType type) {
+    size_t elementSize = LumosArray::elementSize(type);
+    
+    if (elements.isArray()) {
+        QJsonArray array = elements.toArray();
+        auto storage = std::make_shared<std::vector<char>>(static_cast<size_t>(array.size()) * elementSize);
+        if (!packElements(array, type, storage->data())) {
+            return nullptr;
+        }
+        return engine.createArray(storage, storage->data(), static_cast<size_t>(array.size()), type);
+    }
+    
+    if (elements.isString()) {
+        QByteArray::FromBase64Result decoded = QByteArray::fromBase64Encoding(
+            elements.toString().toLatin1(), QByteArray::AbortOnBase64DecodingErrors);
+        if (!decoded) {
+            PyErr_SetString(PyExc_ValueError, "array data is not valid base64");
+            return nullptr;
+        }
+        auto bytes = std::make_shared<QByteArray>(std::move(decoded.decoded));
+        if (bytes->size() % static_cast<qsizetype>(elementSize) != 0) {
+            PyErr_Format(PyExc_ValueError, "%zd bytes is not a whole number of %s elements",
+                         static_cast<Py_ssize_t>(bytes->size()), LumosArray::elementTypeName(type));
+            return nullptr;
+        }
+        return engine.createArray(bytes, bytes->constData(), static_cast<size_t>(bytes->size()) / elementSize, type);
+    }
+    
+    PyErr_SetString(PyExc_TypeError, "array data must be a list of numbers or a base64 string");
+    return nullptr;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "lumos_array.h"
+
+class QJsonValue;
+class PythonEngine;
+
+// Build the Python object for a JSON value in one pass: numbers become int or
+// float as written, strings str, arrays list, objects dict, null None.
+// Call attached to the interpreter. Returns a new reference, or nullptr with
+// a Python exception set.
+PyObject* jsonToPython(const QJsonValue& value);
+
+// Build a lumos.Array of `type` elements from a JSON array of numbers, or from
+// a base64 string holding the elements in native byte order. The packed or
+// decoded buffer becomes the array's storage and is not copied again. An
+// element that is not a number, or not an integer `type` holds, raises a
+// ValueError naming its index; so does a string that is not valid base64.
+PyObject* jsonToArray(PythonEngine& engine, const QJsonValue& elements, LumosArray::ElementType type);
@@ -0,0 +1,228 @@
+#include "lumos_array.h"
+#include "python_engine.h"
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+namespace {
+
+struct ElementInfo {
+    const char* name;
+    const char* format;  // struct module format character
+    Py_ssize_t size;
+};
+
+const ElementInfo elementInfo[] = {
+    {"int8", "b", 1},
+    {"uint8", "B", 1},
+    {"int16", "h", 2},
+    {"uint16", "H", 2},
+    {"int32", "i", 4},
+    {"uint32", "I", 4},
+    {"int64", "q", 8},
+    {"uint64", "Q", 8},
+    {"float32", "f", 4},
+    {"float64", "d", 8}
+};
+
+const ElementInfo& info(LumosArray::ElementType type) {
+    return elementInfo[static_cast<int>(type)];
+}
+
+// Instance layout; owner is constructed in place since Python allocates the memory
+struct ArrayObject {
+    PyObject_HEAD
+    std::shared_ptr<const void> owner;
+    const char* data;
+    Py_ssize_t shape;
+    Py_ssize_t itemSize;
+    LumosArray::ElementType type;
+};
+
+template <typename T>
+T loadElement(const char* address) {
+    T value;
+    std::memcpy(&value, address, sizeof(T));
+    return value;
+}
+
+PyObject* elementToPython(const ArrayObject* array, Py_ssize_t index) {
+    const char* address = array->data + index * array->itemSize;
+    switch (array->type) {
+    case LumosArray::ElementType::Int8: return PyLong_FromLong(loadElement<int8_t>(address));
+    case LumosArray::ElementType::UInt8: return PyLong_FromUnsignedLong(loadElement<uint8_t>(address));
+    case LumosArray::ElementType::Int16: return PyLong_FromLong(loadElement<int16_t>(address));
+    case LumosArray::ElementType::UInt16: return PyLong_FromUnsignedLong(loadElement<uint16_t>(address));
+    case LumosArray::ElementType::Int32: return PyLong_FromLong(loadElement<int32_t>(address));
+    case LumosArray::ElementType::UInt32: return PyLong_FromUnsignedLong(loadElement<uint32_t>(address));
+    case LumosArray::ElementType::Int64: return PyLong_FromLongLong(loadElement<int64_t>(address));
+    case LumosArray::ElementType::UInt64: return PyLong_FromUnsignedLongLong(loadElement<uint64_t>(address));
+    case LumosArray::ElementType::Float32: return PyFloat_FromDouble(loadElement<float>(address));
+    case LumosArray::ElementType::Float64: return PyFloat_FromDouble(loadElement<double>(address));
+    }
+    return nullptr;
+}
+
+void arrayDealloc(PyObject* self) {
+    PyTypeObject* type = Py_TYPE(self);
+    ((ArrayObject*)self)->owner.~shared_ptr();
+    type->tp_free(self);
+    Py_DECREF(type);
+}
+
+int arrayGetBuffer(PyObject* self, Py_buffer* view, int flags) {
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "lumos.Array is read-only");
+        view->obj = nullptr;
+        return -1;
+    }
+
+    ArrayObject* array = (ArrayObject*)self;
+    view->obj = Py_NewRef(self);
+    view->buf = const_cast<char*>(array->data);
+    view->len = array->shape * array->itemSize;
+    view->readonly = 1;
+    view->itemsize = array->itemSize;
+    view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(info(array->type).format) : nullptr;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? &array->shape : nullptr;
+    view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? &array->itemSize : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+Py_ssize_t arrayLength(PyObject* self) {
+    return ((ArrayObject*)self)->shape;
+}
+
+PyObject* arrayItem(PyObject* self, Py_ssize_t index) {
+    // Negative indices were already adjusted by the sequence protocol
+    ArrayObject* array = (ArrayObject*)self;
+    if (index < 0 || index >= array->shape) {
+        PyErr_SetString(PyExc_IndexError, "lumos.Array index out of range");
+        return nullptr;
+    }
+    return elementToPython(array, index);
+}
+
+PyObject* arrayToList(PyObject* self, PyObject* unused) {
+    (void)unused;
+    ArrayObject* array = (ArrayObject*)self;
+    PyObject* list = PyList_New(array->shape);
+    for (Py_ssize_t i = 0; list && i < array->shape; ++i) {
+        PyObject* item = elementToPython(array, i);
+        if (!item) {
+            Py_CLEAR(list);
+            break;
+        }
+        PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+}
+
+PyObject* arrayReduce(PyObject* self, PyObject* unused) {
+    // Pickles as an array.array of the same elements; the typecodes match the formats
+    (void)unused;
+    ArrayObject* array = (ArrayObject*)self;
+    PyObject* module = PyImport_ImportModule("array");
+    PyObject* constructor = module ? PyObject_GetAttrString(module, "array") : nullptr;
+    PyObject* elements = constructor ? PyBytes_FromStringAndSize(array->data, array->shape * array->itemSize) : nullptr;
+    Py_XDECREF(module);
+    if (!elements) {
+        Py_XDECREF(constructor);
+        return nullptr;
+    }
+    return Py_BuildValue("N(sN)", constructor, info(array->type).format, elements);
+}
+
+PyObject* arrayRepr(PyObject* self) {
+    // Never lists the elements; arrays can be large
+    ArrayObject* array = (ArrayObject*)self;
+    return PyUnicode_FromFormat("lumos.Array(%s, %zd elements)", info(array->type).name, array->shape);
+}
+
+PyObject* arrayDtype(PyObject* self, void* closure) {
+    (void)closure;
+    return PyUnicode_FromString(info(((ArrayObject*)self)->type).name);
+}
+
+PyObject* arrayNbytes(PyObject* self, void* closure) {
+    (void)closure;
+    ArrayObject* array = (ArrayObject*)self;
+    return PyLong_FromSsize_t(array->shape * array->itemSize);
+}
+
+}  // namespace
+
+bool LumosArray::parseElementType(const std::string& name, ElementType& type) {
+    for (size_t i = 0; i < sizeof(elementInfo) / sizeof(elementInfo[0]); ++i) {
+        if (name == elementInfo[i].name) {
+            type = static_cast<ElementType>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* LumosArray::elementTypeName(ElementType type) {
+    return info(type).name;
+}
+
+const char* LumosArray::elementFormat(ElementType type) {
+    return info(type).format;
+}
+
+size_t LumosArray::elementSize(ElementType type) {
+    return static_cast<size_t>(info(type).size);
+}
+
+PyObject* LumosArray::createType() {
+    static PyMethodDef methods[] = {
+        {"tolist", (PyCFunction)&arrayToList, METH_NOARGS, "Copy the elements into a list"},
+        {"__reduce__", (PyCFunction)&arrayReduce, METH_NOARGS, "Pickle support; unpickles as array.array"},
+        {nullptr, nullptr, 0, nullptr}
+    };
+    static PyGetSetDef getset[] = {
+        {"dtype", &arrayDtype, nullptr, "Element type name", nullptr},
+        {"nbytes", &arrayNbytes, nullptr, "Size of the element buffer in bytes", nullptr},
+        {nullptr, nullptr, nullptr, nullptr, nullptr}
+    };
+    static PyType_Slot slots[] = {
+        {Py_tp_dealloc, (void*)&arrayDealloc},
+        {Py_tp_repr, (void*)&arrayRepr},
+        {Py_tp_methods, methods},
+        {Py_tp_getset, getset},
+        {Py_sq_length, (void*)&arrayLength},
+        {Py_sq_item, (void*)&arrayItem},
+        {Py_bf_getbuffer, (void*)&arrayGetBuffer},
+        {0, nullptr}
+    };
+    static PyType_Spec spec = {
+        "lumos.Array",
+        sizeof(ArrayObject),
+        0,
+        Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+        slots
+    };
+    return PyType_FromSpec(&spec);
+}
+
+PyObject* LumosArray::create(PyObject* type, std::shared_ptr<const void> owner, const void* data,
+                             size_t count, ElementType elementType) {
+    if (!type) {
+        PyErr_SetString(PyExc_RuntimeError, "lumos.Array is not available in this interpreter");
+        return nullptr;
+    }
+
+    ArrayObject* array = PyObject_New(ArrayObject, (PyTypeObject*)type);
+    if (!array) {
+        return nullptr;
+    }
+    new (&array->owner) std::shared_ptr<const void>(std::move(owner));
+    array->data = static_cast<const char*>(data);
+    array->shape = static_cast<Py_ssize_t>(count);
+    array->itemSize = info(elementType).size;
+    array->type = elementType;
+    return (PyObject*)array;
+}
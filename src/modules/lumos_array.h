@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Matches the declaration in Python.h
+typedef struct _object PyObject;
+
+// lumos.Array: a read-only, one-dimensional numeric array whose elements stay
+// in a C++ buffer. Python sees them through the buffer protocol, so
+// memoryview() and numpy.asarray() use the buffer without copying it; indexing,
+// len() and tolist() work without numpy. The buffer lives as long as the
+// Python object.
+class LumosArray {
+public:
+    enum class ElementType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Int64, UInt64, Float32, Float64 };
+
+    // Names as numpy spells them ("int32", "float64", ...)
+    static bool parseElementType(const std::string& name, ElementType& type);
+    static const char* elementTypeName(ElementType type);
+    // struct module format character ("i", "d", ...)
+    static const char* elementFormat(ElementType type);
+    static size_t elementSize(ElementType type);
+
+    // Type object for the calling interpreter; owned by the caller
+    static PyObject* createType();
+
+    // New array over `count` elements at `data`. `owner` keeps that memory
+    // alive and is released when the object is collected. Call attached to
+    // the interpreter that created `type`.
+    static PyObject* create(PyObject* type, std::shared_ptr<const void> owner, const void* data,
+                            size_t count, ElementType elementType);
+};
@@ -0,0 +1,179 @@
+#include "lumos_module.h"
+#include "python_engine.h"
+
+namespace {
+
+const char* engineCapsuleName = "lumos._engine";
+
+struct ModuleState {
+    PythonEngine* engine;
+};
+
+PythonEngine* moduleEngine(PyObject* module) {
+    return static_cast<ModuleState*>(PyModule_GetState(module))->engine;
+}
+
+PyObject* statsToDict(const PythonEngine::StreamStats& stats) {
+    return Py_BuildValue("{s:K,s:K,s:d,s:d,s:d,s:d}",
+                         "messages", static_cast<unsigned long long>(stats.messages),
+                         "dropped", static_cast<unsigned long long>(stats.dropped),
+                         "rate", stats.rate,
+                         "latency_ms", stats.latencyMs,
+                         "mean_latency_ms", stats.meanLatencyMs,
+                         "seconds_since_update", stats.secondsSinceUpdate);
+}
+
+PyObject* lumosStreams(PyObject* module, PyObject* unused) {
+    (void)unused;
+    std::vector<PythonEngine::StreamStats> stats = moduleEngine(module)->getStreamStats();
+    PyObject* names = PyList_New(static_cast<Py_ssize_t>(stats.size()));
+    for (size_t i = 0; names && i < stats.size(); ++i) {
+        PyObject* name = PyUnicode_FromString(stats[i].name.c_str());
+        if (!name) {
+            Py_CLEAR(names);
+            break;
+        }
+        PyList_SET_ITEM(names, static_cast<Py_ssize_t>(i), name);
+    }
+    return names;
+}
+
+PyObject* lumosStats(PyObject* module, PyObject* args) {
+    const char* name = nullptr;
+    if (!PyArg_ParseTuple(args, "|s:stats", &name)) {
+        return nullptr;
+    }
+
+    std::vector<PythonEngine::StreamStats> stats = moduleEngine(module)->getStreamStats();
+    if (name) {
+        for (const PythonEngine::StreamStats& stream : stats) {
+            if (stream.name == name) {
+                return statsToDict(stream);
+            }
+        }
+        PyErr_Format(PyExc_KeyError, "no stream named '%s'", name);
+        return nullptr;
+    }
+
+    PyObject* all = PyDict_New();
+    for (const PythonEngine::StreamStats& stream : stats) {
+        PyObject* entry = all ? statsToDict(stream) : nullptr;
+        if (!entry || PyDict_SetItemString(all, stream.name.c_str(), entry) < 0) {
+            Py_XDECREF(entry);
+            Py_CLEAR(all);
+            break;
+        }
+        Py_DECREF(entry);
+    }
+    return all;
+}
+
+PyObject* lumosGetLatest(PyObject* module, PyObject* args) {
+    const char* name = nullptr;
+    PyObject* fallback = nullptr;
+    if (!PyArg_ParseTuple(args, "s|O:get_latest", &name, &fallback)) {
+        return nullptr;
+    }
+
+    PyObject* latest = moduleEngine(module)->getLatest(name);
+    if (latest) {
+        return latest;
+    }
+    if (fallback) {
+        return Py_NewRef(fallback);
+    }
+    PyErr_Format(PyExc_KeyError, "no stream named '%s'", name);
+    return nullptr;
+}
+
+PyObject* lumosPause(PyObject* module, PyObject* unused) {
+    (void)unused;
+    moduleEngine(module)->setIngestPaused(true);
+    Py_RETURN_NONE;
+}
+
+PyObject* lumosResume(PyObject* module, PyObject* unused) {
+    (void)unused;
+    moduleEngine(module)->setIngestPaused(false);
+    Py_RETURN_NONE;
+}
+
+PyObject* lumosIsPaused(PyObject* module, PyObject* unused) {
+    (void)unused;
+    return PyBool_FromLong(moduleEngine(module)->isIngestPaused());
+}
+
+int lumosExec(PyObject* module) {
+    // The engine of this interpreter, published by bindEngine()
+    PyObject* capsule = PyDict_GetItemString(PyInterpreterState_GetDict(PyInterpreterState_Get()), engineCapsuleName);
+    PythonEngine* engine = capsule ? static_cast<PythonEngine*>(PyCapsule_GetPointer(capsule, engineCapsuleName)) : nullptr;
+    if (!engine) {
+        PyErr_SetString(PyExc_ImportError, "lumos is only available inside LumosWorkspace");
+        return -1;
+    }
+    static_cast<ModuleState*>(PyModule_GetState(module))->engine = engine;
+
+    if (engine->getArrayType() && PyModule_AddObjectRef(module, "Array", engine->getArrayType()) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+PyMethodDef lumosMethods[] = {
+    {"streams", &lumosStreams, METH_NOARGS, "streams()\n\nNames of the ingest streams seen so far."},
+    {"stats", &lumosStats, METH_VARARGS,
+     "stats([name])\n\nMessage counts, rate (messages/s) and receive-to-Python latency (ms) of one\n"
+     "stream, or a dict of them for every stream."},
+    {"get_latest", &lumosGetLatest, METH_VARARGS,
+     "get_latest(name[, default])\n\nLatest value received on a stream. Raises KeyError for an\n"
+     "unknown stream unless a default is given."},
+    {"pause", &lumosPause, METH_NOARGS, "pause()\n\nRefuse injected data until resume()."},
+    {"resume", &lumosResume, METH_NOARGS, "resume()\n\nAccept injected data again."},
+    {"is_paused", &lumosIsPaused, METH_NOARGS, "is_paused()\n\nTrue while ingest is paused."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyModuleDef_Slot lumosSlots[] = {
+    {Py_mod_exec, (void*)&lumosExec},
+#if PY_VERSION_HEX >= 0x030C0000
+    {Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+#if PY_VERSION_HEX >= 0x030D0000
+    {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+    {0, nullptr}
+};
+
+PyModuleDef lumosModule = {
+    PyModuleDef_HEAD_INIT,
+    "lumos",
+    "Access to the LumosWorkspace host: ingest streams and their statistics.",
+    sizeof(ModuleState),
+    lumosMethods,
+    lumosSlots,
+    nullptr,
+    nullptr,
+    nullptr
+};
+
+PyObject* initLumosModule() {
+    return PyModuleDef_Init(&lumosModule);
+}
+
+}  // namespace
+
+void LumosModule::registerBuiltin() {
+    // The table of built-ins is process wide; sub-interpreters share it
+    static bool registered = false;
+    if (!registered) {
+        registered = PyImport_AppendInittab("lumos", &initLumosModule) == 0;
+    }
+}
+
+bool LumosModule::bindEngine(PythonEngine* engine) {
+    PyObject* capsule = PyCapsule_New(engine, engineCapsuleName, nullptr);
+    bool ok = capsule && PyDict_SetItemString(PyInterpreterState_GetDict(PyInterpreterState_Get()),
+                                              engineCapsuleName, capsule) == 0;
+    Py_XDECREF(capsule);
+    return ok;
+}
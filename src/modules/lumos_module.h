@@ -0,0 +1,24 @@
+#pragma once
+
+class PythonEngine;
+
+// Built-in `lumos` module: Python-side access to the engine that hosts the
+// interpreter.
+//
+//   lumos.streams()            names of ingest streams seen so far
+//   lumos.stats([name])        rate, latency and counters, per stream or for one
+//   lumos.get_latest(name[, default])
+//                              latest value of a stream, without going
+//                              through __main__
+//   lumos.pause() / resume() / is_paused()
+//                              refuse or accept injected data
+//   lumos.Array                buffer-backed numeric array type
+class LumosModule {
+public:
+    // Add `lumos` to the built-in modules; before the main interpreter starts
+    static void registerBuiltin();
+
+    // Make `import lumos` in the calling interpreter talk to `engine`.
+    // Call attached, before any code imports the module.
+    static bool bindEngine(PythonEngine* engine);
+};
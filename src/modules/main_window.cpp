@@ -1,5 +1,6 @@
 #include "main_window.h"
 #include "python_engine.h"
+#include "session_manager.h"
 #include "settings_manager.h"
 #include "ui_theme_manager.h"
 #include "custom_title_bar.h"
@@ -8,8 +9,30 @@
 #include "layout_manager.h"
 #include "tcp_server.h"
 #include "debug_api.h"
+#include "workspace_files.h"
+#include "session_journal.h"
 #include <QApplication>
 #include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTimer>
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(lcStartup, "lumos.startup", QtInfoMsg)
+
+namespace {
+
+// What the last session left behind stays available until the next start
+void keepPreviousFile(const QString& current, const QString& previous) {
+    if (QFileInfo::exists(current)) {
+        QFile::remove(previous);
+        QFile::rename(current, previous);
+    }
+}
+
+}  // namespace
 
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent), centralWidget(nullptr), mainLayout(nullptr) {
@@ -27,6 +50,13 @@ MainWindow::MainWindow(QWidget* parent)
 MainWindow::~MainWindow() {
     stopServers();
     saveSettings();
+    
+    // Stop the interpreter threads while the widgets their callbacks refer to
+    // still exist; sub-interpreter sessions go before the main interpreter
+    sessionManager.reset();
+    if (pythonEngine) {
+        pythonEngine->finalize();
+    }
 }
 
 void MainWindow::initializeApplication() {
@@ -46,6 +76,12 @@ void MainWindow::initializeApplication() {
     // Start network services
     startServers();
     
+    startCheckpoints();
+    startJournal();
+    
+    // Warm up configured modules once the event loop runs, i.e. after the window is shown
+    QTimer::singleShot(0, this, &MainWindow::startWarmup);
+    
     qDebug() << "MainWindow initialized successfully";
 }
 
@@ -67,10 +103,43 @@ void MainWindow::createComponents() {
     tcpServer = std::make_unique<TCPServer>(pythonEngine.get(), this);
     debugAPI = std::make_unique<DebugAPI>(pythonEngine.get(), settingsManager.get(), this);
     
-    // Initialize Python engine
+    // Initialize Python engine; startup options come from settings.json
+    settingsManager->loadSettings();
+    PythonEngine::StartupOptions startupOptions;
+    startupOptions.importSite = settingsManager->getBool("python.import_site", true);
+    startupOptions.traceImports = settingsManager->getBool("python.trace_imports", false);
+    if (startupOptions.traceImports) {
+        lcStartup().setEnabled(QtDebugMsg, true);
+    }
+    for (const QString& path : settingsManager->getValue("python.extra_paths").toStringList()) {
+        startupOptions.extraSearchPaths.push_back(path.toStdString());
+    }
+    pythonEngine->setStartupOptions(startupOptions);
+    
     if (!pythonEngine->initialize()) {
         qCritical() << "Failed to initialize Python engine";
+    } else if (lcStartup().isDebugEnabled()) {
+        QStringList phases;
+        double total = 0.0;
+        for (const PythonEngine::StartupPhase& phase : pythonEngine->getStartupTrace()) {
+            phases << QString("%1 %2 ms").arg(QString::fromStdString(phase.name)).arg(phase.milliseconds, 0, 'f', 1);
+            total += phase.milliseconds;
+        }
+        qCDebug(lcStartup).noquote() << QString("Python startup: %1 ms (%2)").arg(total, 0, 'f', 1).arg(phases.join(", "));
     }
+    
+    // The REPL can switch between sessions; TCP injection and the debug API stay on the main one
+    sessionManager = std::make_unique<SessionManager>(pythonEngine.get());
+    replInterface->setSessionManager(sessionManager.get());
+    
+    // Commands and injected frames go to the journal; 'replay' injects frames through the TCP server
+    sessionJournal = std::make_unique<SessionJournal>();
+    replInterface->setSessionJournal(sessionJournal.get());
+    tcpServer->setSessionJournal(sessionJournal.get());
+    replInterface->setFrameInjector([this](const QString& name, const QJsonObject& data,
+                                           std::function<void(const QString& error)> onFinished) {
+        return tcpServer->injectFrame(name, data, std::move(onFinished));
+    });
 }
 
 void MainWindow::setupLayout() {
@@ -118,6 +187,12 @@ void MainWindow::setupConnections() {
     // REPL interface connections
     connect(replInterface.get(), &REPLInterface::commandExecuted,
             this, &MainWindow::onCommandExecuted);
+    connect(replInterface.get(), &REPLInterface::sessionChanged,
+            this, [this](const QString& name, PythonEngine* engine) {
+                variablesPanel->setPythonEngine(engine, name);
+            });
+    connect(replInterface.get(), &REPLInterface::transferStatusChanged,
+            titleBar.get(), &CustomTitleBar::setStatus);
     
     // Variables panel connections
     connect(variablesPanel.get(), &VariablesPanel::variableSelected,
@@ -157,7 +232,7 @@ void MainWindow::setupShortcuts() {
 }
 
 void MainWindow::loadSettings() {
-    settingsManager->loadSettings();
+    // Settings were read from disk before the Python engine started
     
     // Restore window geometry
     int width = settingsManager->getInt("window.width", 800);
@@ -218,6 +293,64 @@ void MainWindow::stopServers() {
     }
 }
 
+void MainWindow::startWarmup() {
+    std::vector<std::string> modules;
+    for (const QString& module : settingsManager->getValue("python.warmup_modules").toStringList()) {
+        modules.push_back(module.toStdString());
+    }
+    
+    // Relative script paths are resolved against the directory holding settings.json
+    QDir appData(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+    std::vector<std::string> scripts;
+    for (const QString& script : settingsManager->getValue("python.warmup_scripts").toStringList()) {
+        scripts.push_back(QDir::cleanPath(appData.absoluteFilePath(script)).toStdString());
+    }
+    
+    if (modules.empty() && scripts.empty()) {
+        return;
+    }
+    
+    // Progress arrives on the warm-up thread; hop to the GUI thread before touching widgets
+    pythonEngine->startWarmup(modules, scripts, [this](size_t done, size_t total, const std::string& item) {
+        QString status = done < total
+            ? QString("Warming up %1 (%2/%3)").arg(QString::fromStdString(item)).arg(done + 1).arg(total)
+            : QString();
+        QMetaObject::invokeMethod(this, [this, status]() {
+            titleBar->setStatus(status);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::startCheckpoints() {
+    // The last session's checkpoint is what 'restore' reads
+    QString directory = WorkspaceFiles::defaultDirectory(settingsManager.get());
+    QString checkpoint = WorkspaceFiles::checkpointPath(directory);
+    keepPreviousFile(checkpoint, WorkspaceFiles::previousCheckpointPath(directory));
+    
+    int interval = settingsManager->getInt("checkpoint.interval_seconds", 60);
+    if (interval <= 0 || !QDir().mkpath(directory)) {
+        return;
+    }
+    uint64_t maxBytes = static_cast<uint64_t>(std::max(settingsManager->getInt("checkpoint.max_mb", 512), 1)) << 20;
+    pythonEngine->startCheckpoints(checkpoint.toStdString(), std::chrono::seconds(interval), maxBytes);
+}
+
+void MainWindow::startJournal() {
+    // The last session's journal is what a plain 'replay' runs
+    QString directory = WorkspaceFiles::defaultDirectory(settingsManager.get());
+    QString journal = WorkspaceFiles::journalPath(directory);
+    keepPreviousFile(journal, WorkspaceFiles::previousJournalPath(directory));
+    
+    if (!settingsManager->getBool("journal.enabled", false) || !QDir().mkpath(directory)) {
+        return;
+    }
+    uint64_t maxBytes = static_cast<uint64_t>(std::max(settingsManager->getInt("journal.max_mb", 256), 1)) << 20;
+    std::string error;
+    if (!sessionJournal->open(journal.toStdString(), maxBytes, error)) {
+        qWarning() << "Session journal not started:" << QString::fromStdString(error);
+    }
+}
+
 void MainWindow::closeEvent(QCloseEvent* event) {
     saveSettings();
     stopServers();
@@ -5,10 +5,17 @@
 #include <QCloseEvent>
 #include <QKeySequence>
 #include <QShortcut>
+#include <QLoggingCategory>
 #include <memory>
 
+// Startup timings; off unless python.trace_imports is set or enabled
+// through QT_LOGGING_RULES ("lumos.startup.debug=true")
+Q_DECLARE_LOGGING_CATEGORY(lcStartup)
+
 // Forward declarations
 class PythonEngine;
+class SessionManager;
+class SessionJournal;
 class SettingsManager;
 class UIThemeManager;
 class CustomTitleBar;
@@ -56,9 +63,14 @@ private:
     void applyInitialTheme();
     void startServers();
     void stopServers();
+    void startWarmup();
+    void startCheckpoints();
+    void startJournal();
     
     // Core components
     std::unique_ptr<PythonEngine> pythonEngine;
+    std::unique_ptr<SessionManager> sessionManager;  // Sub-interpreter sessions next to pythonEngine
+    std::unique_ptr<SessionJournal> sessionJournal;
     std::unique_ptr<SettingsManager> settingsManager;
     std::unique_ptr<UIThemeManager> themeManager;
     
@@ -0,0 +1,189 @@
+#include "numeric_summary.h"
+#include "python_engine.h"
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+// Independent accumulators, so the loops have no serial dependency and map
+// onto vector registers without reassociating a single running sum
+const size_t lanes = 8;
+
+// Range and mean of `count - nans` values that are not NaN
+void setSummary(double low, double high, double sum, size_t count, size_t nans, NumericSummary& summary) {
+    summary.count = count;
+    summary.nanCount = nans;
+    if (nans == count) {
+        low = high = sum = std::numeric_limits<double>::quiet_NaN();
+    }
+    summary.minimum = low;
+    summary.maximum = high;
+    summary.mean = sum / static_cast<double>(count - nans);
+}
+
+// Sum and count of the NaNs, skipping them; only run when they are there
+template <typename T>
+double sumWithoutNans(const T* values, size_t count, size_t& nans) {
+    double sum = 0.0;
+    nans = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (values[i] == values[i]) {
+            sum += static_cast<double>(values[i]);
+        } else {
+            ++nans;
+        }
+    }
+    return sum;
+}
+
+template <typename T>
+void reduceBuffer(const T* values, size_t count, NumericSummary& summary) {
+    // Starting from the far ends, a NaN loses every comparison wherever it
+    // sits and never enters the range
+    T lowest[lanes];
+    T highest[lanes];
+    double sums[lanes] = {};
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        lowest[lane] = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+        highest[lane] = std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+    }
+
+    size_t blocked = count - count % lanes;
+    for (size_t i = 0; i < blocked; i += lanes) {
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            T value = values[i + lane];
+            lowest[lane] = value < lowest[lane] ? value : lowest[lane];
+            highest[lane] = value > highest[lane] ? value : highest[lane];
+            sums[lane] += static_cast<double>(value);
+        }
+    }
+    for (size_t i = blocked; i < count; ++i) {
+        lowest[0] = values[i] < lowest[0] ? values[i] : lowest[0];
+        highest[0] = values[i] > highest[0] ? values[i] : highest[0];
+        sums[0] += static_cast<double>(values[i]);
+    }
+
+    T low = lowest[0];
+    T high = highest[0];
+    double sum = 0.0;
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        low = lowest[lane] < low ? lowest[lane] : low;
+        high = highest[lane] > high ? highest[lane] : high;
+        sum += sums[lane];
+    }
+    
+    // A NaN sum means a NaN element, or infinities of both signs; a second
+    // pass keeps the vectorized loop free of the check
+    size_t nans = 0;
+    if (sum != sum) {
+        sum = sumWithoutNans(values, count, nans);
+    }
+    setSummary(static_cast<double>(low), static_cast<double>(high), sum, count, nans, summary);
+}
+
+template <typename T>
+bool reduceTyped(const void* data, size_t count, NumericSummary& summary) {
+    if (reinterpret_cast<uintptr_t>(data) % alignof(T) != 0) {
+        return false;
+    }
+    reduceBuffer(static_cast<const T*>(data), count, summary);
+    return true;
+}
+
+bool summarizeBuffer(PyObject* value, size_t minimumCount, NumericSummary& summary) {
+    Py_buffer view;
+    if (PyObject_GetBuffer(value, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0) {
+        PyErr_Clear();
+        return false;
+    }
+
+    // Native size and byte order only: no prefix, or '@'
+    const char* format = view.format ? view.format : "B";
+    if (format[0] == '@') {
+        format++;
+    }
+    size_t count = view.itemsize > 0 ? static_cast<size_t>(view.len / view.itemsize) : 0;
+    bool summarized = false;
+    if (format[0] != '\0' && format[1] == '\0' && count > 0 && count >= minimumCount) {
+        switch (format[0]) {
+        case 'b': summarized = reduceTyped<signed char>(view.buf, count, summary); break;
+        case 'B': summarized = reduceTyped<unsigned char>(view.buf, count, summary); break;
+        case 'h': summarized = reduceTyped<short>(view.buf, count, summary); break;
+        case 'H': summarized = reduceTyped<unsigned short>(view.buf, count, summary); break;
+        case 'i': summarized = reduceTyped<int>(view.buf, count, summary); break;
+        case 'I': summarized = reduceTyped<unsigned int>(view.buf, count, summary); break;
+        case 'l': summarized = reduceTyped<long>(view.buf, count, summary); break;
+        case 'L': summarized = reduceTyped<unsigned long>(view.buf, count, summary); break;
+        case 'q': summarized = reduceTyped<long long>(view.buf, count, summary); break;
+        case 'Q': summarized = reduceTyped<unsigned long long>(view.buf, count, summary); break;
+        case 'f': summarized = reduceTyped<float>(view.buf, count, summary); break;
+        case 'd': summarized = reduceTyped<double>(view.buf, count, summary); break;
+        default: break;
+        }
+    }
+    PyBuffer_Release(&view);
+    return summarized;
+}
+
+bool summarizeSequence(PyObject* sequence, size_t minimumCount, NumericSummary& summary) {
+    // Elements are boxed, so this is one pass converting each of them
+    Py_ssize_t size = PySequence_Fast_GET_SIZE(sequence);
+    if (size == 0 || static_cast<size_t>(size) < minimumCount) {
+        return false;
+    }
+
+    bool summarized = true;
+    double low = std::numeric_limits<double>::infinity();
+    double high = -std::numeric_limits<double>::infinity();
+    double sum = 0.0;
+    size_t nans = 0;
+#if PY_VERSION_HEX >= 0x030D0000
+    Py_BEGIN_CRITICAL_SECTION(sequence);
+#endif
+    PyObject** items = PySequence_Fast_ITEMS(sequence);
+    for (Py_ssize_t i = 0; i < size; ++i) {
+        double value;
+        if (PyFloat_CheckExact(items[i])) {
+            value = PyFloat_AS_DOUBLE(items[i]);
+        } else if (PyLong_CheckExact(items[i])) {
+            value = PyLong_AsDouble(items[i]);
+            if (value == -1.0 && PyErr_Occurred()) {
+                PyErr_Clear();
+                summarized = false;
+                break;
+            }
+        } else {
+            summarized = false;
+            break;
+        }
+        if (value != value) {
+            ++nans;
+            continue;
+        }
+        low = value < low ? value : low;
+        high = value > high ? value : high;
+        sum += value;
+    }
+#if PY_VERSION_HEX >= 0x030D0000
+    Py_END_CRITICAL_SECTION();
+#endif
+
+    if (summarized) {
+        setSummary(low, high, sum, static_cast<size_t>(size), nans, summary);
+    }
+    return summarized;
+}
+
+}  // namespace
+
+bool summarizeNumbers(PyObject* value, size_t minimumCount, NumericSummary& summary) {
+    if (PyList_CheckExact(value) || PyTuple_CheckExact(value)) {
+        return summarizeSequence(value, minimumCount, summary);
+    }
+
+    // Text and byte strings support the buffer protocol but are not numbers
+    if (PyBytes_Check(value) || PyByteArray_Check(value) || !PyObject_CheckBuffer(value)) {
+        return false;
+    }
+    return summarizeBuffer(value, minimumCount, summary);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+// Matches the declaration in Python.h
+typedef struct _object PyObject;
+
+// Element count, range and mean of a numeric container. NaN elements are
+// counted but left out of the range and mean, which are NaN when every
+// element is.
+struct NumericSummary {
+    size_t count = 0;
+    size_t nanCount = 0;
+    double minimum = 0.0;
+    double maximum = 0.0;
+    double mean = 0.0;
+
+    // NaN equals NaN here, so a summary of the same data compares equal
+    bool operator==(const NumericSummary& other) const {
+        return count == other.count && nanCount == other.nanCount && sameNumber(minimum, other.minimum) &&
+               sameNumber(maximum, other.maximum) && sameNumber(mean, other.mean);
+    }
+    bool operator!=(const NumericSummary& other) const { return !(*this == other); }
+
+private:
+    static bool sameNumber(double a, double b) { return a == b || (a != a && b != b); }
+};
+
+// Summarize a list or tuple holding only int and float, or a C-contiguous
+// buffer of native integers or floats (lumos.Array, array.array, numpy
+// arrays, ...; all dimensions flattened). Buffers are reduced in plain
+// loops over the typed data that the compiler vectorizes. Containers with
+// fewer than `minimumCount` elements, and anything else, are not summarized.
+// Call attached to the interpreter; never leaves a Python exception set.
+bool summarizeNumbers(PyObject* value, size_t minimumCount, NumericSummary& summary);
@@ -0,0 +1,43 @@
+#include "output_queue.h"
+
+OutputChunkQueue::OutputChunkQueue(size_t capacity)
+    : slots(capacity + 1), head(0), tail(0), elidedLines(0) {}
+
+bool OutputChunkQueue::push(std::string& chunk) {
+    size_t current = tail.load(std::memory_order_relaxed);
+    size_t next = (current + 1) % slots.size();
+    if (next == head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    
+    slots[current].swap(chunk);
+    chunk.clear();
+    tail.store(next, std::memory_order_release);
+    return true;
+}
+
+void OutputChunkQueue::addElided(size_t lines) {
+    elidedLines.fetch_add(lines, std::memory_order_relaxed);
+}
+
+bool OutputChunkQueue::pop(std::string& chunk) {
+    size_t current = head.load(std::memory_order_relaxed);
+    if (current == tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    
+    chunk.clear();
+    chunk.swap(slots[current]);
+    head.store((current + 1) % slots.size(), std::memory_order_release);
+    return true;
+}
+
+size_t OutputChunkQueue::takeElidedLines() {
+    return elidedLines.exchange(0, std::memory_order_relaxed);
+}
+
+size_t OutputChunkQueue::size() const {
+    size_t current_head = head.load(std::memory_order_acquire);
+    size_t current_tail = tail.load(std::memory_order_acquire);
+    return (current_tail + slots.size() - current_head) % slots.size();
+}
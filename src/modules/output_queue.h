@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Bounded single-producer/single-consumer ring of output chunks. The
+// interpreter thread pushes and the UI thread pops without taking a lock.
+// Chunks are swapped in and out, so slots keep their capacity and steady
+// streaming does not allocate.
+class OutputChunkQueue {
+public:
+    explicit OutputChunkQueue(size_t capacity = 64);
+
+    // Producer: move `chunk` into a free slot and hand back that slot's old
+    // (empty) string. Returns false and leaves `chunk` alone when full.
+    bool push(std::string& chunk);
+
+    // Producer: account for output dropped because the queue was full
+    void addElided(size_t lines);
+
+    // Consumer: swap the oldest chunk into `chunk`
+    bool pop(std::string& chunk);
+
+    // Consumer: lines dropped since the last call
+    size_t takeElidedLines();
+
+    size_t size() const;
+    size_t capacity() const { return slots.size() - 1; }
+
+private:
+    std::vector<std::string> slots;     // One spare slot tells full from empty
+    std::atomic<size_t> head;           // Next slot to pop
+    std::atomic<size_t> tail;           // Next slot to push
+    std::atomic<size_t> elidedLines;
+};
@@ -0,0 +1,261 @@
+#include "pickle_stream.h"
+#include "python_engine.h"
+#include <cstdio>
+
+namespace {
+
+const uint64_t progressInterval = 1 << 20;
+
+// File object handed to the C pickler: write() while dumping, read(),
+// readinto() and readline() while loading. Disk I/O runs without the GIL.
+struct StreamObject {
+    PyObject_HEAD
+    std::FILE* file;
+    uint64_t bytes;
+    uint64_t totalBytes;
+    uint64_t reportedBytes;
+    const FileProgress* progress;
+};
+
+bool checkOpen(StreamObject* stream) {
+    if (!stream->file) {
+        PyErr_SetString(PyExc_ValueError, "I/O operation on closed file");
+        return false;
+    }
+    return true;
+}
+
+bool checkError(StreamObject* stream) {
+    if (std::ferror(stream->file)) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return false;
+    }
+    return true;
+}
+
+bool advance(StreamObject* stream, size_t size) {
+    // The pickler runs no bytecode, so this is where a transfer can be stopped
+    stream->bytes += size;
+    if (*stream->progress && stream->bytes - stream->reportedBytes >= progressInterval) {
+        stream->reportedBytes = stream->bytes;
+        if (!(*stream->progress)(stream->bytes, stream->totalBytes)) {
+            PyErr_SetNone(PyExc_KeyboardInterrupt);
+            return false;
+        }
+    }
+    return true;
+}
+
+PyObject* streamWrite(PyObject* self, PyObject* data) {
+    StreamObject* stream = (StreamObject*)self;
+    Py_buffer view;
+    if (!checkOpen(stream) || PyObject_GetBuffer(data, &view, PyBUF_SIMPLE) < 0) {
+        return nullptr;
+    }
+
+    size_t written;
+    Py_BEGIN_ALLOW_THREADS
+    written = std::fwrite(view.buf, 1, static_cast<size_t>(view.len), stream->file);
+    Py_END_ALLOW_THREADS
+    Py_ssize_t size = view.len;
+    PyBuffer_Release(&view);
+
+    if (written != static_cast<size_t>(size)) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return nullptr;
+    }
+    if (!advance(stream, written)) {
+        return nullptr;
+    }
+    return PyLong_FromSsize_t(size);
+}
+
+PyObject* streamRead(PyObject* self, PyObject* args) {
+    StreamObject* stream = (StreamObject*)self;
+    Py_ssize_t size = -1;
+    if (!PyArg_ParseTuple(args, "|n:read", &size) || !checkOpen(stream)) {
+        return nullptr;
+    }
+    if (size < 0) {
+        size = static_cast<Py_ssize_t>(stream->totalBytes - stream->bytes);
+    }
+
+    PyObject* data = PyBytes_FromStringAndSize(nullptr, size);
+    if (!data) {
+        return nullptr;
+    }
+    size_t got;
+    Py_BEGIN_ALLOW_THREADS
+    got = std::fread(PyBytes_AS_STRING(data), 1, static_cast<size_t>(size), stream->file);
+    Py_END_ALLOW_THREADS
+
+    if (!checkError(stream) || (got != static_cast<size_t>(size) && _PyBytes_Resize(&data, static_cast<Py_ssize_t>(got)) < 0)) {
+        Py_XDECREF(data);
+        return nullptr;
+    }
+    if (!advance(stream, got)) {
+        Py_DECREF(data);
+        return nullptr;
+    }
+    return data;
+}
+
+PyObject* streamReadInto(PyObject* self, PyObject* target) {
+    StreamObject* stream = (StreamObject*)self;
+    Py_buffer view;
+    if (!checkOpen(stream) || PyObject_GetBuffer(target, &view, PyBUF_WRITABLE) < 0) {
+        return nullptr;
+    }
+
+    size_t got;
+    Py_BEGIN_ALLOW_THREADS
+    got = std::fread(view.buf, 1, static_cast<size_t>(view.len), stream->file);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+
+    if (!checkError(stream)) {
+        return nullptr;
+    }
+    if (!advance(stream, got)) {
+        return nullptr;
+    }
+    return PyLong_FromSize_t(got);
+}
+
+PyObject* streamReadLine(PyObject* self, PyObject* unused) {
+    // Only the text opcodes of protocol 0 and 1 read lines; they are short
+    (void)unused;
+    StreamObject* stream = (StreamObject*)self;
+    if (!checkOpen(stream)) {
+        return nullptr;
+    }
+    std::string line;
+    int c;
+    while ((c = std::getc(stream->file)) != EOF) {
+        line.push_back(static_cast<char>(c));
+        if (c == '\n') {
+            break;
+        }
+    }
+    if (!checkError(stream)) {
+        return nullptr;
+    }
+    if (!advance(stream, line.size())) {
+        return nullptr;
+    }
+    return PyBytes_FromStringAndSize(line.data(), static_cast<Py_ssize_t>(line.size()));
+}
+
+void streamDealloc(PyObject* self) {
+    PyTypeObject* type = Py_TYPE(self);
+    type->tp_free(self);
+    Py_DECREF(type);
+}
+
+// The stream only borrows `file` and `progress`; closeStream() detaches it
+// before either goes away, in case the pickler kept a reference
+PyObject* openStream(PyObject* type, std::FILE* file, uint64_t totalBytes, const FileProgress& progress) {
+    if (!type) {
+        PyErr_SetString(PyExc_RuntimeError, "the pickle stream type is not available");
+        return nullptr;
+    }
+    StreamObject* stream = PyObject_New(StreamObject, (PyTypeObject*)type);
+    if (stream) {
+        stream->file = file;
+        stream->bytes = 0;
+        stream->totalBytes = totalBytes;
+        stream->reportedBytes = 0;
+        stream->progress = &progress;
+    }
+    return (PyObject*)stream;
+}
+
+void closeStream(PyObject* stream) {
+    if (stream) {
+        ((StreamObject*)stream)->file = nullptr;
+        Py_DECREF(stream);
+    }
+}
+
+}  // namespace
+
+PyObject* createPickleStreamType() {
+    static PyMethodDef methods[] = {
+        {"write", (PyCFunction)&streamWrite, METH_O, nullptr},
+        {"read", (PyCFunction)&streamRead, METH_VARARGS, nullptr},
+        {"readinto", (PyCFunction)&streamReadInto, METH_O, nullptr},
+        {"readline", (PyCFunction)&streamReadLine, METH_NOARGS, nullptr},
+        {nullptr, nullptr, 0, nullptr}
+    };
+    static PyType_Slot slots[] = {
+        {Py_tp_dealloc, (void*)&streamDealloc},
+        {Py_tp_methods, methods},
+        {0, nullptr}
+    };
+    static PyType_Spec spec = {
+        "lumos.PickleStream",
+        sizeof(StreamObject),
+        0,
+        Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+        slots
+    };
+    return PyType_FromSpec(&spec);
+}
+
+bool dumpPickle(PyObject* streamType, PyObject* object, std::FILE* file, const FileProgress& progress) {
+    // pickle.dump is the C implementation; -1 selects the highest protocol
+    PyObject* stream = openStream(streamType, file, 0, progress);
+    PyObject* pickle = stream ? PyImport_ImportModule("pickle") : nullptr;
+    PyObject* result = pickle ? PyObject_CallMethod(pickle, "dump", "OOi", object, stream, -1) : nullptr;
+    Py_XDECREF(result);
+    Py_XDECREF(pickle);
+    closeStream(stream);
+    return result != nullptr;
+}
+
+bool dumpPickleFile(PyObject* streamType, PyObject* object, const std::string& path, const FileProgress& progress) {
+    std::string partPath = path + ".part";
+    std::FILE* file = std::fopen(partPath.c_str(), "wb");
+    if (!file) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, partPath.c_str());
+        return false;
+    }
+
+    bool dumped = dumpPickle(streamType, object, file, progress);
+    bool closed = std::fclose(file) == 0;
+    if (dumped && !closed) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, partPath.c_str());
+    }
+    if (!dumped || !closed) {
+        std::remove(partPath.c_str());
+        return false;
+    }
+    if (std::rename(partPath.c_str(), path.c_str()) != 0) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+        std::remove(partPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+PyObject* loadPickleFile(PyObject* streamType, const std::string& path, const FileProgress& progress) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path.c_str());
+        return nullptr;
+    }
+    uint64_t totalBytes = 0;
+    if (std::fseek(file, 0, SEEK_END) == 0) {
+        long end = std::ftell(file);
+        totalBytes = end > 0 ? static_cast<uint64_t>(end) : 0;
+        std::rewind(file);
+    }
+
+    PyObject* stream = openStream(streamType, file, totalBytes, progress);
+    PyObject* pickle = stream ? PyImport_ImportModule("pickle") : nullptr;
+    PyObject* result = pickle ? PyObject_CallMethod(pickle, "load", "O", stream) : nullptr;
+    Py_XDECREF(pickle);
+    closeStream(stream);
+    std::fclose(file);
+    return result;
+}
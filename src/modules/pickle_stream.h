@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+// Matches the declaration in Python.h
+typedef struct _object PyObject;
+
+// Bytes written or read so far, and the file size (0 while saving, when it
+// is not known yet). Called with the GIL held, about once per megabyte;
+// returning false stops the transfer with KeyboardInterrupt.
+using FileProgress = std::function<bool(uint64_t bytes, uint64_t totalBytes)>;
+
+// Type object of the file stream handed to the pickler, for the calling
+// interpreter; owned by the caller, who creates it once and passes it to
+// the functions below
+PyObject* createPickleStreamType();
+
+// Pickle `object` with the C pickler (highest protocol) straight into a file:
+// the pickler's frames go to the file as they are produced, without building
+// the whole pickle in memory. The data goes to `path` + ".part" first and
+// replaces `path` only when complete. Call attached; returns false with a
+// Python exception set on failure.
+bool dumpPickleFile(PyObject* streamType, PyObject* object, const std::string& path, const FileProgress& progress);
+
+// Pickle `object` the same way at the current position of `file`, which
+// stays open; on failure part of the pickle may have been written.
+bool dumpPickle(PyObject* streamType, PyObject* object, std::FILE* file, const FileProgress& progress);
+
+// Unpickle the object stored in `path`, reading the file as the unpickler
+// asks for it. Returns a new reference, or nullptr with a Python exception
+// set.
+PyObject* loadPickleFile(PyObject* streamType, const std::string& path, const FileProgress& progress);
@@ -1,13 +1,188 @@
 #include "python_engine.h"
+#include "lumos_module.h"
+#include "bounded_repr.h"
 #include <iostream>
 #include <sstream>
+#include <fstream>
 #include <filesystem>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <cstring>
 #include <unistd.h>
+#include <pthread.h>
+#include <csignal>
 #ifdef __APPLE__
 #include <mach-o/dyld.h>
 #endif
 
-PythonEngine::PythonEngine() : initialized(false) {}
+#ifdef LUMOS_FROZEN_STDLIB
+// Marshalled standard library compiled into the binary by freeze_stdlib.py
+extern "C" const struct _frozen lumosFrozenStdlib[];
+#endif
+
+namespace {
+
+// Sent to the interpreter thread so blocking calls such as time.sleep()
+// return early and notice a pending interrupt
+const int wakeSignal = SIGUSR2;
+
+void ignoreWakeSignal(int) {}
+
+// Strong-reference lookups. On free-threaded builds another thread can drop
+// the last reference to a borrowed result, so PyImport_AddModule and
+// PyDict_GetItem are not safe there.
+PyObject* mainNamespace() {
+#if PY_VERSION_HEX >= 0x030D0000
+    PyObject* module = PyImport_AddModuleRef("__main__");
+#else
+    PyObject* module = PyImport_AddModule("__main__");
+    Py_XINCREF(module);
+#endif
+    if (!module) {
+        return nullptr;
+    }
+    
+    // A module keeps its dict for life, so this borrow is covered by `module`
+    PyObject* dict = PyModule_GetDict(module);
+    Py_XINCREF(dict);
+    Py_DECREF(module);
+    return dict;
+}
+
+int getDictItemRef(PyObject* dict, PyObject* key, PyObject** result) {
+#if PY_VERSION_HEX >= 0x030D0000
+    return PyDict_GetItemRef(dict, key, result);
+#else
+    *result = PyDict_GetItemWithError(dict, key);
+    Py_XINCREF(*result);
+    return *result ? 1 : (PyErr_Occurred() ? -1 : 0);
+#endif
+}
+
+// Guards taken with acquireGIL() on this thread, released in reverse order
+thread_local std::vector<std::unique_ptr<PythonEngine::GILGuard>> heldGILGuards;
+
+// Engines watching __main__, by interpreter; dict watcher callbacks carry no user data
+std::mutex watchingEnginesMutex;
+std::vector<std::pair<PyInterpreterState*, PythonEngine*>> watchingEngines;
+std::atomic<unsigned> watchingEnginesVersion{0};
+
+PythonEngine* findWatchingEngine() {
+    // The callback runs on every store to __main__; skip the lookup while
+    // this thread stays in one interpreter and no engine came or went
+    thread_local unsigned cachedVersion = ~0u;
+    thread_local PyInterpreterState* cachedInterpreter = nullptr;
+    thread_local PythonEngine* cachedEngine = nullptr;
+    
+    PyInterpreterState* interpreter = PyInterpreterState_Get();
+    unsigned version = watchingEnginesVersion.load(std::memory_order_acquire);
+    if (version == cachedVersion && interpreter == cachedInterpreter) {
+        return cachedEngine;
+    }
+    
+    std::lock_guard<std::mutex> lock(watchingEnginesMutex);
+    cachedEngine = nullptr;
+    for (const auto& entry : watchingEngines) {
+        if (entry.first == interpreter) {
+            cachedEngine = entry.second;
+            break;
+        }
+    }
+    cachedInterpreter = interpreter;
+    cachedVersion = watchingEnginesVersion.load(std::memory_order_relaxed);
+    return cachedEngine;
+}
+
+// Containers nested deeper, or holding more items in all, than these are
+// taken as mutable rather than walked
+const int immutableDepthLimit = 8;
+const Py_ssize_t immutableItemLimit = 4096;
+
+bool isImmutableValue(PyObject* value, PyObject* arrayType, int depth, Py_ssize_t& budget);
+
+// A tuple or frozenset is only as fixed as everything in it
+bool itemsImmutable(PyObject* container, PyObject* arrayType, int depth, Py_ssize_t& budget) {
+    if (depth >= immutableDepthLimit) {
+        return false;
+    }
+    if (PyTuple_CheckExact(container)) {
+        Py_ssize_t size = PyTuple_GET_SIZE(container);
+        if ((budget -= size) < 0) {
+            return false;
+        }
+        for (Py_ssize_t i = 0; i < size; ++i) {
+            if (!isImmutableValue(PyTuple_GET_ITEM(container, i), arrayType, depth + 1, budget)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if ((budget -= PySet_GET_SIZE(container)) < 0) {
+        return false;
+    }
+    PyObject* iterator = PyObject_GetIter(container);
+    if (!iterator) {
+        PyErr_Clear();
+        return false;
+    }
+    bool immutable = true;
+    while (PyObject* item = PyIter_Next(iterator)) {
+        immutable = isImmutableValue(item, arrayType, depth + 1, budget);
+        Py_DECREF(item);
+        if (!immutable) {
+            break;
+        }
+    }
+    Py_DECREF(iterator);
+    return immutable;
+}
+
+bool isImmutableValue(PyObject* value, PyObject* arrayType, int depth, Py_ssize_t& budget) {
+    if (PyTuple_CheckExact(value) || PyFrozenSet_CheckExact(value)) {
+        return itemsImmutable(value, arrayType, depth, budget);
+    }
+    return value == Py_None || Py_TYPE(value) == (PyTypeObject*)arrayType || PyBool_Check(value) || PyLong_CheckExact(value) || PyFloat_CheckExact(value) ||
+           PyComplex_CheckExact(value) || PyUnicode_CheckExact(value) || PyBytes_CheckExact(value) || PyRange_Check(value) ||
+           PyType_Check(value) || PyFunction_Check(value) || PyCFunction_Check(value) || PyModule_Check(value);
+}
+
+// Values whose repr cannot change without rebinding the name; the elements
+// of a lumos.Array are fixed as well
+bool isImmutableValue(PyObject* value, PyObject* arrayType) {
+    Py_ssize_t budget = immutableItemLimit;
+    return isImmutableValue(value, arrayType, 0, budget);
+}
+
+// Type name as __name__ spells it, without the module prefix of static types
+const char* shortTypeName(PyObject* value) {
+    const char* name = Py_TYPE(value)->tp_name;
+    const char* dot = std::strrchr(name, '.');
+    return dot ? dot + 1 : name;
+}
+
+// Instance layout of the native output stream type
+struct OutputStreamObject {
+    PyObject_HEAD
+    PythonEngine* engine;
+    int stream;
+};
+
+}  // namespace
+
+PythonEngine::PythonEngine(InterpreterKind kind)
+    : initialized(false), kind(kind), interpreterState(nullptr), hostThreadState(nullptr),
+      interpreterThreadIdent(0), jobRunning(false), stopRequested(false),
+      currentJob(0), lastJobSerial(0), hasDeadline(false), interruptReason(InterruptReason::None),
+      asyncInterruptJob(0), interruptHandlerInstalled(false), wakeSignalInstalled(false),
+      warmupRunning(false), warmupCancelled(false), warmupThreadIdent(0),
+      transferRunning(false), transferCancelled(false), ingestStopping(false), checkpointStopping(false),
+      astModule(nullptr), compileFunction(nullptr),
+      outputStreamType(nullptr), capturingThread(0),
+      outputQueue(outputQueueCapacity), streamingOutput(false), blockOnFullOutput(false),
+      arrayType(nullptr), pickleStreamType(nullptr), ingestPaused(false), namespaceWatcher(-1), allVariablesChanged(true),
+      variablesChanged(true), variableChangesTaken(0), checkpointing(false), checkpointEverything(true),
+      snapshotVersion(1), snapshotHorizon(1) {}
 
 PythonEngine::~PythonEngine() {
     if (initialized) {
@@ -15,276 +190,2179 @@ PythonEngine::~PythonEngine() {
     }
 }
 
-bool PythonEngine::initialize() {
-    if (initialized) {
-        return true;
+bool PythonEngine::isFreeThreaded() {
+#ifdef Py_GIL_DISABLED
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PythonEngine::subinterpretersSupported() {
+#if PY_VERSION_HEX >= 0x030C0000
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PythonEngine::initialize() {
+    if (initialized) {
+        return true;
+    }
+    
+    if (kind == InterpreterKind::Subinterpreter && (!subinterpretersSupported() || !Py_IsInitialized())) {
+        std::cerr << "Sub-interpreters need Python 3.12+ and a running main interpreter" << std::endl;
+        return false;
+    }
+    
+    std::promise<bool> started;
+    std::future<bool> startResult = started.get_future();
+    stopRequested = false;
+    interpreterThread = std::thread(&PythonEngine::interpreterLoop, this, std::ref(started));
+    
+    if (!startResult.get()) {
+        interpreterThread.join();
+        return false;
+    }
+    
+    initialized = true;
+    return true;
+}
+
+void PythonEngine::finalize() {
+    if (!initialized) {
+        return;
+    }
+    
+    // Don't wait for a long-running command, warm-up, transfer or checkpoint to finish on its own
+    stopWarmup();
+    stopTransfer();
+    stopIngest();
+    stopCheckpoints();
+    interrupt();
+    
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopRequested = true;
+        jobs.clear();
+    }
+    jobAvailable.notify_all();
+    deadlineChanged.notify_all();
+    
+    if (interpreterThread.joinable()) {
+        interpreterThread.join();
+    }
+    initialized = false;
+}
+
+void PythonEngine::interpreterLoop(std::promise<bool>& started) {
+    interpreterThreadId = std::this_thread::get_id();
+    
+    if (!startInterpreter()) {
+        started.set_value(false);
+        return;
+    }
+    interpreterThreadIdent = PyThread_get_thread_ident();
+    watchdogThread = std::thread(&PythonEngine::watchdogLoop, this);
+    started.set_value(true);
+    
+    while (true) {
+        QueuedJob queued;
+        
+        // Let other threads take the GIL while there is nothing to run
+        {
+            GILRelease idle;
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobAvailable.wait(lock, [this]() { return stopRequested || !jobs.empty(); });
+            if (!stopRequested) {
+                queued = std::move(jobs.front());
+                jobs.pop_front();
+                jobRunning = true;
+            }
+        }
+        
+        if (!queued.job) {
+            break;
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            currentJob = ++lastJobSerial;
+            interruptReason = InterruptReason::None;
+            hasDeadline = queued.timeout > std::chrono::milliseconds::zero();
+            if (hasDeadline) {
+                jobDeadline = std::chrono::steady_clock::now() + queued.timeout;
+            }
+        }
+        deadlineChanged.notify_all();
+        
+        queued.job();
+        
+        bool interrupted = false;
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            interrupted = interruptReason != InterruptReason::None;
+            currentJob = 0;
+            hasDeadline = false;
+            jobRunning = false;
+        }
+        
+        // An interrupt that arrived as the job finished must not hit the next one
+        if (interrupted) {
+            clearPendingInterrupt();
+        }
+    }
+    
+    // The watchdog may be waiting for the GIL to deliver a timeout
+    {
+        GILRelease waiting;
+        watchdogThread.join();
+    }
+    
+    stopInterpreter();
+}
+
+void PythonEngine::watchdogLoop() {
+    std::unique_lock<std::mutex> lock(jobMutex);
+    while (!stopRequested) {
+        if (asyncInterruptJob != 0) {
+            uint64_t job = asyncInterruptJob;
+            asyncInterruptJob = 0;
+            lock.unlock();
+            deliverAsyncInterrupt(job);
+            lock.lock();
+            continue;
+        }
+        
+        if (!hasDeadline) {
+            deadlineChanged.wait(lock);
+            continue;
+        }
+        
+        uint64_t job = currentJob;
+        std::chrono::steady_clock::time_point deadline = jobDeadline;
+        deadlineChanged.wait_until(lock, deadline);
+        
+        if (!stopRequested && hasDeadline && currentJob == job &&
+            std::chrono::steady_clock::now() >= deadline) {
+            hasDeadline = false;
+            lock.unlock();
+            interruptJob(job, InterruptReason::Timeout);
+            lock.lock();
+        }
+    }
+}
+
+bool PythonEngine::interrupt() {
+    if (!initialized) {
+        return false;
+    }
+    return interruptJob(0, InterruptReason::User);
+}
+
+bool PythonEngine::interruptJob(uint64_t job, InterruptReason reason) {
+    // Signalled under jobMutex, which the interpreter thread takes when the
+    // job ends and then clears what is pending, so the interrupt cannot hit
+    // the next job. Neither call needs the GIL.
+    std::unique_lock<std::mutex> lock(jobMutex);
+    if (currentJob == 0 || (job != 0 && job != currentJob)) {
+        return false;
+    }
+    interruptReason = reason;
+    
+    if (interruptHandlerInstalled) {
+        // Handled like Ctrl+C in a terminal: checked between bytecodes and
+        // after a blocking syscall returns EINTR because of the wake signal
+        PyErr_SetInterrupt();
+        if (wakeSignalInstalled) {
+            pthread_kill(interpreterThread.native_handle(), wakeSignal);
+        }
+        return true;
+    }
+    
+    // Without a SIGINT handler only running bytecode can be stopped, by an
+    // async exception that needs the GIL; the watchdog waits for it so the
+    // caller never does
+    asyncInterruptJob = currentJob;
+    lock.unlock();
+    deadlineChanged.notify_all();
+    return true;
+}
+
+void PythonEngine::deliverAsyncInterrupt(uint64_t job) {
+    // Holding the GIL keeps the interpreter thread from finishing the job
+    // (and starting the next one) while the exception is set up
+    GILGuard gil(*this);
+    std::lock_guard<std::mutex> lock(jobMutex);
+    if (currentJob == job) {
+        PyThreadState_SetAsyncExc(interpreterThreadIdent, PyExc_KeyboardInterrupt);
+    }
+}
+
+bool PythonEngine::startWarmup(const std::vector<std::string>& modules, const std::vector<std::string>& scripts,
+                               WarmupCallback onProgress) {
+    if (!initialized || warmupRunning) {
+        return false;
+    }
+    if (warmupThread.joinable()) {
+        warmupThread.join();
+    }
+    
+    warmupRunning = true;
+    warmupCancelled = false;
+    warmupThread = std::thread(&PythonEngine::warmupLoop, this, modules, scripts, std::move(onProgress));
+    return true;
+}
+
+void PythonEngine::warmupLoop(std::vector<std::string> modules, std::vector<std::string> scripts,
+                              WarmupCallback onProgress) {
+    size_t total = modules.size() + scripts.size();
+    size_t done = 0;
+    
+    {
+        // With a GIL, commands and warm-up take turns at the switch interval
+        GILGuard gil(*this);
+        warmupThreadIdent = PyThread_get_thread_ident();
+        
+        for (const std::string& module : modules) {
+            if (warmupCancelled) {
+                break;
+            }
+            if (onProgress) {
+                onProgress(done, total, module);
+            }
+            PyObject* imported = PyImport_ImportModule(module.c_str());
+            if (!imported) {
+                std::cerr << "Warm-up import of " << module << " failed: " << formatPythonError() << std::endl;
+            }
+            Py_XDECREF(imported);
+            ++done;
+        }
+        
+        for (const std::string& script : scripts) {
+            if (warmupCancelled) {
+                break;
+            }
+            if (onProgress) {
+                onProgress(done, total, script);
+            }
+            if (!runStartupScript(script)) {
+                std::cerr << "Warm-up script " << script << " failed: " << formatPythonError() << std::endl;
+            }
+            ++done;
+        }
+        
+        warmupThreadIdent = 0;
+        PyErr_Clear();
+    }
+    
+    if (onProgress) {
+        onProgress(total, total, "");
+    }
+    warmupRunning = false;
+}
+
+bool PythonEngine::runStartupScript(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        PyErr_Format(PyExc_FileNotFoundError, "cannot open %s", path.c_str());
+        return false;
+    }
+    std::stringstream source;
+    source << file.rdbuf();
+    
+    PyObject* code = Py_CompileString(source.str().c_str(), path.c_str(), Py_file_input);
+    PyObject* main_dict = code ? mainNamespace() : nullptr;
+    PyObject* result = main_dict ? PyEval_EvalCode(code, main_dict, main_dict) : nullptr;
+    bool ok = result != nullptr;
+    
+    Py_XDECREF(result);
+    Py_XDECREF(main_dict);
+    Py_XDECREF(code);
+    return ok;
+}
+
+void PythonEngine::stopWarmup() {
+    if (!warmupThread.joinable()) {
+        return;
+    }
+    
+    warmupCancelled = true;
+    {
+        // Stop a long import instead of waiting for it
+        GILGuard gil(*this);
+        unsigned long ident = warmupThreadIdent;
+        if (ident != 0) {
+            PyThreadState_SetAsyncExc(ident, PyExc_KeyboardInterrupt);
+        }
+    }
+    warmupThread.join();
+}
+
+bool PythonEngine::saveVariables(const std::string& path, const std::vector<std::string>& names,
+                                 TransferProgress onProgress, TransferCallback onFinished, FileFormat format) {
+    return startTransfer([this, path, names, format](const FileProgress& progress, size_t& count) {
+        PyObject* variables = selectVariables(names, format);
+        size_t skipped = 0;
+        bool saved = variables && (format == FileFormat::Columnar ? dumpColumnarFile(variables, path, progress, skipped)
+                                                                  : dumpPickleFile(pickleStreamType, variables, path, progress));
+        if (saved) {
+            count = static_cast<size_t>(PyDict_Size(variables)) - skipped;
+        }
+        Py_XDECREF(variables);
+        return saved;
+    }, std::move(onProgress), std::move(onFinished));
+}
+
+bool PythonEngine::loadVariables(const std::string& path, TransferProgress onProgress, TransferCallback onFinished,
+                                 FileFormat format) {
+    return startTransfer([this, path, format](const FileProgress& progress, size_t& count) {
+        PyObject* loaded = format == FileFormat::Columnar ? loadColumnarFile(arrayType, path)
+                                                          : loadPickleFile(pickleStreamType, path, progress);
+        if (loaded && !PyDict_Check(loaded)) {
+            PyErr_SetString(PyExc_TypeError, "the file does not hold a dictionary of variables");
+            Py_CLEAR(loaded);
+        }
+        bool bound = loaded && bindVariables(loaded, count);
+        Py_XDECREF(loaded);
+        return bound;
+    }, std::move(onProgress), std::move(onFinished));
+}
+
+bool PythonEngine::bindVariables(PyObject* variables, size_t& count) {
+    PyObject* main_dict = mainNamespace();
+    Py_ssize_t position = 0;
+    PyObject* key = nullptr;
+    PyObject* value = nullptr;
+    while (main_dict && PyDict_Next(variables, &position, &key, &value)) {
+        const char* name = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : nullptr;
+        if (name && std::strncmp(name, "__", 2) != 0 && PyDict_SetItem(main_dict, key, value) == 0) {
+            ++count;
+        }
+        PyErr_Clear();
+    }
+    bool bound = main_dict != nullptr;
+    Py_XDECREF(main_dict);
+    return bound;
+}
+
+bool PythonEngine::startTransfer(TransferJob transfer, TransferProgress onProgress, TransferCallback onFinished) {
+    if (!initialized || transferRunning.exchange(true)) {
+        return false;
+    }
+    if (transferThread.joinable()) {
+        transferThread.join();
+    }
+    transferCancelled = false;
+    transferThread = std::thread([this, transfer = std::move(transfer), onProgress = std::move(onProgress),
+                                  onFinished = std::move(onFinished)]() {
+        size_t count = 0;
+        std::string error;
+        FileProgress progress = [this, &onProgress](uint64_t bytes, uint64_t totalBytes) {
+            if (onProgress) {
+                onProgress(bytes, totalBytes);
+            }
+            return !transferCancelled;
+        };
+        {
+            GILGuard gil(*this);
+            if (!transfer(progress, count)) {
+                error = formatPythonError();
+            }
+            PyErr_Clear();
+        }
+        
+        // The next transfer may start as soon as the caller hears about this one
+        transferRunning = false;
+        if (onFinished) {
+            onFinished(error.empty(), count, error);
+        }
+    });
+    return true;
+}
+
+void PythonEngine::stopTransfer() {
+    // The pickler checks between chunks of the file; a half-written save is
+    // discarded, a load keeps nothing since it binds only once fully read
+    if (transferThread.joinable()) {
+        transferCancelled = true;
+        transferThread.join();
+    }
+}
+
+bool PythonEngine::startCheckpoints(const std::string& path, std::chrono::seconds interval, uint64_t maxBytes) {
+    if (!initialized || checkpointThread.joinable() || interval.count() <= 0) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(variableChangesMutex);
+        checkpointing = true;
+        checkpointEverything = true;
+    }
+    checkpointStopping = false;
+    checkpointThread = std::thread(&PythonEngine::checkpointLoop, this, path, interval, maxBytes);
+    return true;
+}
+
+void PythonEngine::stopCheckpoints() {
+    if (!checkpointThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(checkpointMutex);
+        checkpointStopping = true;
+    }
+    checkpointWake.notify_all();
+    checkpointThread.join();
+}
+
+bool PythonEngine::restoreCheckpoint(const std::string& path, TransferCallback onFinished) {
+    return startTransfer([this, path](const FileProgress& progress, size_t& count) {
+        (void)progress;
+        PyObject* restored = CheckpointStore::load(path);
+        bool bound = restored && bindVariables(restored, count);
+        Py_XDECREF(restored);
+        return bound;
+    }, nullptr, std::move(onFinished));
+}
+
+void PythonEngine::checkpointLoop(std::string path, std::chrono::seconds interval, uint64_t maxBytes) {
+    CheckpointStore store(pickleStreamType);
+    bool failed = false;
+    std::unique_lock<std::mutex> lock(checkpointMutex);
+    while (!failed && !checkpointWake.wait_for(lock, interval, [this] { return checkpointStopping.load(); })) {
+        lock.unlock();
+        failed = !writeCheckpoint(store, path, maxBytes);
+        lock.lock();
+    }
+    lock.unlock();
+    
+    std::lock_guard<std::mutex> changesLock(variableChangesMutex);
+    checkpointing = false;
+    checkpointChanges.clear();
+    checkpointMutable.clear();
+}
+
+bool PythonEngine::writeCheckpoint(CheckpointStore& store, const std::string& path, uint64_t maxBytes) {
+    GILGuard gil(*this);
+    VariableChanges changes = takeCheckpointChanges();
+    PyObject* main_dict = mainNamespace();
+    if (!main_dict) {
+        PyErr_Clear();
+        return true;
+    }
+    
+    // Everything: what is bound now, and what the store holds that is gone
+    std::vector<std::string> names = std::move(changes.names);
+    if (changes.everything) {
+        names = store.names();
+        Py_ssize_t position = 0;
+        PyObject* key = nullptr;
+        PyObject* value = nullptr;
+        while (PyDict_Next(main_dict, &position, &key, &value)) {
+            const char* name = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : nullptr;
+            if (name && std::strncmp(name, "__", 2) != 0 && !store.contains(name)) {
+                names.push_back(name);
+            }
+            PyErr_Clear();
+        }
+    }
+    
+    if (names.empty()) {
+        Py_DECREF(main_dict);
+        return true;
+    }
+    // The file appears with the first variable, so a session without any
+    // leaves the file of an earlier one alone
+    if (!store.isOpen() && !store.create(path)) {
+        std::cerr << "Checkpoint file " << path << " failed: " << formatPythonError() << std::endl;
+        Py_DECREF(main_dict);
+        return false;
+    }
+    
+    std::vector<std::pair<std::string, bool>> saved;   // Name, whether its value is mutable
+    uint64_t startSize = store.fileSize();
+    bool ok = true;
+    bool cutShort = false;
+    for (const std::string& name : names) {
+        cutShort = checkpointStopping;
+        if (cutShort || !ok) {
+            break;
+        }
+        PyObject* key = PyUnicode_FromStringAndSize(name.data(), static_cast<Py_ssize_t>(name.size()));
+        PyObject* value = nullptr;
+        if (!key || getDictItemRef(main_dict, key, &value) <= 0 || PyModule_Check(value)) {
+            PyErr_Clear();
+            ok = !store.contains(name) || store.remove(name);
+            Py_XDECREF(value);
+            Py_XDECREF(key);
+            continue;
+        }
+        
+        uint64_t othersBytes = store.liveSize() - store.recordSize(name);
+        uint64_t budget = othersBytes < maxBytes ? std::min(maxBytes / 4, maxBytes - othersBytes) : 0;
+        FileProgress progress = [this, budget](uint64_t bytes, uint64_t) {
+            return bytes <= budget && !checkpointStopping;
+        };
+        if (store.put(name, value, progress)) {
+            saved.emplace_back(name, !isImmutableValue(value, arrayType));
+        } else if (!store.isOpen()) {
+            ok = false;
+        } else if (checkpointStopping) {
+            PyErr_Clear();
+            cutShort = true;
+        } else {
+            // Too large or not picklable; an older version would restore wrong
+            PyErr_Clear();
+            ok = !store.contains(name) || store.remove(name);
+        }
+        Py_XDECREF(value);
+        Py_XDECREF(key);
+    }
+    Py_DECREF(main_dict);
+    
+    // A checkpoint cut short stays uncommitted, so the file keeps the one
+    // before it whole; its names are pending again
+    if (cutShort && ok) {
+        std::lock_guard<std::mutex> lock(variableChangesMutex);
+        if (changes.everything) {
+            checkpointEverything = true;
+        } else {
+            checkpointChanges.insert(names.begin(), names.end());
+        }
+        return store.isOpen();
+    }
+    
+    // Nothing to commit when every name was left out as before
+    ok = ok && (store.fileSize() == startSize || store.commit());
+    if (ok && !checkpointStopping && store.fileSize() > maxBytes && store.fileSize() > 2 * store.liveSize()) {
+        ok = store.compact();
+    }
+    if (!ok) {
+        std::cerr << "Checkpoint failed: " << formatPythonError() << std::endl;
+    }
+    
+    std::lock_guard<std::mutex> lock(variableChangesMutex);
+    for (const auto& entry : saved) {
+        if (entry.second) {
+            checkpointMutable.insert(entry.first);
+        } else {
+            checkpointMutable.erase(entry.first);
+        }
+    }
+    for (auto it = checkpointMutable.begin(); it != checkpointMutable.end();) {
+        it = store.contains(*it) ? std::next(it) : checkpointMutable.erase(it);
+    }
+    return store.isOpen();
+}
+
+PyObject* PythonEngine::selectVariables(const std::vector<std::string>& names, FileFormat format) {
+    // Modules never pickle and columnar files take only arrays, so "everything"
+    // leaves the rest out; named ones must exist and fit the format
+    PyObject* main_dict = mainNamespace();
+    PyObject* selected = main_dict ? PyDict_New() : nullptr;
+    if (!selected) {
+        Py_XDECREF(main_dict);
+        return nullptr;
+    }
+    
+    bool ok = true;
+    if (names.empty()) {
+        // Commands keep running meanwhile; work on a copy of the item list
+        PyObject* items = PyDict_Items(main_dict);
+        Py_ssize_t size = items ? PyList_Size(items) : 0;
+        ok = items != nullptr;
+        for (Py_ssize_t i = 0; ok && i < size; i++) {
+            PyObject* key = PyTuple_GetItem(PyList_GetItem(items, i), 0);
+            PyObject* value = PyTuple_GetItem(PyList_GetItem(items, i), 1);
+            const char* name = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : nullptr;
+            bool storable = format == FileFormat::Columnar ? isColumnarValue(value) : !PyModule_Check(value);
+            if (name && std::strncmp(name, "__", 2) != 0 && storable) {
+                ok = PyDict_SetItem(selected, key, value) == 0;
+            }
+        }
+        Py_XDECREF(items);
+    } else {
+        for (const std::string& name : names) {
+            PyObject* key = PyUnicode_FromString(name.c_str());
+            PyObject* value = nullptr;
+            ok = key && getDictItemRef(main_dict, key, &value) >= 0;
+            if (ok && !value) {
+                PyErr_Format(PyExc_NameError, "name '%s' is not defined", name.c_str());
+                ok = false;
+            } else if (ok && format == FileFormat::Columnar && !isColumnarValue(value)) {
+                PyErr_Format(PyExc_TypeError, "'%s' is not a numeric array", name.c_str());
+                ok = false;
+            }
+            ok = ok && PyDict_SetItem(selected, key, value) == 0;
+            Py_XDECREF(value);
+            Py_XDECREF(key);
+            if (!ok) {
+                break;
+            }
+        }
+    }
+    
+    Py_DECREF(main_dict);
+    if (!ok) {
+        Py_CLEAR(selected);
+    }
+    return selected;
+}
+
+bool PythonEngine::hasVariable(const std::string& name) {
+    bool bound = false;
+    run([&]() {
+        PyObject* main_dict = mainNamespace();
+        PyObject* key = main_dict ? PyUnicode_FromString(name.c_str()) : nullptr;
+        PyObject* value = nullptr;
+        bound = key && getDictItemRef(main_dict, key, &value) > 0;
+        Py_XDECREF(value);
+        Py_XDECREF(key);
+        Py_XDECREF(main_dict);
+        PyErr_Clear();
+    });
+    return bound;
+}
+
+bool PythonEngine::clearUserVariables(Job onFinished) {
+    return post([this, onFinished]() {
+        PyObject* main_dict = mainNamespace();
+        PyObject* keys = main_dict ? PyDict_Keys(main_dict) : nullptr;
+        Py_ssize_t size = keys ? PyList_GET_SIZE(keys) : 0;
+        for (Py_ssize_t i = 0; i < size; i++) {
+            PyObject* key = PyList_GET_ITEM(keys, i);
+            const char* key_str = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : nullptr;
+            if (key_str && std::strncmp(key_str, "__", 2) != 0) {
+                PyDict_DelItem(main_dict, key);
+            }
+            // A key gone already, or not text, is left alone
+            PyErr_Clear();
+        }
+        Py_XDECREF(keys);
+        Py_XDECREF(main_dict);
+        PyErr_Clear();
+        if (onFinished) {
+            onFinished();
+        }
+    });
+}
+
+void PythonEngine::installInterruptHandling() {
+    // Give Python a SIGINT handler for PyErr_SetInterrupt() without taking the
+    // process-level SIGINT disposition away from the application
+    struct sigaction previousInterrupt;
+    sigaction(SIGINT, nullptr, &previousInterrupt);
+    
+    PyObject* signal_module = PyImport_ImportModule("signal");
+    PyObject* handler = signal_module ? PyObject_GetAttrString(signal_module, "default_int_handler") : nullptr;
+    PyObject* result = handler ? PyObject_CallMethod(signal_module, "signal", "iO", SIGINT, handler) : nullptr;
+    interruptHandlerInstalled = result != nullptr;
+    if (!result) {
+        PyErr_Print();
+        std::cerr << "Failed to install Python interrupt handler" << std::endl;
+    }
+    Py_XDECREF(result);
+    Py_XDECREF(handler);
+    Py_XDECREF(signal_module);
+    
+    sigaction(SIGINT, &previousInterrupt, nullptr);
+    
+    // No SA_RESTART, so the wake signal makes blocking syscalls return EINTR
+    struct sigaction currentWake;
+    sigaction(wakeSignal, nullptr, &currentWake);
+    if (currentWake.sa_handler == SIG_DFL) {
+        struct sigaction wake = {};
+        wake.sa_handler = ignoreWakeSignal;
+        sigemptyset(&wake.sa_mask);
+        wakeSignalInstalled = sigaction(wakeSignal, &wake, nullptr) == 0;
+    }
+}
+
+void PythonEngine::clearPendingInterrupt() {
+    PyThreadState_SetAsyncExc(interpreterThreadIdent, nullptr);
+    PyErr_CheckSignals();
+    PyErr_Clear();
+}
+
+bool PythonEngine::startInterpreter() {
+    startupTrace.clear();
+    auto phaseStart = std::chrono::steady_clock::now();
+    
+    if (kind == InterpreterKind::Subinterpreter) {
+        if (!createSubinterpreter()) {
+            return false;
+        }
+    } else if (!initializeMainInterpreter()) {
+        return false;
+    }
+    interpreterState = PyInterpreterState_Get();
+    recordStartupPhase("interpreter", phaseStart);
+    
+    // Used to compile the pieces of each command; ast itself is imported
+    // with the first command
+    PyObject* builtins = PyImport_ImportModule("builtins");
+    compileFunction = builtins ? PyObject_GetAttrString(builtins, "compile") : nullptr;
+    Py_XDECREF(builtins);
+    if (!compileFunction) {
+        PyErr_Print();
+        std::cerr << "Failed to load the Python compiler" << std::endl;
+        shutdownInterpreter();
+        return false;
+    }
+    
+    if (!installOutputStreams()) {
+        PyErr_Print();
+        std::cerr << "Failed to install Python output capture" << std::endl;
+    }
+    recordStartupPhase("output streams", phaseStart);
+    
+    arrayType = LumosArray::createType();
+    if (!arrayType) {
+        PyErr_Print();
+        std::cerr << "Failed to create lumos.Array type" << std::endl;
+    }
+    pickleStreamType = createPickleStreamType();
+    if (!pickleStreamType) {
+        PyErr_Print();
+        std::cerr << "Failed to create the pickle stream type" << std::endl;
+    }
+    if (!LumosModule::bindEngine(this)) {
+        PyErr_Print();
+        std::cerr << "Failed to bind the lumos module" << std::endl;
+    }
+    watchNamespace();
+    
+    // Signal handlers belong to the main interpreter; sub-interpreters are
+    // interrupted with an asynchronous exception only
+    if (kind == InterpreterKind::MainInterpreter) {
+        installInterruptHandling();
+        recordStartupPhase("interrupt handling", phaseStart);
+    }
+    
+    return true;
+}
+
+bool PythonEngine::createSubinterpreter() {
+#if PY_VERSION_HEX >= 0x030C0000
+    // Creating a sub-interpreter needs an attached thread state; borrow one
+    // from the main interpreter. With its own GIL, the new interpreter
+    // releases the main GIL once it is up.
+    hostThreadState = PyThreadState_New(PyInterpreterState_Main());
+    PyEval_RestoreThread(hostThreadState);
+    
+    PyInterpreterConfig config = {};
+    config.use_main_obmalloc = 0;
+    config.allow_fork = 0;
+    config.allow_exec = 0;
+    config.allow_threads = 1;
+    config.allow_daemon_threads = 0;
+    config.check_multi_interp_extensions = 1;
+    config.gil = PyInterpreterConfig_OWN_GIL;
+    
+    PyThreadState* sessionState = nullptr;
+    PyStatus status = Py_NewInterpreterFromConfig(&sessionState, &config);
+    if (PyStatus_Exception(status)) {
+        std::cerr << "Failed to create sub-interpreter";
+        if (status.err_msg) {
+            std::cerr << ": " << status.err_msg;
+        }
+        std::cerr << std::endl;
+        
+        PyThreadState_Clear(hostThreadState);
+        PyThreadState_DeleteCurrent();
+        hostThreadState = nullptr;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PythonEngine::installOutputStreams() {
+    static PyMethodDef methods[] = {
+        {"write", (PyCFunction)&PythonEngine::outputStreamWrite, METH_O, nullptr},
+        {"flush", (PyCFunction)&PythonEngine::outputStreamFlush, METH_NOARGS, nullptr},
+        {"isatty", (PyCFunction)&PythonEngine::outputStreamIsatty, METH_NOARGS, nullptr},
+        {"writelines", (PyCFunction)&PythonEngine::outputStreamWriteLines, METH_O, nullptr},
+        {"fileno", (PyCFunction)&PythonEngine::outputStreamFileno, METH_NOARGS, nullptr},
+        {nullptr, nullptr, 0, nullptr}
+    };
+    static PyGetSetDef getset[] = {
+        {"encoding", &PythonEngine::outputStreamEncoding, nullptr, nullptr, nullptr},
+        {"closed", &PythonEngine::outputStreamClosed, nullptr, nullptr, nullptr},
+        {nullptr, nullptr, nullptr, nullptr, nullptr}
+    };
+    static PyType_Slot slots[] = {
+        {Py_tp_methods, methods},
+        {Py_tp_getset, getset},
+        {0, nullptr}
+    };
+    static PyType_Spec spec = {
+        "lumos.OutputStream",
+        sizeof(OutputStreamObject),
+        0,
+        Py_TPFLAGS_DEFAULT,
+        slots
+    };
+    
+    outputStreamType = PyType_FromSpec(&spec);
+    if (!outputStreamType) {
+        return false;
+    }
+    
+    const std::pair<const char*, int> streams[] = {
+        {"stdout", StandardOutput},
+        {"stderr", StandardError}
+    };
+    for (const auto& entry : streams) {
+        OutputStreamObject* stream = PyObject_New(OutputStreamObject, (PyTypeObject*)outputStreamType);
+        if (!stream) {
+            return false;
+        }
+        stream->engine = this;
+        stream->stream = entry.second;
+        
+        // sys holds the only reference from here on
+        int status = PySys_SetObject(entry.first, (PyObject*)stream);
+        Py_DECREF(stream);
+        if (status < 0) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+bool PythonEngine::appendOutput(int stream, const char* data, size_t size) {
+    // Only the command's own thread is captured; warm-up, transfers,
+    // checkpoints and threads started by user code print to the console
+    if (capturingThread == 0 || capturingThread != PyThread_get_thread_ident()) {
+        if (stream == StandardError) {
+            std::cerr.write(data, size);
+        } else {
+            std::cout.write(data, size);
+        }
+        return true;
+    }
+    
+    if (!streamingOutput) {
+        outputBuffer.append(data, size);
+        return true;
+    }
+    
+    streamChunk.append(data, size);
+    
+    // A finished line goes out right away unless the consumer is falling behind,
+    // in which case lines are batched up to the chunk size or flush interval
+    bool lineDone = size > 0 && data[size - 1] == '\n' && outputQueue.size() < outputQueue.capacity() / 2;
+    if (lineDone || streamChunk.size() >= streamChunkSize ||
+        std::chrono::steady_clock::now() - lastStreamFlush >= std::chrono::milliseconds(16)) {
+        return flushStreamChunk();
+    }
+    return true;
+}
+
+bool PythonEngine::flushStreamChunk() {
+    lastStreamFlush = std::chrono::steady_clock::now();
+    if (streamChunk.empty()) {
+        return true;
+    }
+    
+    while (!outputQueue.push(streamChunk)) {
+        if (!blockOnFullOutput) {
+            outputQueue.addElided(std::count(streamChunk.begin(), streamChunk.end(), '\n'));
+            streamChunk.clear();
+            return true;
+        }
+        
+        // Backpressure: wait for the consumer without holding the GIL, and
+        // stay interruptible while doing so
+        {
+            GILRelease waiting;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (PyErr_CheckSignals() < 0) {
+            streamChunk.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+PyObject* PythonEngine::outputStreamWrite(PyObject* self, PyObject* text) {
+    if (!PyUnicode_Check(text)) {
+        PyErr_Format(PyExc_TypeError, "write() argument must be str, not %.100s", Py_TYPE(text)->tp_name);
+        return nullptr;
+    }
+    
+    Py_ssize_t size = 0;
+    const char* data = PyUnicode_AsUTF8AndSize(text, &size);
+    if (!data) {
+        return nullptr;
+    }
+    
+    OutputStreamObject* stream = (OutputStreamObject*)self;
+    stream->engine->lockOutput();
+    bool written = stream->engine->appendOutput(stream->stream, data, static_cast<size_t>(size));
+    stream->engine->unlockOutput();
+    if (!written) {
+        return nullptr;
+    }
+    return PyLong_FromSsize_t(PyUnicode_GetLength(text));
+}
+
+PyObject* PythonEngine::outputStreamFlush(PyObject* self, PyObject* unused) {
+    (void)unused;
+    PythonEngine* engine = ((OutputStreamObject*)self)->engine;
+    if (engine->capturingThread == 0 || engine->capturingThread != PyThread_get_thread_ident()) {
+        std::cout.flush();
+        std::cerr.flush();
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject* PythonEngine::outputStreamIsatty(PyObject* self, PyObject* unused) {
+    (void)self;
+    (void)unused;
+    Py_RETURN_FALSE;
+}
+
+PyObject* PythonEngine::outputStreamWriteLines(PyObject* self, PyObject* lines) {
+    PyObject* iterator = PyObject_GetIter(lines);
+    if (!iterator) {
+        return nullptr;
+    }
+    while (PyObject* line = PyIter_Next(iterator)) {
+        PyObject* written = outputStreamWrite(self, line);
+        Py_DECREF(line);
+        if (!written) {
+            Py_DECREF(iterator);
+            return nullptr;
+        }
+        Py_DECREF(written);
+    }
+    Py_DECREF(iterator);
+    if (PyErr_Occurred()) {
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject* PythonEngine::outputStreamFileno(PyObject* self, PyObject* unused) {
+    (void)self;
+    (void)unused;
+    // Same as io.StringIO: there is no file descriptor behind the stream
+    PyObject* io = PyImport_ImportModule("io");
+    PyObject* unsupported = io ? PyObject_GetAttrString(io, "UnsupportedOperation") : nullptr;
+    if (unsupported) {
+        PyErr_SetString(unsupported, "fileno");
+    }
+    Py_XDECREF(unsupported);
+    Py_XDECREF(io);
+    return nullptr;
+}
+
+PyObject* PythonEngine::outputStreamClosed(PyObject* self, void* closure) {
+    (void)self;
+    (void)closure;
+    Py_RETURN_FALSE;
+}
+
+PyObject* PythonEngine::outputStreamEncoding(PyObject* self, void* closure) {
+    (void)self;
+    (void)closure;
+    return PyUnicode_FromString("utf-8");
+}
+
+void PythonEngine::stopInterpreter() {
+    clearCodeCache();
+    Py_CLEAR(astModule);
+    Py_CLEAR(compileFunction);
+    Py_CLEAR(arrayType);
+    Py_CLEAR(pickleStreamType);
+    clearStreams();
+    unwatchNamespace();
+    clearSnapshot();
+    shutdownInterpreter();
+    
+    // The stream objects died with sys; the type is owned by the interpreter too
+    outputStreamType = nullptr;
+}
+
+void PythonEngine::shutdownInterpreter() {
+    if (kind == InterpreterKind::MainInterpreter) {
+        Py_Finalize();
+    } else {
+        Py_EndInterpreter(PyThreadState_Get());
+        
+        // Back on the borrowed main-interpreter state, which goes away too
+        PyEval_RestoreThread(hostThreadState);
+        PyThreadState_Clear(hostThreadState);
+        PyThreadState_DeleteCurrent();
+        hostThreadState = nullptr;
+    }
+    interpreterState = nullptr;
+}
+
+PythonEngine::GILGuard::GILGuard(PythonEngine& engine)
+    : engine(engine), threadState(nullptr), gilState(PyGILState_UNLOCKED) {
+    if (engine.kind == InterpreterKind::MainInterpreter) {
+        gilState = PyGILState_Ensure();
+    } else {
+        threadState = PyThreadState_New(engine.interpreterState);
+        PyEval_RestoreThread(threadState);
+    }
+}
+
+PythonEngine::GILGuard::~GILGuard() {
+    if (threadState) {
+        PyThreadState_Clear(threadState);
+        PyThreadState_DeleteCurrent();
+    } else {
+        PyGILState_Release(gilState);
+    }
+}
+
+bool PythonEngine::post(Job job, std::chrono::milliseconds timeout) {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        if (!initialized || stopRequested) {
+            return false;
+        }
+        jobs.push_back(QueuedJob{std::move(job), timeout});
+    }
+    jobAvailable.notify_one();
+    return true;
+}
+
+bool PythonEngine::run(Job job) {
+    if (isInterpreterThread()) {
+        job();
+        return true;
+    }
+    
+    // The promise is destroyed unfulfilled if finalize() drops the job
+    auto done = std::make_shared<std::promise<void>>();
+    std::future<void> finished = done->get_future();
+    if (!post([job = std::move(job), done]() { job(); done->set_value(); })) {
+        return false;
+    }
+    
+    try {
+        finished.get();
+        return true;
+    } catch (const std::future_error&) {
+        return false;
+    }
+}
+
+bool PythonEngine::submitCommand(const std::string& command, CommandCallback onFinished,
+                                 std::chrono::milliseconds timeout, OutputMode outputMode) {
+    return post([this, command, onFinished = std::move(onFinished), outputMode]() {
+        std::string result = runCommand(command, outputMode);
+        if (onFinished) {
+            onFinished(result);
+        }
+    }, timeout);
+}
+
+bool PythonEngine::isInterpreterThread() const {
+    return std::this_thread::get_id() == interpreterThreadId;
+}
+
+bool PythonEngine::isBusy() const {
+    std::lock_guard<std::mutex> lock(jobMutex);
+    return jobRunning || !jobs.empty();
+}
+
+bool PythonEngine::findPythonLibrary(std::string& home, std::string& library) {
+    std::filesystem::path executable(getExecutablePath());
+    std::string executablePath = executable.string();
+    
+    // App bundle with the standard library copied into Resources
+    size_t appPos = executablePath.find(".app/Contents/MacOS/");
+    if (appPos != std::string::npos) {
+        std::string resources = executablePath.substr(0, appPos + 4) + "/Contents/Resources";
+        if (std::filesystem::exists(resources + "/python_lib")) {
+            home = resources;
+            library = resources + "/python_lib";
+            return true;
+        }
+    }
+    
+    // Build tree: third_party/cpython in one of the executable's parent
+    // directories, independent of the working directory
+    std::error_code error;
+    for (std::filesystem::path dir = executable.parent_path(); !dir.empty(); dir = dir.parent_path()) {
+        std::filesystem::path candidate = dir / "third_party" / "cpython";
+        if (std::filesystem::exists(candidate / "Lib", error)) {
+            home = candidate.string();
+            library = (candidate / "Lib").string();
+            return true;
+        }
+        if (dir == dir.parent_path()) {
+            break;
+        }
+    }
+    
+    // Last resort: relative to the working directory, as older builds expected
+    home = "../third_party/cpython";
+    library = home + "/Lib";
+    return std::filesystem::exists(library, error);
+}
+
+bool PythonEngine::initializeMainInterpreter() {
+    std::string home;
+    std::string library;
+    bool libraryFound = findPythonLibrary(home, library);
+    
+#ifdef LUMOS_FROZEN_STDLIB
+    // Frozen modules are found before anything on sys.path; a Lib directory
+    // on disk only serves modules left out of the binary
+    PyImport_FrozenModules = lumosFrozenStdlib;
+#else
+    if (!libraryFound) {
+        std::cerr << "Python standard library not found, tried " << library << std::endl;
+    }
+#endif
+    
+    LumosModule::registerBuiltin();
+    
+    // Only the standard library and site-packages are searched; module
+    // directories are listed only when present
+    std::vector<std::string> searchPaths;
+    if (libraryFound) {
+        searchPaths.push_back(library);
+    }
+    for (const std::string& optional : {library + "/lib-dynload", library + "/site-packages", home + "/Modules"}) {
+        std::error_code error;
+        if (std::filesystem::exists(optional, error)) {
+            searchPaths.push_back(optional);
+        }
+    }
+    searchPaths.insert(searchPaths.end(), startupOptions.extraSearchPaths.begin(), startupOptions.extraSearchPaths.end());
+    
+    // Isolated: PYTHON* environment variables, the user site directory and
+    // the working directory do not affect startup
+    PyConfig config;
+    PyConfig_InitIsolatedConfig(&config);
+    
+    // Keep Python's SIGPIPE/SIGXFSZ handling so user code gets BrokenPipeError
+    // instead of the process being killed
+    config.install_signal_handlers = 1;
+    config.site_import = startupOptions.importSite ? 1 : 0;
+    config.import_time = startupOptions.traceImports ? 1 : 0;
+#ifdef LUMOS_FROZEN_STDLIB
+    config.use_frozen_modules = 1;
+#endif
+    
+    PyStatus status = PyConfig_SetBytesString(&config, &config.home, home.c_str());
+    config.module_search_paths_set = 1;
+    for (const std::string& path : searchPaths) {
+        if (PyStatus_Exception(status)) {
+            break;
+        }
+        wchar_t* widePath = Py_DecodeLocale(path.c_str(), nullptr);
+        if (!widePath) {
+            status = PyStatus_NoMemory();
+            break;
+        }
+        status = PyWideStringList_Append(&config.module_search_paths, widePath);
+        PyMem_RawFree(widePath);
+    }
+    
+    if (!PyStatus_Exception(status)) {
+        status = Py_InitializeFromConfig(&config);
+    }
+    PyConfig_Clear(&config);
+    
+    if (PyStatus_Exception(status)) {
+        std::cerr << "Failed to initialize Python interpreter";
+        if (status.err_msg) {
+            std::cerr << ": " << status.err_msg;
+        }
+        std::cerr << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void PythonEngine::recordStartupPhase(const char* name, std::chrono::steady_clock::time_point& phaseStart) {
+    auto now = std::chrono::steady_clock::now();
+    startupTrace.push_back({name, std::chrono::duration<double, std::milli>(now - phaseStart).count()});
+    phaseStart = now;
+}
+
+std::string PythonEngine::getExecutablePath() {
+#ifdef __APPLE__
+    char path[1024];
+    uint32_t size = sizeof(path);
+    if (_NSGetExecutablePath(path, &size) == 0) {
+        return std::string(path);
+    }
+#else
+    char path[1024];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len != -1) {
+        path[len] = '\0';
+        return std::string(path);
+    }
+#endif
+    return "";
+}
+
+std::string PythonEngine::evaluateExpression(const std::string& expression) {
+    std::string output;
+    if (!run([&]() { output = runCommand(expression); })) {
+        return "Error: Python engine not initialized";
+    }
+    return output;
+}
+
+std::string PythonEngine::runCommand(const std::string& expression, OutputMode outputMode) {
+    // Main module dictionary holds the persistent state
+    PyObject* main_dict = mainNamespace();
+    
+    // The native sys.stdout/sys.stderr append to outputBuffer while capturing,
+    // or to the output queue when streaming
+    lockOutput();
+    outputBuffer.clear();
+    capturingThread = PyThread_get_thread_ident();
+    streamingOutput = outputMode == OutputMode::Stream;
+    lastStreamFlush = std::chrono::steady_clock::now();
+    unlockOutput();
+    
+    // Hold our own references in case the cache entry is evicted while running
+    const CompiledCommand* command = compileCommand(expression);
+    PyObject* statements = command ? command->statements : nullptr;
+    PyObject* last_expression = command ? command->lastExpression : nullptr;
+    Py_XINCREF(statements);
+    Py_XINCREF(last_expression);
+    
+    PyObject* result = nullptr;
+    bool ok = command != nullptr && main_dict != nullptr;
+    
+    if (ok && statements) {
+        result = PyEval_EvalCode(statements, main_dict, main_dict);
+        ok = result != nullptr;
+        Py_XDECREF(result);
+        result = nullptr;
+    }
+    
+    if (ok && last_expression) {
+        result = PyEval_EvalCode(last_expression, main_dict, main_dict);
+        ok = result != nullptr;
+    }
+    
+    Py_XDECREF(statements);
+    Py_XDECREF(last_expression);
+    Py_XDECREF(main_dict);
+    
+    // The command may have changed objects without rebinding their names
+    markMutableVariablesChanged();
+    
+    // Hand over whatever is left before the result is reported
+    lockOutput();
+    if (streamingOutput) {
+        PyObject *exc_type, *exc_value, *exc_traceback;
+        PyErr_Fetch(&exc_type, &exc_value, &exc_traceback);
+        if (!flushStreamChunk()) {
+            PyErr_Clear();
+        }
+        PyErr_Restore(exc_type, exc_value, exc_traceback);
+        streamingOutput = false;
+    }
+    capturingThread = 0;
+    std::string output = outputBuffer;
+    unlockOutput();
+    
+    if (!ok) {
+        bool timedOut = false;
+        if (PyErr_ExceptionMatches(PyExc_KeyboardInterrupt)) {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            timedOut = interruptReason == InterruptReason::Timeout;
+        }
+        if (timedOut) {
+            PyErr_Clear();
+            return "Error: Command timed out";
+        }
+        return formatPythonError();
+    }
+    
+    // Show the value of a trailing expression after anything it printed
+    if (result) {
+        if (result != Py_None) {
+            PyObject* repr = PyObject_Repr(result);
+            if (repr) {
+                const char* result_str = PyUnicode_AsUTF8(repr);
+                if (result_str) {
+                    output += result_str;
+                }
+                Py_DECREF(repr);
+            } else {
+                PyErr_Clear();
+            }
+        }
+        Py_DECREF(result);
+    }
+    
+    // Remove trailing newline if present
+    if (!output.empty() && output.back() == '\n') {
+        output.pop_back();
+    }
+    
+    return output;
+}
+
+const PythonEngine::CompiledCommand* PythonEngine::compileCommand(const std::string& source) {
+    size_t key = std::hash<std::string>{}(source);
+    
+    auto cached = codeCacheIndex.find(key);
+    if (cached != codeCacheIndex.end() && cached->second->source == source) {
+        // Move to the front of the LRU list
+        codeCache.splice(codeCache.begin(), codeCache, cached->second);
+        return &codeCache.front();
+    }
+    
+    // Imported on first use to keep it off the startup path
+    if (!astModule) {
+        astModule = PyImport_ImportModule("ast");
+        if (!astModule) {
+            return nullptr;
+        }
+    }
+    
+    // Parse once into an AST, then compile the pieces from that tree
+    PyCompilerFlags flags;
+    flags.cf_flags = PyCF_ONLY_AST;
+    flags.cf_feature_version = PY_MINOR_VERSION;
+    PyObject* tree = Py_CompileStringExFlags(source.c_str(), "<input>", Py_file_input, &flags, -1);
+    if (!tree) {
+        return nullptr;
+    }
+    
+    PyObject* body = PyObject_GetAttrString(tree, "body");
+    PyObject* statements = nullptr;
+    PyObject* last_expression = nullptr;
+    bool ok = body && PyList_Check(body);
+    
+    Py_ssize_t count = ok ? PyList_GET_SIZE(body) : 0;
+    PyObject* last = count > 0 ? PyList_GET_ITEM(body, count - 1) : nullptr;
+    PyObject* expr_type = ok ? PyObject_GetAttrString(astModule, "Expr") : nullptr;
+    int ends_with_expression = (last && expr_type) ? PyObject_IsInstance(last, expr_type) : 0;
+    Py_XDECREF(expr_type);
+    ok = ok && ends_with_expression >= 0;
+    
+    if (ok && ends_with_expression) {
+        // Everything before the trailing expression runs as statements
+        if (count > 1) {
+            PyObject* head = PyList_GetSlice(body, 0, count - 1);
+            ok = head && PyObject_SetAttrString(tree, "body", head) == 0;
+            Py_XDECREF(head);
+            if (ok) {
+                statements = PyObject_CallFunction(compileFunction, "Oss", tree, "<input>", "exec");
+                ok = statements != nullptr;
+            }
+        }
+        
+        if (ok) {
+            PyObject* value = PyObject_GetAttrString(last, "value");
+            PyObject* expression = value ? PyObject_CallMethod(astModule, "Expression", "O", value) : nullptr;
+            last_expression = expression ? PyObject_CallFunction(compileFunction, "Oss", expression, "<input>", "eval") : nullptr;
+            ok = last_expression != nullptr;
+            Py_XDECREF(expression);
+            Py_XDECREF(value);
+        }
+    } else if (ok) {
+        statements = PyObject_CallFunction(compileFunction, "Oss", tree, "<input>", "exec");
+        ok = statements != nullptr;
+    }
+    
+    Py_XDECREF(body);
+    Py_DECREF(tree);
+    
+    if (!ok) {
+        Py_XDECREF(statements);
+        Py_XDECREF(last_expression);
+        return nullptr;
+    }
+    
+    // Evict a colliding entry and the least recently used one if full
+    if (cached != codeCacheIndex.end()) {
+        Py_XDECREF(cached->second->statements);
+        Py_XDECREF(cached->second->lastExpression);
+        codeCache.erase(cached->second);
+        codeCacheIndex.erase(cached);
+    }
+    if (codeCache.size() >= codeCacheCapacity) {
+        CompiledCommand& oldest = codeCache.back();
+        codeCacheIndex.erase(std::hash<std::string>{}(oldest.source));
+        Py_XDECREF(oldest.statements);
+        Py_XDECREF(oldest.lastExpression);
+        codeCache.pop_back();
+    }
+    
+    codeCache.push_front(CompiledCommand{source, statements, last_expression});
+    codeCacheIndex[key] = codeCache.begin();
+    return &codeCache.front();
+}
+
+void PythonEngine::clearCodeCache() {
+    for (CompiledCommand& command : codeCache) {
+        Py_XDECREF(command.statements);
+        Py_XDECREF(command.lastExpression);
+    }
+    codeCache.clear();
+    codeCacheIndex.clear();
+}
+
+std::vector<PythonVariable> PythonEngine::getUserVariables() {
+    std::vector<PythonVariable> variables;
+    run([&]() { variables = collectUserVariables(); });
+    return variables;
+}
+
+std::vector<PythonVariable> PythonEngine::getUserVariables(const std::vector<std::string>& names) {
+    std::vector<PythonVariable> variables;
+    run([&]() {
+        PyObject* main_dict = mainNamespace();
+        if (!main_dict) {
+            PyErr_Clear();
+            return;
+        }
+        
+        for (const std::string& name : names) {
+            PyObject* key = PyUnicode_FromString(name.c_str());
+            PyObject* value = nullptr;
+            if (!key || getDictItemRef(main_dict, key, &value) < 0) {
+                PyErr_Clear();
+            }
+            
+            PythonVariable var;
+            if (describeVariable(name, value, var)) {
+                variables.push_back(var);
+            }
+            Py_XDECREF(value);
+            Py_XDECREF(key);
+        }
+        Py_DECREF(main_dict);
+    });
+    return variables;
+}
+
+std::vector<PythonVariable> PythonEngine::collectUserVariables() {
+    std::vector<PythonVariable> variables;
+    
+    // Get main module dictionary
+    PyObject* main_dict = mainNamespace();
+    if (!main_dict) {
+        PyErr_Clear();
+        return variables;
+    }
+    
+    // Snapshot of the keys; the list is ours, so its items stay alive
+    PyObject* keys = PyDict_Keys(main_dict);
+    if (!keys) {
+        PyErr_Clear();
+        Py_DECREF(main_dict);
+        return variables;
+    }
+    
+    Py_ssize_t size = PyList_Size(keys);
+    for (Py_ssize_t i = 0; i < size; i++) {
+        PyObject* key = PyList_GetItem(keys, i);
+        if (!key) continue;
+        
+        const char* key_str = PyUnicode_AsUTF8(key);
+        if (!key_str) continue;
+        
+        // Get the value; the entry may be gone by now
+        PyObject* value = nullptr;
+        if (getDictItemRef(main_dict, key, &value) < 0) {
+            PyErr_Clear();
+        }
+        
+        PythonVariable var;
+        if (describeVariable(key_str, value, var)) {
+            variables.push_back(var);
+        }
+        Py_XDECREF(value);
+        PyErr_Clear();
+    }
+    
+    Py_DECREF(keys);
+    Py_DECREF(main_dict);
+    return variables;
+}
+
+bool PythonEngine::describeVariable(const std::string& name, PyObject* value, PythonVariable& var, bool withRepr) {
+    // Skip built-in variables that start with __
+    if (name.substr(0, 2) == "__") {
+        return false;
     }
     
-    setupPythonPath();
+    // Remember which names need a look after every command
+    {
+        std::lock_guard<std::mutex> lock(variableChangesMutex);
+        if (value && !isImmutableValue(value, arrayType)) {
+            mutableVariables.insert(name);
+        } else {
+            mutableVariables.erase(name);
+        }
+    }
+    if (!value) {
+        return false;
+    }
     
-    Py_Initialize();
+    bool described = false;
+    PyObject* type_obj = PyObject_Type(value);
+    PyObject* type_name = PyObject_GetAttrString(type_obj, "__name__");
+    const char* type_str = type_name ? PyUnicode_AsUTF8(type_name) : nullptr;
     
-    if (!Py_IsInitialized()) {
-        std::cerr << "Failed to initialize Python interpreter" << std::endl;
-        return false;
+    // Cut at maxReprLength; a pending repr shows as "..."
+    std::string repr = "...";
+    auto started = std::chrono::steady_clock::now();
+    if (type_str && (!withRepr || boundedRepr(value, maxReprLength, repr))) {
+        var.name = name;
+        var.type = type_str;
+        var.value = repr;
+        
+        var.displayString = var.name + ": " + var.type;
+        
+        // Add value if it's not too long
+        if (var.value.length() < 100) {
+            var.displayString += " = " + var.value;
+        }
+        var.hasSummary = withRepr && summarizeNumbers(value, summaryMinimumCount, var.summary);
+        described = true;
     }
     
-    initialized = true;
-    return true;
+    // Descriptions this slow once are not made inline again: foreign reprs
+    // by type, large native containers (long to summarize) by name
+    if (withRepr) {
+        bool slow = std::chrono::steady_clock::now() - started > slowReprTime;
+        if (hasNativeRepr(value)) {
+            if (slow) {
+                slowReprNames.insert(name);
+            } else {
+                slowReprNames.erase(name);
+            }
+        } else if (slow) {
+            slowReprTypes.insert(Py_TYPE(value)->tp_name);
+        }
+    }
+    
+    Py_XDECREF(type_obj);
+    Py_XDECREF(type_name);
+    PyErr_Clear();
+    return described;
 }
 
-void PythonEngine::finalize() {
-    if (initialized) {
-        Py_Finalize();
-        initialized = false;
+PythonEngine::VariableChanges PythonEngine::takeVariableChanges() {
+    VariableChanges changes;
+    std::lock_guard<std::mutex> lock(variableChangesMutex);
+    changes.everything = allVariablesChanged || namespaceWatcher < 0;
+    if (!changes.everything) {
+        changes.names.swap(changedVariableOrder);
     }
+    changedVariables.clear();
+    changedVariableOrder.clear();
+    allVariablesChanged = false;
+    variablesChanged = namespaceWatcher < 0;
+    ++variableChangesTaken;
+    return changes;
 }
 
-void PythonEngine::setupPythonPath() {
-    std::string executablePath = getExecutablePath();
-    std::string baseDir;
-    std::string pythonLib;
-    
-    // Check if we're running from an app bundle
-    if (executablePath.find(".app/Contents/MacOS/") != std::string::npos) {
-        // Extract path to the .app bundle directory
-        size_t appPos = executablePath.find(".app/Contents/MacOS/");
-        std::string appBundlePath = executablePath.substr(0, appPos + 4); // Include .app
+PythonEngine::VariableChanges PythonEngine::takeCheckpointChanges() {
+    VariableChanges changes;
+    std::lock_guard<std::mutex> lock(variableChangesMutex);
+    changes.everything = checkpointEverything || namespaceWatcher < 0;
+    if (!changes.everything) {
+        changes.names.assign(checkpointChanges.begin(), checkpointChanges.end());
+    }
+    checkpointChanges.clear();
+    checkpointEverything = false;
+    // Names marked before now have to be marked again for the next take
+    ++variableChangesTaken;
+    return changes;
+}
+
+PythonEngine::VariableDiff PythonEngine::getVariableDiff(uint64_t sinceVersion) {
+    VariableDiff diff;
+    run([&]() {
+        updateSnapshot();
+        diff.version = snapshotVersion;
+        diff.reset = sinceVersion == 0 || sinceVersion < snapshotHorizon;
         
-        // First try to use bundled Python library within the app
-        std::string bundledPythonLib = appBundlePath + "/Contents/Resources/python_lib";
-        if (std::filesystem::exists(bundledPythonLib)) {
-            // Use bundled Python library
-            pythonLib = bundledPythonLib;
-            baseDir = appBundlePath + "/Contents/Resources";
-            
-            // Set up paths using bundled library
-            std::string pythonPath = pythonLib;
-            setenv("PYTHONPATH", pythonPath.c_str(), 1);
-            
-            // For PYTHONHOME, we need to simulate the structure Python expects
-            // Create a temporary structure or use the bundle path
-            setenv("PYTHONHOME", baseDir.c_str(), 1);
-            
-            return;
+        if (diff.reset) {
+            // Full listing in namespace order
+            PyObject* main_dict = mainNamespace();
+            PyObject* keys = main_dict ? PyDict_Keys(main_dict) : nullptr;
+            Py_ssize_t size = keys ? PyList_Size(keys) : 0;
+            for (Py_ssize_t i = 0; i < size; i++) {
+                const char* key_str = PyUnicode_AsUTF8(PyList_GetItem(keys, i));
+                auto it = key_str ? snapshotEntries.find(key_str) : snapshotEntries.end();
+                if (it != snapshotEntries.end()) {
+                    diff.changed.push_back(it->second.variable);
+                }
+            }
+            PyErr_Clear();
+            Py_XDECREF(keys);
+            Py_XDECREF(main_dict);
+        } else {
+            // In the order they changed, so new names come last
+            std::vector<const SnapshotEntry*> changed;
+            for (const auto& entry : snapshotEntries) {
+                if (entry.second.version > sinceVersion) {
+                    changed.push_back(&entry.second);
+                }
+            }
+            std::sort(changed.begin(), changed.end(),
+                      [](const SnapshotEntry* a, const SnapshotEntry* b) { return a->version < b->version; });
+            for (const SnapshotEntry* entry : changed) {
+                diff.changed.push_back(entry->variable);
+            }
+            for (const auto& removed : snapshotRemoved) {
+                if (removed.second > sinceVersion) {
+                    diff.removed.push_back(removed.first);
+                }
+            }
         }
         
-        // Fallback: search for original build directory structure
-        std::vector<std::string> searchPaths = {
-            appBundlePath + "/../../../third_party/cpython",  // From build/src/applications/repl_gui/app.app
-            appBundlePath + "/../../third_party/cpython",     // Alternative location
-            appBundlePath + "/../third_party/cpython",        // Another alternative
-        };
-        
-        bool foundPython = false;
-        for (const auto& searchPath : searchPaths) {
-            std::filesystem::path pythonLibPath = std::filesystem::path(searchPath) / "Lib";
-            if (std::filesystem::exists(pythonLibPath)) {
-                baseDir = searchPath;
-                foundPython = true;
-                break;
+        // Forget old removals; a caller further behind than this gets a reset
+        if (snapshotRemoved.size() > snapshotRemovedLimit) {
+            snapshotRemoved.clear();
+            snapshotHorizon = snapshotVersion;
+        }
+    });
+    return diff;
+}
+
+void PythonEngine::updateSnapshot() {
+    VariableChanges changes = takeVariableChanges();
+    PyObject* main_dict = mainNamespace();
+    if (!main_dict) {
+        PyErr_Clear();
+        return;
+    }
+    
+    if (changes.everything) {
+        // Everything bound is described again; unbound entries go right away
+        snapshotBacklog.clear();
+        snapshotBacklogNames.clear();
+        std::unordered_set<std::string> present;
+        PyObject* keys = PyDict_Keys(main_dict);
+        Py_ssize_t size = keys ? PyList_Size(keys) : 0;
+        for (Py_ssize_t i = 0; i < size; i++) {
+            const char* key_str = PyUnicode_AsUTF8(PyList_GetItem(keys, i));
+            if (!key_str) {
+                PyErr_Clear();
+                continue;
             }
+            present.insert(key_str);
+            queueSnapshotEntry(key_str);
         }
+        Py_XDECREF(keys);
+        PyErr_Clear();
         
-        if (!foundPython) {
-            // Final fallback
-            baseDir = "../third_party/cpython";
+        std::vector<std::string> gone;
+        for (const auto& entry : snapshotEntries) {
+            if (!present.count(entry.first)) {
+                gone.push_back(entry.first);
+            }
+        }
+        for (const std::string& name : gone) {
+            updateSnapshotEntry(name, nullptr);
         }
     } else {
-        // Running from build directory, use relative paths
-        baseDir = "../third_party/cpython";
+        for (std::string& name : changes.names) {
+            queueSnapshotEntry(std::move(name));
+        }
     }
     
-    // Construct Python paths for non-bundled case
-    pythonLib = baseDir + "/Lib";
-    std::string pythonSitePackages = baseDir + "/Lib/site-packages";  
-    std::string pythonModules = baseDir + "/Modules";
-    std::string pythonPath = pythonLib + ":" + pythonSitePackages + ":" + pythonModules;
+    // Names left when the budget runs out are described by the next refresh
+    auto deadline = std::chrono::steady_clock::now() + reprBudget;
+    while (!snapshotBacklog.empty() && std::chrono::steady_clock::now() < deadline) {
+        std::string name = std::move(snapshotBacklog.front());
+        snapshotBacklog.pop_front();
+        snapshotBacklogNames.erase(name);
+        
+        PyObject* key = PyUnicode_FromString(name.c_str());
+        PyObject* value = nullptr;
+        if (!key || getDictItemRef(main_dict, key, &value) < 0) {
+            PyErr_Clear();
+        }
+        updateSnapshotEntry(name, value);
+        Py_XDECREF(value);
+        Py_XDECREF(key);
+    }
+    Py_DECREF(main_dict);
     
-    setenv("PYTHONPATH", pythonPath.c_str(), 1);
-    setenv("PYTHONHOME", baseDir.c_str(), 1);
+    if (!snapshotBacklog.empty()) {
+        variablesChanged = true;
+    }
 }
 
-std::string PythonEngine::getExecutablePath() {
-#ifdef __APPLE__
-    char path[1024];
-    uint32_t size = sizeof(path);
-    if (_NSGetExecutablePath(path, &size) == 0) {
-        return std::string(path);
+void PythonEngine::queueSnapshotEntry(std::string name) {
+    if (snapshotBacklogNames.insert(name).second) {
+        snapshotBacklog.push_back(std::move(name));
     }
-#else
-    char path[1024];
-    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
-    if (len != -1) {
-        path[len] = '\0';
-        return std::string(path);
+}
+
+bool PythonEngine::updateSnapshotEntry(const std::string& name, PyObject* value, bool deferSlowRepr) {
+    auto it = snapshotEntries.find(name);
+    
+    // The same immutable object describes the same way
+    if (value && it != snapshotEntries.end() && it->second.immutableValue == value) {
+        return false;
     }
-#endif
-    return "";
+    
+    // A slow repr gets a job of its own; until then the row keeps its old text
+    bool slow = deferSlowRepr && value && (slowReprTypes.count(Py_TYPE(value)->tp_name) || slowReprNames.count(name));
+    if (slow) {
+        deferRepr(name);
+        if (it != snapshotEntries.end() && it->second.variable.type == shortTypeName(value)) {
+            return false;
+        }
+    }
+    
+    PythonVariable var;
+    if (!describeVariable(name, value, var, !slow)) {
+        if (it != snapshotEntries.end()) {
+            Py_XDECREF(it->second.immutableValue);
+            snapshotEntries.erase(it);
+            snapshotRemoved[name] = ++snapshotVersion;
+            return true;
+        }
+        return false;
+    }
+    
+    SnapshotEntry& entry = snapshotEntries[name];
+    PyObject* previousValue = entry.immutableValue;
+    entry.immutableValue = isImmutableValue(value, arrayType) ? Py_NewRef(value) : nullptr;
+    
+    // A rebinding to an equal value, or a mutable object whose repr stayed put
+    bool changed = entry.version == 0 || entry.variable.type != var.type || entry.variable.value != var.value ||
+                   entry.variable.hasSummary != var.hasSummary || entry.variable.summary != var.summary;
+    if (changed) {
+        entry.variable = var;
+        entry.version = ++snapshotVersion;
+        snapshotRemoved.erase(name);
+    }
+    Py_XDECREF(previousValue);
+    return changed;
 }
 
-std::string PythonEngine::evaluateExpression(const std::string& expression) {
-    if (!initialized) {
-        return "Error: Python engine not initialized";
+void PythonEngine::deferRepr(const std::string& name) {
+    if (std::find(deferredReprs.begin(), deferredReprs.end(), name) == deferredReprs.end()) {
+        deferredReprs.push_back(name);
+    }
+    if (!deferredReprPosted) {
+        deferredReprPosted = post([this]() { runDeferredRepr(); });
+    }
+}
+
+void PythonEngine::runDeferredRepr() {
+    // One repr per job, so commands queued meanwhile run in between
+    deferredReprPosted = false;
+    if (deferredReprs.empty()) {
+        return;
+    }
+    std::string name = std::move(deferredReprs.front());
+    deferredReprs.pop_front();
+    
+    PyObject* main_dict = mainNamespace();
+    PyObject* key = main_dict ? PyUnicode_FromString(name.c_str()) : nullptr;
+    PyObject* value = nullptr;
+    if (!key || getDictItemRef(main_dict, key, &value) < 0) {
+        PyErr_Clear();
+    }
+    if (main_dict && updateSnapshotEntry(name, value, false)) {
+        std::lock_guard<std::mutex> lock(variableChangesMutex);
+        variablesChanged = true;
+    }
+    Py_XDECREF(value);
+    Py_XDECREF(key);
+    Py_XDECREF(main_dict);
+    
+    if (!deferredReprs.empty()) {
+        deferredReprPosted = post([this]() { runDeferredRepr(); });
+    }
+}
+
+void PythonEngine::clearSnapshot() {
+    for (auto& entry : snapshotEntries) {
+        Py_XDECREF(entry.second.immutableValue);
+    }
+    snapshotEntries.clear();
+    snapshotRemoved.clear();
+    snapshotBacklog.clear();
+    snapshotBacklogNames.clear();
+    slowReprTypes.clear();
+    slowReprNames.clear();
+    deferredReprs.clear();
+    deferredReprPosted = false;
+    
+    // Versions keep counting so diffs against an earlier interpreter reset
+    snapshotHorizon = ++snapshotVersion;
+}
+
+void PythonEngine::watchNamespace() {
+#if PY_VERSION_HEX >= 0x030C0000
+    PyObject* main_dict = mainNamespace();
+    namespaceWatcher = main_dict ? PyDict_AddWatcher(&PythonEngine::namespaceChanged) : -1;
+    if (namespaceWatcher >= 0 && PyDict_Watch(namespaceWatcher, main_dict) < 0) {
+        PyDict_ClearWatcher(namespaceWatcher);
+        namespaceWatcher = -1;
     }
+    Py_XDECREF(main_dict);
     
-    // Get main module and its dictionary for persistent state
-    PyObject* main_module = PyImport_AddModule("__main__");
-    PyObject* main_dict = PyModule_GetDict(main_module);
+    if (namespaceWatcher < 0) {
+        PyErr_Clear();
+        std::cerr << "Variable change tracking unavailable, variables are re-read in full" << std::endl;
+        return;
+    }
+    std::lock_guard<std::mutex> lock(watchingEnginesMutex);
+    watchingEngines.emplace_back(PyInterpreterState_Get(), this);
+    ++watchingEnginesVersion;
+#endif
+}
+
+void PythonEngine::unwatchNamespace() {
+#if PY_VERSION_HEX >= 0x030C0000
+    if (namespaceWatcher < 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(watchingEnginesMutex);
+        watchingEngines.erase(std::remove_if(watchingEngines.begin(), watchingEngines.end(),
+                                             [this](const auto& entry) { return entry.second == this; }),
+                              watchingEngines.end());
+        ++watchingEnginesVersion;
+    }
+    PyDict_ClearWatcher(namespaceWatcher);
+    PyErr_Clear();
+    namespaceWatcher = -1;
+#endif
+    for (RecentKey& recent : recentChangedKeys) {
+        Py_XDECREF(recent.key.exchange(nullptr));
+    }
     
-    // Redirect stdout to capture print output
-    PyObject* io_module = PyImport_ImportModule("io");
-    PyObject* string_io = PyObject_CallMethod(io_module, "StringIO", NULL);
-    PyObject* sys_module = PyImport_ImportModule("sys");
-    PyObject* old_stdout = PyObject_GetAttrString(sys_module, "stdout");
-    PyObject_SetAttrString(sys_module, "stdout", string_io);
+    std::lock_guard<std::mutex> lock(variableChangesMutex);
+    changedVariables.clear();
+    changedVariableOrder.clear();
+    mutableVariables.clear();
+    allVariablesChanged = true;
+    variablesChanged = true;
+    checkpointEverything = true;
+}
+
+#if PY_VERSION_HEX >= 0x030C0000
+int PythonEngine::namespaceChanged(PyDict_WatchEvent event, PyObject* dict, PyObject* key, PyObject* newValue) {
+    (void)dict;
+    (void)newValue;
     
-    std::string output = "";
+    PythonEngine* engine = findWatchingEngine();
+    if (!engine) {
+        return 0;
+    }
     
-    // Try to evaluate as expression first
-    PyObject* result = PyRun_String(expression.c_str(), Py_eval_input, main_dict, main_dict);
+    switch (event) {
+    case PyDict_EVENT_ADDED:
+    case PyDict_EVENT_MODIFIED:
+    case PyDict_EVENT_DELETED:
+        engine->markVariableChanged(key);
+        break;
+    default:
+        // Cleared, replaced by a copy, or gone
+        engine->markAllVariablesChanged();
+        break;
+    }
+    return 0;
+}
+#endif
+
+void PythonEngine::markVariableChanged(PyObject* key) {
+    // Stores in a loop hit the same few names; each is in the set until the next take
+    RecentKey& recent = recentChangedKeys[(reinterpret_cast<uintptr_t>(key) >> 4) % recentKeySlots];
+    uint64_t taken = variableChangesTaken.load(std::memory_order_acquire);
+    if (key == recent.key.load(std::memory_order_relaxed) && recent.taken.load(std::memory_order_relaxed) == taken) {
+        return;
+    }
+    if (!key || !PyUnicode_Check(key)) {
+        return;
+    }
     
-    if (result) {
-        // Expression evaluation succeeded
-        if (result != Py_None) {
-            PyObject* repr = PyObject_Repr(result);
-            if (repr) {
-                const char* result_str = PyUnicode_AsUTF8(repr);
-                output = result_str ? result_str : "";
-                Py_DECREF(repr);
-            }
+    // Runs inside dict operations; leave any exception in flight untouched
+    PyObject *exc_type, *exc_value, *exc_traceback;
+    PyErr_Fetch(&exc_type, &exc_value, &exc_traceback);
+    Py_ssize_t size = 0;
+    const char* name = PyUnicode_AsUTF8AndSize(key, &size);
+    PyObject* previousKey = nullptr;
+    if (name && !(size >= 2 && name[0] == '_' && name[1] == '_')) {
+        std::string changed(name, static_cast<size_t>(size));
+        std::lock_guard<std::mutex> lock(variableChangesMutex);
+        if (checkpointing) {
+            checkpointChanges.insert(changed);
         }
-        Py_DECREF(result);
-    } else {
-        // Clear error and try as statement or multi-line code
-        PyErr_Clear();
-        
-        // For multi-line code blocks, use Py_file_input
-        result = PyRun_String(expression.c_str(), Py_file_input, main_dict, main_dict);
-        
-        if (!result) {
-            // If file input fails, try single input for simple statements
-            PyErr_Clear();
-            result = PyRun_String(expression.c_str(), Py_single_input, main_dict, main_dict);
+        if (changedVariables.insert(changed).second) {
+            changedVariableOrder.push_back(std::move(changed));
         }
+        variablesChanged = true;
         
-        if (result) {
-            Py_DECREF(result);
-        } else {
-            // Restore stdout before returning error
-            PyObject_SetAttrString(sys_module, "stdout", old_stdout);
-            Py_DECREF(old_stdout);
-            Py_DECREF(string_io);
-            Py_DECREF(sys_module);
-            Py_DECREF(io_module);
-            return formatPythonError();
-        }
-    }
-    
-    // Get captured output from StringIO
-    PyObject* captured_output = PyObject_CallMethod(string_io, "getvalue", NULL);
-    if (captured_output) {
-        const char* captured_str = PyUnicode_AsUTF8(captured_output);
-        if (captured_str && strlen(captured_str) > 0) {
-            if (!output.empty()) {
-                output += "\n" + std::string(captured_str);
-            } else {
-                output = captured_str;
-            }
-            // Remove trailing newline if present
-            if (!output.empty() && output.back() == '\n') {
-                output.pop_back();
-            }
+        previousKey = recent.key.exchange(Py_NewRef(key));
+        recent.taken = taken;
+    }
+    Py_XDECREF(previousKey);
+    PyErr_Clear();
+    PyErr_Restore(exc_type, exc_value, exc_traceback);
+}
+
+void PythonEngine::markAllVariablesChanged() {
+    std::lock_guard<std::mutex> lock(variableChangesMutex);
+    allVariablesChanged = true;
+    variablesChanged = true;
+    checkpointEverything = true;
+}
+
+void PythonEngine::markMutableVariablesChanged() {
+    std::lock_guard<std::mutex> lock(variableChangesMutex);
+    for (const std::string& name : mutableVariables) {
+        if (changedVariables.insert(name).second) {
+            changedVariableOrder.push_back(name);
         }
-        Py_DECREF(captured_output);
+        variablesChanged = true;
+    }
+    // Empty unless checkpoints run
+    checkpointChanges.insert(checkpointMutable.begin(), checkpointMutable.end());
+}
+
+bool PythonEngine::postIngest(Job job) {
+    if (!initialized) {
+        return false;
     }
     
-    // Restore stdout
-    PyObject_SetAttrString(sys_module, "stdout", old_stdout);
-    Py_DECREF(old_stdout);
-    Py_DECREF(string_io);
-    Py_DECREF(sys_module);
-    Py_DECREF(io_module);
+#ifdef Py_GIL_DISABLED
+    if (isInterpreterThread()) {
+        job();
+        return true;
+    }
     
-    return output;
+    GILGuard gil(*this);
+    job();
+    return true;
+#else
+    {
+        std::lock_guard<std::mutex> lock(ingestMutex);
+        if (ingestStopping) {
+            return false;
+        }
+        if (!ingestThread.joinable()) {
+            ingestThread = std::thread(&PythonEngine::ingestLoop, this);
+        }
+        ingestJobs.push_back(std::move(job));
+    }
+    ingestAvailable.notify_one();
+    return true;
+#endif
 }
 
-std::vector<PythonVariable> PythonEngine::getUserVariables() {
-    std::vector<PythonVariable> variables;
-    
-    if (!initialized) {
-        return variables;
+void PythonEngine::ingestLoop() {
+    std::unique_lock<std::mutex> lock(ingestMutex);
+    while (true) {
+        ingestAvailable.wait(lock, [this]() { return ingestStopping || !ingestJobs.empty(); });
+        if (ingestStopping) {
+            return;
+        }
+        
+        // Everything queued while waiting for the GIL goes in one turn
+        std::deque<Job> batch;
+        batch.swap(ingestJobs);
+        lock.unlock();
+        {
+            GILGuard gil(*this);
+            for (Job& job : batch) {
+                job();
+            }
+        }
+        lock.lock();
+    }
+}
+
+void PythonEngine::stopIngest() {
+    {
+        std::lock_guard<std::mutex> lock(ingestMutex);
+        ingestStopping = true;
+        ingestJobs.clear();
     }
+    ingestAvailable.notify_all();
+    if (ingestThread.joinable()) {
+        ingestThread.join();
+    }
+    ingestStopping = false;
+}
+
+bool PythonEngine::setVariable(const std::string& name, const std::string& expression, std::string& error) {
+    PyObject* code = Py_CompileString(expression.c_str(), "<inject>", Py_eval_input);
+    PyObject* scratch = code ? PyDict_New() : nullptr;
+    PyObject* value = scratch ? PyEval_EvalCode(code, scratch, scratch) : nullptr;
     
-    // Get main module dictionary
-    PyObject* main_module = PyImport_AddModule("__main__");
-    PyObject* main_dict = PyModule_GetDict(main_module);
+    bool ok = false;
+    if (value) {
+        ok = setVariable(name, value, error);
+    } else {
+        error = formatPythonError();
+    }
     
-    if (!main_dict) return variables;
+    Py_XDECREF(value);
+    Py_XDECREF(scratch);
+    Py_XDECREF(code);
+    return ok;
+}
+
+bool PythonEngine::setVariable(const std::string& name, PyObject* value, std::string& error) {
+    PyObject* key = PyUnicode_FromString(name.c_str());
+    if (!key || !PyUnicode_IsIdentifier(key)) {
+        Py_XDECREF(key);
+        PyErr_Clear();
+        error = "Error: Invalid variable name '" + name + "'";
+        return false;
+    }
     
-    PyObject* keys = PyDict_Keys(main_dict);
-    if (!keys) return variables;
+    PyObject* main_dict = value ? mainNamespace() : nullptr;
+    bool ok = main_dict && PyDict_SetItem(main_dict, key, value) == 0;
+    if (!ok) {
+        error = formatPythonError();
+    }
     
-    Py_ssize_t size = PyList_Size(keys);
-    for (Py_ssize_t i = 0; i < size; i++) {
-        PyObject* key = PyList_GetItem(keys, i);
-        if (!key) continue;
+    Py_XDECREF(main_dict);
+    Py_DECREF(key);
+    return ok;
+}
+
+PyObject* PythonEngine::createArray(std::shared_ptr<const void> owner, const void* data, size_t count,
+                                    LumosArray::ElementType type) {
+    return LumosArray::create(arrayType, std::move(owner), data, count, type);
+}
+
+void PythonEngine::recordIngest(const std::string& name, PyObject* value,
+                                std::chrono::steady_clock::time_point received) {
+    auto now = std::chrono::steady_clock::now();
+    PyObject* previous = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(streamsMutex);
+        Stream& stream = streams[name];
+        previous = stream.latest;
+        stream.latest = Py_NewRef(value);
         
-        const char* key_str = PyUnicode_AsUTF8(key);
-        if (!key_str) continue;
+        stream.latencyMs = std::chrono::duration<double, std::milli>(now - received).count();
+        stream.totalLatencyMs += stream.latencyMs;
+        ++stream.messages;
         
-        // Skip built-in variables that start with __
-        std::string key_name(key_str);
-        if (key_name.substr(0, 2) == "__") continue;
+        if (stream.windowMessages == 0 && stream.messages == 1) {
+            stream.windowStart = now;
+        }
+        ++stream.windowMessages;
+        std::chrono::duration<double> window = now - stream.windowStart;
+        if (window.count() >= 1.0) {
+            stream.rate = stream.windowMessages / window.count();
+            stream.windowMessages = 0;
+            stream.windowStart = now;
+        }
+        stream.lastUpdate = now;
+    }
+    
+    // Outside the lock: releasing the old value may run arbitrary Python code
+    Py_XDECREF(previous);
+}
+
+void PythonEngine::recordDroppedIngest(const std::string& name) {
+    std::lock_guard<std::mutex> lock(streamsMutex);
+    ++streams[name].dropped;
+}
+
+std::vector<PythonEngine::StreamStats> PythonEngine::getStreamStats() const {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<StreamStats> stats;
+    
+    std::lock_guard<std::mutex> lock(streamsMutex);
+    for (const auto& entry : streams) {
+        const Stream& stream = entry.second;
+        StreamStats item;
+        item.name = entry.first;
+        item.messages = stream.messages;
+        item.dropped = stream.dropped;
+        item.latencyMs = stream.latencyMs;
+        item.meanLatencyMs = stream.messages ? stream.totalLatencyMs / stream.messages : 0.0;
         
-        // Get the value and its type
-        PyObject* value = PyDict_GetItem(main_dict, key);
-        if (value) {
-            PythonVariable var;
-            var.name = key_name;
-            
-            PyObject* type_obj = PyObject_Type(value);
-            PyObject* type_name = PyObject_GetAttrString(type_obj, "__name__");
-            PyObject* repr_obj = PyObject_Repr(value);
-            
-            if (type_name && repr_obj) {
-                const char* type_str = PyUnicode_AsUTF8(type_name);
-                const char* repr_str = PyUnicode_AsUTF8(repr_obj);
-                
-                if (type_str && repr_str) {
-                    var.type = type_str;
-                    var.value = repr_str;
-                    
-                    var.displayString = var.name + ": " + var.type;
-                    
-                    // Add value if it's not too long
-                    if (var.value.length() < 100) {
-                        var.displayString += " = " + var.value;
-                    }
-                    
-                    variables.push_back(var);
-                }
-            }
-            
-            Py_XDECREF(type_obj);
-            Py_XDECREF(type_name);
-            Py_XDECREF(repr_obj);
+        // A stream that went quiet has no rate, however fast it was
+        std::chrono::duration<double> idle = now - stream.lastUpdate;
+        item.secondsSinceUpdate = stream.messages ? idle.count() : 0.0;
+        double rate = stream.rate;
+        std::chrono::duration<double> window = stream.lastUpdate - stream.windowStart;
+        if (rate == 0.0 && window.count() > 0.0) {
+            // Still in the first window
+            rate = stream.windowMessages / window.count();
         }
+        item.rate = (stream.messages && idle.count() < 2.0) ? rate : 0.0;
+        stats.push_back(item);
     }
     
-    Py_DECREF(keys);
-    return variables;
+    std::sort(stats.begin(), stats.end(), [](const StreamStats& a, const StreamStats& b) { return a.name < b.name; });
+    return stats;
+}
+
+PyObject* PythonEngine::getLatest(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(streamsMutex);
+    auto it = streams.find(name);
+    if (it == streams.end() || !it->second.latest) {
+        return nullptr;
+    }
+    return Py_NewRef(it->second.latest);
+}
+
+void PythonEngine::clearStreams() {
+    std::unordered_map<std::string, Stream> released;
+    {
+        std::lock_guard<std::mutex> lock(streamsMutex);
+        released.swap(streams);
+    }
+    for (auto& entry : released) {
+        Py_XDECREF(entry.second.latest);
+    }
+}
+
+void PythonEngine::lockOutput() {
+#ifdef Py_GIL_DISABLED
+    PyMutex_Lock(&outputMutex);
+#endif
+}
+
+void PythonEngine::unlockOutput() {
+#ifdef Py_GIL_DISABLED
+    PyMutex_Unlock(&outputMutex);
+#endif
+}
+
+PythonEngine::GILRelease::GILRelease() : threadState(PyEval_SaveThread()) {
+}
+
+PythonEngine::GILRelease::~GILRelease() {
+    PyEval_RestoreThread(threadState);
 }
 
 void PythonEngine::acquireGIL() {
     if (initialized) {
-        PyGILState_Ensure();
+        heldGILGuards.push_back(std::make_unique<GILGuard>(*this));
     }
 }
 
 void PythonEngine::releaseGIL() {
-    if (initialized) {
-        PyGILState_Release(PyGILState_Ensure());
+    if (!heldGILGuards.empty()) {
+        heldGILGuards.pop_back();
     }
 }
 
@@ -292,6 +2370,7 @@ std::string PythonEngine::formatPythonError() {
     if (PyErr_Occurred()) {
         PyObject* exc_type, *exc_value, *exc_traceback;
         PyErr_Fetch(&exc_type, &exc_value, &exc_traceback);
+        PyErr_NormalizeException(&exc_type, &exc_value, &exc_traceback);
         
         std::string error_msg = "Error: ";
         if (exc_value) {
@@ -305,6 +2384,11 @@ std::string PythonEngine::formatPythonError() {
             }
         }
         
+        // Exceptions without a message (KeyboardInterrupt) show their type
+        if (error_msg == "Error: " && exc_type && PyType_Check(exc_type)) {
+            error_msg += ((PyTypeObject*)exc_type)->tp_name;
+        }
+        
         Py_XDECREF(exc_type);
         Py_XDECREF(exc_value);
         Py_XDECREF(exc_traceback);
@@ -2,6 +2,23 @@
 
 #include <string>
 #include <vector>
+#include <list>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include "output_queue.h"
+#include "lumos_array.h"
+#include "numeric_summary.h"
+#include "pickle_stream.h"
+#include "columnar_file.h"
+#include "checkpoint_store.h"
 
 // Prevent Python/Qt slot keyword conflicts
 #ifdef slots
@@ -15,29 +32,479 @@ struct PythonVariable {
     std::string type;
     std::string value;
     std::string displayString;
+    bool hasSummary = false;       // Numeric container; see summarizeNumbers()
+    NumericSummary summary;
 };
 
+// Threading model:
+// - The interpreter lives on a dedicated thread owned by the engine. It is
+//   initialized there and every job runs there in the order it was queued.
+// - That thread holds the GIL only while a job runs; while idle it waits with
+//   the GIL released, so no other thread ever waits on an idle interpreter.
+// - The UI and network threads never hold the GIL. They queue jobs, or run
+//   ingest jobs that attach through GILGuard on free-threaded builds.
+// - A watchdog thread delivers timeouts. It takes the GIL only where no
+//   SIGINT handler is installed, to raise the interrupt as an async exception.
+// The blocking methods may be called from any thread; called from inside a
+// job they run directly.
 class PythonEngine {
 public:
-    PythonEngine();
+    using Job = std::function<void()>;
+    using CommandCallback = std::function<void(const std::string& result)>;
+    
+    // Capture: printed output is part of the command result.
+    // Stream: it goes to getOutputQueue() while the command runs and the
+    // result only holds the value of a trailing expression or the error.
+    enum class OutputMode { Capture, Stream };
+
+    // MainInterpreter runs Py_Initialize(). Subinterpreter needs a running
+    // main interpreter and gets its own GIL, so it executes in parallel with
+    // every other engine (Python 3.12+).
+    enum class InterpreterKind { MainInterpreter, Subinterpreter };
+
+    explicit PythonEngine(InterpreterKind kind = InterpreterKind::MainInterpreter);
     ~PythonEngine();
 
+    // Start/stop the interpreter thread. finalize() waits for the running
+    // job and drops anything still queued. Finalize sub-interpreters before
+    // the main one.
     bool initialize();
     void finalize();
     
+    static bool subinterpretersSupported();
+    static bool isFreeThreaded();
+    
+    // Main-interpreter startup, applied by initialize(). The interpreter is
+    // isolated from PYTHON* environment variables and the working directory
+    // and only searches the bundled standard library plus extraSearchPaths.
+    struct StartupOptions {
+        bool importSite = true;       // Process site-packages .pth files and sitecustomize
+        bool traceImports = false;    // Per-import timings on stderr (-X importtime)
+        std::vector<std::string> extraSearchPaths;
+    };
+    void setStartupOptions(const StartupOptions& options) { startupOptions = options; }
+    
+    // Milliseconds spent in each startup phase, valid once initialize() returns
+    struct StartupPhase {
+        std::string name;
+        double milliseconds;
+    };
+    const std::vector<StartupPhase>& getStartupTrace() const { return startupTrace; }
+    
+    // Blocking: wait until queued work ahead of the call is done
     std::string evaluateExpression(const std::string& expression);
     std::vector<PythonVariable> getUserVariables();
     
+    // Current values of `names` only; names no longer bound are left out
+    std::vector<PythonVariable> getUserVariables(const std::vector<std::string>& names);
+    
+    // Versioned, incremental view of the user variables. Pass the version
+    // of the previous diff (0 the first time) to get only the entries added,
+    // changed or removed since. `reset` means `changed` is a full listing in
+    // namespace order and earlier state should be dropped. Type names and
+    // reprs are cached per name; an immutable value that is still the same
+    // object is not described again. A refresh spends a bounded time on
+    // reprs; names it did not get to keep hasVariableChanges() set and come
+    // with a later diff. Blocking like getUserVariables().
+    struct VariableDiff {
+        uint64_t version = 0;
+        bool reset = false;
+        std::vector<PythonVariable> changed;
+        std::vector<std::string> removed;
+    };
+    VariableDiff getVariableDiff(uint64_t sinceVersion);
+    
+    // Cheap from any thread: has anything been bound, rebound or deleted in
+    // __main__ (or possibly mutated by a command) since the last diff
+    bool hasVariableChanges() const { return variablesChanged; }
+    
+    // Non-blocking: callbacks run on the interpreter thread, so GUI code
+    // should hand results back through a queued signal. A non-zero timeout
+    // interrupts the job once it has run that long.
+    bool submitCommand(const std::string& command, CommandCallback onFinished,
+                       std::chrono::milliseconds timeout = std::chrono::milliseconds::zero(),
+                       OutputMode outputMode = OutputMode::Capture);
+    bool post(Job job, std::chrono::milliseconds timeout = std::chrono::milliseconds::zero());
+    bool run(Job job);
+    
+    // Data ingest that must not wait for the running command. Free-threaded
+    // builds run the job right away on the calling thread, attached to the
+    // interpreter. With a GIL it is queued for an ingest thread, which a
+    // running command lets in every switch interval (sys.getswitchinterval()),
+    // so the caller never waits for the GIL. Not to be called concurrently
+    // with finalize().
+    bool postIngest(Job job);
+    
+    // Evaluate `expression` in a scratch namespace and bind the result to
+    // `name` in __main__. Call from a job or ingest job.
+    bool setVariable(const std::string& name, const std::string& expression, std::string& error);
+    
+    // Bind an already built object (borrowed) to `name` in __main__. A null
+    // `value` reports the pending Python error instead.
+    bool setVariable(const std::string& name, PyObject* value, std::string& error);
+    
+    // Wrap numeric data in a lumos.Array without copying it. `owner` keeps
+    // the memory at `data` alive until Python drops the array. Call from a
+    // job or ingest job.
+    PyObject* createArray(std::shared_ptr<const void> owner, const void* data, size_t count,
+                          LumosArray::ElementType type);
+    
+    PyObject* getArrayType() const { return arrayType; }
+    
+    // Raise KeyboardInterrupt in the running job. Returns false when idle.
+    bool interrupt();
+    
+    // Ingest streams: every injected name keeps its latest value and
+    // statistics, readable from Python through the built-in lumos module.
+    struct StreamStats {
+        std::string name;
+        uint64_t messages = 0;
+        uint64_t dropped = 0;            // Refused while ingest was paused
+        double rate = 0.0;               // Messages per second over the last full second
+        double latencyMs = 0.0;          // Receive to visible in Python, last message
+        double meanLatencyMs = 0.0;
+        double secondsSinceUpdate = 0.0;
+    };
+    // Call from an ingest job once `value` is bound; `received` is when the
+    // message arrived
+    void recordIngest(const std::string& name, PyObject* value, std::chrono::steady_clock::time_point received);
+    void recordDroppedIngest(const std::string& name);
+    std::vector<StreamStats> getStreamStats() const;
+    PyObject* getLatest(const std::string& name) const;   // New reference, nullptr if unknown; call attached
+    void setIngestPaused(bool paused) { ingestPaused = paused; }
+    bool isIngestPaused() const { return ingestPaused; }
+    
+    // Import modules, then run startup scripts in __main__, on a background
+    // thread that shares the interpreter with queued commands, so a later
+    // interactive import finds the module loaded. The callback runs on that
+    // thread before each item and once more with done == total.
+    using WarmupCallback = std::function<void(size_t done, size_t total, const std::string& item)>;
+    bool startWarmup(const std::vector<std::string>& modules, const std::vector<std::string>& scripts,
+                     WarmupCallback onProgress = nullptr);
+    bool isWarmingUp() const { return warmupRunning; }
+    
+    // Save user variables to a file, or bind the entries of such a file in
+    // __main__, on a background thread that takes GIL turns with commands like
+    // the warm-up. Pickle files hold one dict and are streamed through the C
+    // pickler. Columnar files hold numeric arrays only (see columnar_file.h);
+    // saving everything leaves other values out, and loading maps the file
+    // and binds read-only views. Saving with `names` empty takes every user
+    // variable except modules. One transfer at a time; both callbacks run on
+    // the transfer thread, which must not start the next transfer from them.
+    enum class FileFormat { Pickle, Columnar };
+    using TransferProgress = std::function<void(uint64_t bytes, uint64_t totalBytes)>;
+    using TransferCallback = std::function<void(bool ok, size_t count, const std::string& error)>;
+    bool saveVariables(const std::string& path, const std::vector<std::string>& names,
+                       TransferProgress onProgress, TransferCallback onFinished,
+                       FileFormat format = FileFormat::Pickle);
+    bool loadVariables(const std::string& path, TransferProgress onProgress, TransferCallback onFinished,
+                       FileFormat format = FileFormat::Pickle);
+    bool isTransferring() const { return transferRunning; }
+    
+    // Checkpoint the user variables to `path` every `interval` on a background
+    // thread (see checkpoint_store.h). A checkpoint writes the variables the
+    // namespace watcher saw bound, rebound or deleted since the previous one,
+    // plus those holding mutable values when a command ran since; the first
+    // one, and every one on a Python without dict watchers, writes them all.
+    // Modules, values that do not pickle and values whose pickle takes more
+    // than a quarter of `maxBytes` (or what is left of it) are left out. The
+    // file is compacted once it grows past `maxBytes` and twice its live data.
+    bool startCheckpoints(const std::string& path, std::chrono::seconds interval, uint64_t maxBytes);
+    // A checkpoint still being written is abandoned, not committed
+    void stopCheckpoints();
+    // Bind the variables of the last complete checkpoint in `path`; a transfer
+    // like loadVariables()
+    bool restoreCheckpoint(const std::string& path, TransferCallback onFinished);
+    
+    // Whether `name` is bound in __main__. Blocking like getUserVariables().
+    bool hasVariable(const std::string& name);
+    
+    // Non-blocking: unbind every user variable (names not starting with "__")
+    // in one queued job; onFinished runs on the interpreter thread after it
+    bool clearUserVariables(Job onFinished = nullptr);
+    
+    // Streamed output, drained by a single consumer. When it is full the
+    // producer either drops chunks (counted as elided lines) or waits.
+    OutputChunkQueue& getOutputQueue() { return outputQueue; }
+    void setBlockOnFullOutput(bool block) { blockOnFullOutput = block; }
+    
     bool isInitialized() const { return initialized; }
+    bool isInterpreterThread() const;
+    bool isBusy() const;
+    
+    // Scoped GIL handling for code outside the interpreter thread.
+    // GILGuard attaches the calling thread to this engine's interpreter (and
+    // takes its GIL) for its lifetime; it also works for sub-interpreters,
+    // which PyGILState does not know about. GILRelease detaches the current
+    // thread for its lifetime, around blocking waits.
+    class GILGuard {
+    public:
+        explicit GILGuard(PythonEngine& engine);
+        ~GILGuard();
+        GILGuard(const GILGuard&) = delete;
+        GILGuard& operator=(const GILGuard&) = delete;
+    private:
+        PythonEngine& engine;
+        PyThreadState* threadState;
+        PyGILState_STATE gilState;
+    };
     
-    // Thread-safe operations
+    class GILRelease {
+    public:
+        GILRelease();
+        ~GILRelease();
+        GILRelease(const GILRelease&) = delete;
+        GILRelease& operator=(const GILRelease&) = delete;
+    private:
+        PyThreadState* threadState;
+    };
+    
+    // Unscoped form of GILGuard; calls must pair up per thread, innermost first
     void acquireGIL();
     void releaseGIL();
     
 private:
-    bool initialized;
-    void setupPythonPath();
+    // Result of compiling one command: statements to exec, plus the trailing
+    // expression (if any) to evaluate and print like an interactive shell
+    struct CompiledCommand {
+        std::string source;
+        PyObject* statements;
+        PyObject* lastExpression;
+    };
+    
+    std::atomic<bool> initialized;
+    InterpreterKind kind;
+    StartupOptions startupOptions;
+    std::vector<StartupPhase> startupTrace;
+    PyInterpreterState* interpreterState;
+    PyThreadState* hostThreadState;          // Main-interpreter state a sub-interpreter was created from
+    
+    struct QueuedJob {
+        Job job;
+        std::chrono::milliseconds timeout{0};
+    };
+    
+    enum class InterruptReason { None, User, Timeout };
+    
+    // Interpreter thread and its job queue
+    std::thread interpreterThread;
+    std::thread::id interpreterThreadId;
+    unsigned long interpreterThreadIdent;    // Python's id, for PyThreadState_SetAsyncExc
+    mutable std::mutex jobMutex;
+    std::condition_variable jobAvailable;
+    std::deque<QueuedJob> jobs;
+    bool jobRunning;
+    bool stopRequested;
+    
+    // Running job, its deadline and why it was interrupted (guarded by jobMutex)
+    uint64_t currentJob;
+    uint64_t lastJobSerial;
+    bool hasDeadline;
+    std::chrono::steady_clock::time_point jobDeadline;
+    InterruptReason interruptReason;
+    uint64_t asyncInterruptJob;              // For the watchdog to stop through PyThreadState_SetAsyncExc
+    std::condition_variable deadlineChanged;
+    std::thread watchdogThread;
+    bool interruptHandlerInstalled;
+    bool wakeSignalInstalled;
+    
+    // Background warm-up; stopped before the interpreter shuts down
+    std::thread warmupThread;
+    std::atomic<bool> warmupRunning;
+    std::atomic<bool> warmupCancelled;
+    std::atomic<unsigned long> warmupThreadIdent;
+    
+    // Background save/load; stopped before the interpreter shuts down
+    std::thread transferThread;
+    std::atomic<bool> transferRunning;
+    std::atomic<bool> transferCancelled;
+    
+    // Ingest jobs of GIL builds, run in batches by ingestThread; stopped
+    // before the interpreter shuts down
+    std::thread ingestThread;
+    std::mutex ingestMutex;
+    std::condition_variable ingestAvailable;
+    std::deque<Job> ingestJobs;
+    bool ingestStopping;
+    
+    // Background checkpoints; stopped before the interpreter shuts down
+    std::thread checkpointThread;
+    std::mutex checkpointMutex;
+    std::condition_variable checkpointWake;
+    std::atomic<bool> checkpointStopping;
+    
+    void interpreterLoop(std::promise<bool>& started);
+    void watchdogLoop();
+    bool interruptJob(uint64_t job, InterruptReason reason);
+    void deliverAsyncInterrupt(uint64_t job);
+    void installInterruptHandling();
+    void warmupLoop(std::vector<std::string> modules, std::vector<std::string> scripts, WarmupCallback onProgress);
+    bool runStartupScript(const std::string& path);
+    void stopWarmup();
+    using TransferJob = std::function<bool(const FileProgress& progress, size_t& count)>;
+    bool startTransfer(TransferJob transfer, TransferProgress onProgress, TransferCallback onFinished);
+    void stopTransfer();
+    PyObject* selectVariables(const std::vector<std::string>& names, FileFormat format);
+    bool bindVariables(PyObject* variables, size_t& count);
+    void ingestLoop();
+    void stopIngest();
+    void checkpointLoop(std::string path, std::chrono::seconds interval, uint64_t maxBytes);
+    bool writeCheckpoint(CheckpointStore& store, const std::string& path, uint64_t maxBytes);
+    void clearPendingInterrupt();
+    bool startInterpreter();
+    bool createSubinterpreter();
+    void stopInterpreter();
+    void shutdownInterpreter();
+    std::string runCommand(const std::string& expression, OutputMode outputMode = OutputMode::Capture);
+    std::vector<PythonVariable> collectUserVariables();
+    bool describeVariable(const std::string& name, PyObject* value, PythonVariable& var, bool withRepr = true);
+    
+    // LRU cache of compiled commands keyed by source hash
+    static const size_t codeCacheCapacity = 256;
+    std::list<CompiledCommand> codeCache;
+    std::unordered_map<size_t, std::list<CompiledCommand>::iterator> codeCacheIndex;
+    PyObject* astModule;
+    PyObject* compileFunction;
+    
+    // Native sys.stdout/sys.stderr installed once; writes from the thread
+    // running a command land in outputBuffer, all others go to the process
+    // streams
+    enum OutputStream { StandardOutput = 1, StandardError = 2 };
+    PyObject* outputStreamType;
+    std::string outputBuffer;
+    std::atomic<unsigned long> capturingThread;   // Python's id of the capturing thread, 0 when none
+#ifdef Py_GIL_DISABLED
+    PyMutex outputMutex{};                   // Threads started by user code print concurrently without a GIL
+#endif
+    void lockOutput();
+    void unlockOutput();
+    
+    // Streaming: writes are coalesced into streamChunk and pushed when it is
+    // large, old, or ends a line while the queue has room
+    static const size_t streamChunkSize = 16384;
+    static const size_t outputQueueCapacity = 64;
+    OutputChunkQueue outputQueue;
+    std::string streamChunk;
+    std::chrono::steady_clock::time_point lastStreamFlush;
+    bool streamingOutput;
+    std::atomic<bool> blockOnFullOutput;
+    
+    bool installOutputStreams();
+    
+    // lumos.Array type of this interpreter
+    PyObject* arrayType;
+    // File stream type the pickler writes to and reads from in saves, loads
+    // and checkpoints
+    PyObject* pickleStreamType;
+    
+    struct Stream {
+        PyObject* latest = nullptr;
+        uint64_t messages = 0;
+        uint64_t dropped = 0;
+        double latencyMs = 0.0;
+        double totalLatencyMs = 0.0;
+        double rate = 0.0;
+        uint64_t windowMessages = 0;
+        std::chrono::steady_clock::time_point windowStart;
+        std::chrono::steady_clock::time_point lastUpdate;
+    };
+    mutable std::mutex streamsMutex;
+    std::unordered_map<std::string, Stream> streams;
+    std::atomic<bool> ingestPaused;
+    void clearStreams();
+    
+    // Names bound, rebound or deleted in __main__ since the last
+    // takeVariableChanges(), tracked with a dict watcher (Python 3.12+).
+    // Names holding mutable objects are reported after every command too,
+    // since changes inside them leave the namespace alone. `everything` asks
+    // for a full re-read: the first call, a cleared or replaced namespace, or
+    // a Python without dict watchers.
+    struct VariableChanges {
+        bool everything = false;
+        std::vector<std::string> names;
+    };
+    VariableChanges takeVariableChanges();
+    // The same for checkpoints, tracked only while they run. Names last
+    // checkpointed with a mutable value come back after every command.
+    VariableChanges takeCheckpointChanges();
+    int namespaceWatcher;
+    mutable std::mutex variableChangesMutex;
+    std::unordered_set<std::string> changedVariables;
+    std::vector<std::string> changedVariableOrder;    // The same names, first change first
+    std::unordered_set<std::string> mutableVariables;
+    bool allVariablesChanged;
+    std::atomic<bool> variablesChanged;
+    std::atomic<uint64_t> variableChangesTaken;
+    bool checkpointing;
+    std::unordered_set<std::string> checkpointChanges;
+    std::unordered_set<std::string> checkpointMutable;
+    bool checkpointEverything;
+    
+    // Keys already marked since the last take, by address, so stores in a
+    // loop return early. Slots hold a reference so an address is not reused.
+    struct RecentKey {
+        std::atomic<PyObject*> key{nullptr};
+        std::atomic<uint64_t> taken{0};
+    };
+    static const size_t recentKeySlots = 16;
+    RecentKey recentChangedKeys[recentKeySlots];
+    void watchNamespace();
+    void unwatchNamespace();
+    void markVariableChanged(PyObject* key);
+    void markAllVariablesChanged();
+    void markMutableVariablesChanged();
+    
+    // Described variables behind getVariableDiff(); interpreter thread only
+    struct SnapshotEntry {
+        PythonVariable variable;
+        PyObject* immutableValue = nullptr;   // Held so its identity stays meaningful
+        uint64_t version = 0;
+    };
+    static const size_t snapshotRemovedLimit = 4096;
+    std::unordered_map<std::string, SnapshotEntry> snapshotEntries;
+    std::unordered_map<std::string, uint64_t> snapshotRemoved;   // Name to version of its removal
+    uint64_t snapshotVersion;
+    uint64_t snapshotHorizon;                 // Diffs from before this need a reset
+    void updateSnapshot();
+    bool updateSnapshotEntry(const std::string& name, PyObject* value, bool deferSlowRepr = true);
+    void clearSnapshot();
+    
+    // Displayed reprs are cut at maxReprLength. A refresh stops describing after
+    // reprBudget and leaves the rest of snapshotBacklog to the next one; types
+    // whose repr took longer than slowReprTime, and names whose description
+    // did, are described by jobs of their own
+    static const size_t maxReprLength = 1000;
+    static const size_t summaryMinimumCount = 32;
+    static constexpr std::chrono::milliseconds reprBudget{20};
+    static constexpr std::chrono::milliseconds slowReprTime{50};
+    std::deque<std::string> snapshotBacklog;
+    std::unordered_set<std::string> snapshotBacklogNames;
+    void queueSnapshotEntry(std::string name);
+    std::unordered_set<std::string> slowReprTypes;
+    std::unordered_set<std::string> slowReprNames;
+    std::deque<std::string> deferredReprs;
+    bool deferredReprPosted = false;
+    void deferRepr(const std::string& name);
+    void runDeferredRepr();
+#if PY_VERSION_HEX >= 0x030C0000
+    static int namespaceChanged(PyDict_WatchEvent event, PyObject* dict, PyObject* key, PyObject* newValue);
+#endif
+    bool appendOutput(int stream, const char* data, size_t size);
+    bool flushStreamChunk();
+    static PyObject* outputStreamWrite(PyObject* self, PyObject* text);
+    static PyObject* outputStreamFlush(PyObject* self, PyObject* unused);
+    static PyObject* outputStreamIsatty(PyObject* self, PyObject* unused);
+    static PyObject* outputStreamWriteLines(PyObject* self, PyObject* lines);
+    static PyObject* outputStreamFileno(PyObject* self, PyObject* unused);
+    static PyObject* outputStreamClosed(PyObject* self, void* closure);
+    static PyObject* outputStreamEncoding(PyObject* self, void* closure);
+    
+    const CompiledCommand* compileCommand(const std::string& source);
+    void clearCodeCache();
+    bool initializeMainInterpreter();
+    bool findPythonLibrary(std::string& home, std::string& library);
     std::string getExecutablePath();
+    void recordStartupPhase(const char* name, std::chrono::steady_clock::time_point& phaseStart);
     std::string formatPythonError();
     std::string truncateString(const std::string& str, size_t maxLength = 30);
 };
\ No newline at end of file
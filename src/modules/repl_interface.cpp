@@ -1,17 +1,23 @@
 #include "repl_interface.h"
 #include "settings_manager.h"
+#include "session_manager.h"
+#include "workspace_files.h"
 #include <QApplication>
 #include <QScrollBar>
 #include <QFont>
-#include <QDateTime>
 #include <QCoreApplication>
 #include <QDir>
-#include <QFile>
 #include <QDebug>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <algorithm>
+#include <limits>
 
 REPLInterface::REPLInterface(PythonEngine *pythonEngine, SettingsManager *settingsManager, QWidget *parent)
-    : QWidget(parent), pythonEngine(pythonEngine), settingsManager(settingsManager), currentLayoutMode("bottom_input"),
-      historyIndex(-1), executingCommand(false), filePickerMode(false), selectedFileIndex(0)
+    : QWidget(parent), pythonEngine(pythonEngine), settingsManager(settingsManager), sessionManager(nullptr),
+      activeSession("main"), currentLayoutMode("bottom_input"),
+      historyIndex(-1), executingCommand(false), outputTimer(nullptr), sessionJournal(nullptr),
+      replayIndex(0), replaying(false), replayPaced(false), filePickerMode(false), selectedFileIndex(0)
 {
     setupUI();
     setupConnections();
@@ -57,11 +63,29 @@ void REPLInterface::setupUI()
 void REPLInterface::setupConnections()
 {
     // No button connections needed - using keyboard shortcuts only
+
+    // Results arrive from the interpreter thread
+    connect(this, &REPLInterface::commandFinished,
+            this, &REPLInterface::onCommandFinished, Qt::QueuedConnection);
+
+    // print() output is picked up at display rate while a command runs
+    outputTimer = new QTimer(this);
+    outputTimer->setInterval(16);
+    connect(outputTimer, &QTimer::timeout, this, &REPLInterface::drainStreamedOutput);
+
+    // A replay moves on once the previous command is done, however it finished
+    connect(this, &REPLInterface::commandExecuted, this, [this]() {
+        if (replaying)
+        {
+            scheduleReplay();
+        }
+    });
 }
 
 void REPLInterface::setupEventFilters()
 {
     inputArea->installEventFilter(this);
+    outputArea->installEventFilter(this);
 }
 
 bool REPLInterface::eventFilter(QObject *obj, QEvent *event)
@@ -73,6 +97,22 @@ bool REPLInterface::eventFilter(QObject *obj, QEvent *event)
         return handleKeyPress(keyEvent);
     }
     
+    // Ctrl+C stops a running command or replay from either text area
+    if ((executingCommand || replaying) && (obj == inputArea || obj == outputArea) &&
+        (event->type() == QEvent::KeyPress || event->type() == QEvent::ShortcutOverride))
+    {
+        QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+        if (isInterruptKey(keyEvent))
+        {
+            if (event->type() == QEvent::KeyPress)
+            {
+                interruptCommand();
+            }
+            keyEvent->accept();
+            return true;
+        }
+    }
+    
     // Handle normal input area events
     if (obj == inputArea && event->type() == QEvent::KeyPress)
     {
@@ -144,23 +184,59 @@ bool REPLInterface::handleKeyPress(QKeyEvent *keyEvent)
     return false; // Let other events be processed normally
 }
 
+bool REPLInterface::isInterruptKey(QKeyEvent *keyEvent) const
+{
+    // Qt maps Command to ControlModifier on macOS; the Control key is MetaModifier there
+#ifdef Q_OS_MACOS
+    const Qt::KeyboardModifier interruptModifier = Qt::MetaModifier;
+#else
+    const Qt::KeyboardModifier interruptModifier = Qt::ControlModifier;
+#endif
+    return keyEvent->key() == Qt::Key_C && (keyEvent->modifiers() & interruptModifier);
+}
+
+void REPLInterface::interruptCommand()
+{
+    if (replaying)
+    {
+        finishReplay(QString("Replay stopped after %1 of %2 entries").arg(replayIndex).arg(replayEntries.size()));
+    }
+    if (pythonEngine && pythonEngine->interrupt())
+    {
+        appendOutput(formatResult("Interrupting..."));
+    }
+}
+
 void REPLInterface::executeCommand()
 {
-    if (executingCommand)
+    if (executingCommand || replaying)
         return;
 
     QString command = inputArea->toPlainText().trimmed();
     if (command.isEmpty())
         return;
 
-    executingCommand = true;
-
     // Add to history
     addToHistory(command);
 
     // Clear input
     inputArea->clear();
 
+    runCommand(command);
+}
+
+void REPLInterface::runCommand(const QString &command)
+{
+    executingCommand = true;
+
+    // The file picker records the file it loads instead of a bare 'load', and
+    // a replay's commands are recorded as they run
+    QString cmd = command.toLower();
+    if (sessionJournal && cmd != "load" && cmd != "replay" && !cmd.startsWith("replay "))
+    {
+        sessionJournal->recordCommand(command.toStdString());
+    }
+
     // Check for special commands first
     if (handleSpecialCommand(command))
     {
@@ -171,30 +247,98 @@ void REPLInterface::executeCommand()
     // Show command in output
     appendOutput(formatPrompt(command));
 
-    // Execute command
+    // Execute command on the interpreter thread; executingCommand stays set
+    // until the result comes back
     if (pythonEngine && pythonEngine->isInitialized())
     {
-        QString result = QString::fromStdString(pythonEngine->evaluateExpression(command.toStdString()));
-
-        // Show result if not empty
-        if (!result.isEmpty())
+        // Optional wall-clock limit in seconds, 0 disables it
+        double timeoutSeconds = settingsManager ? settingsManager->getValue("python.command_timeout", 0.0).toDouble() : 0.0;
+        auto timeout = std::chrono::milliseconds(static_cast<long long>(timeoutSeconds * 1000.0));
+
+        // When printing outruns the display, either drop output ("elide") or slow Python down ("block")
+        QString overflow = settingsManager ? settingsManager->getString("repl.output_overflow", "elide") : "elide";
+        pythonEngine->setBlockOnFullOutput(overflow == "block");
+        int maxLines = settingsManager ? settingsManager->getInt("repl.max_output_lines", 20000) : 20000;
+        outputArea->document()->setMaximumBlockCount(maxLines);
+
+        bool queued = pythonEngine->submitCommand(command.toStdString(), [this, command](const std::string &result) {
+            emit commandFinished(command, QString::fromStdString(result));
+        }, timeout, PythonEngine::OutputMode::Stream);
+        if (queued)
         {
-            appendOutput(formatResult(result));
+            outputTimer->start();
+            return;
         }
+    }
 
-        emit commandExecuted(command, result);
+    QString error = "Error: Python engine not initialized";
+    appendOutput(formatResult(error));
+    emit commandExecuted(command, error);
+
+    appendOutput(""); // Empty line for spacing
+    executingCommand = false;
+}
+
+void REPLInterface::onCommandFinished(const QString &command, const QString &result)
+{
+    // Everything the command printed is queued before its result is reported
+    outputTimer->stop();
+    appendStreamedOutput(std::numeric_limits<size_t>::max());
+    if (!partialOutputLine.isEmpty())
+    {
+        appendOutput(partialOutputLine);
+        partialOutputLine.clear();
     }
-    else
+
+    // Show result if not empty
+    if (!result.isEmpty())
     {
-        QString error = "Error: Python engine not initialized";
-        appendOutput(formatResult(error));
-        emit commandExecuted(command, error);
+        appendOutput(formatResult(result));
     }
 
+    emit commandExecuted(command, result);
+
     appendOutput(""); // Empty line for spacing
     executingCommand = false;
 }
 
+void REPLInterface::drainStreamedOutput()
+{
+    // Bounded work per frame; the rest waits in the queue
+    appendStreamedOutput(64 * 1024);
+}
+
+void REPLInterface::appendStreamedOutput(size_t maxBytes)
+{
+    OutputChunkQueue &queue = pythonEngine->getOutputQueue();
+
+    QString text = partialOutputLine;
+    size_t bytes = 0;
+    while (bytes < maxBytes && queue.pop(outputChunk))
+    {
+        bytes += outputChunk.size();
+        text += QString::fromUtf8(outputChunk.data(), static_cast<qsizetype>(outputChunk.size()));
+    }
+
+    // Keep an unfinished line until the rest of it arrives
+    int lastNewline = text.lastIndexOf('\n');
+    partialOutputLine = text.mid(lastNewline + 1);
+    if (lastNewline >= 0)
+    {
+        appendOutput(text.left(lastNewline));
+    }
+
+    // Dropped chunks came after everything that was queued, so report them once the queue is empty
+    if (queue.size() == 0)
+    {
+        size_t elided = queue.takeElidedLines();
+        if (elided > 0)
+        {
+            appendOutput(QString("... %1 lines of output elided ...").arg(elided));
+        }
+    }
+}
+
 void REPLInterface::addToHistory(const QString &command)
 {
     if (!command.isEmpty() && (commandHistory.isEmpty() || commandHistory.last() != command))
@@ -253,71 +397,56 @@ bool REPLInterface::handleSpecialCommand(const QString &command)
     }
     else if (cmd == "clear vars")
     {
-        // Clear Python variables silently
-        clearVariables();
-        emit commandExecuted(command, "Variables cleared");
+        // Clear Python variables silently; reported once the interpreter has done it
+        clearVariables(command);
         return true;
     }
     else if (cmd == "save" || cmd.startsWith("save "))
     {
-        // Parse save command arguments
-        QString args = cmd.startsWith("save ") ? cmd.mid(5).trimmed() : "";
-        QStringList parts = args.split(' ', Qt::SkipEmptyParts);
-        
-        QString varName = "";
-        QString fileName = "";
-        
-        if (parts.size() == 0) {
-            // "save" - save all variables with timestamp
-        } else if (parts.size() == 1) {
-            // Could be "save filename" or "save varname"
-            // Check if it's a valid variable name by checking if it exists
-            QString checkCode = QString("'%1' in globals()").arg(parts[0]);
-            std::string exists = pythonEngine->evaluateExpression(checkCode.toStdString());
-            if (exists == "True") {
-                // It's a variable name
-                varName = parts[0];
-            } else {
-                // It's a filename
-                fileName = parts[0];
-            }
-        } else if (parts.size() == 2) {
-            // "save varname filename"
-            varName = parts[0];
-            fileName = parts[1];
-        }
-        
-        QString result = saveVariablesToPickle(fileName, varName);
-        appendOutput(formatResult(result));
-        emit commandExecuted(command, result);
+        // Variable and file names keep their case, so parse the original command
+        QStringList arguments = command.trimmed().mid(4).split(' ', Qt::SkipEmptyParts);
+        emit transferStatusChanged("Saving...");
+        WorkspaceFiles::save(pythonEngine, WorkspaceFiles::defaultDirectory(settingsManager), arguments,
+                             transferProgress("Saving"), transferFinished(command));
         return true;
     }
     else if (cmd == "load" || cmd.startsWith("load "))
     {
-        // Load variables from pickle file
-        if (cmd == "load") {
+        if (cmd == "load")
+        {
             // Start interactive file picker
             startFilePicker();
             return true;
-        } else {
-            QString filename = cmd.mid(5).trimmed(); // Extract filename after "load "
-            if (!filename.isEmpty()) {
-                QString result = loadVariablesFromPickle(filename);
-                appendOutput(formatResult(result));
-                emit commandExecuted(command, result);
-                return true;
-            } else {
-                QString error = "Error: Please specify a filename";
-                appendOutput(formatResult(error));
-                emit commandExecuted(command, error);
-                return true;
-            }
         }
+        loadVariables(command, command.trimmed().mid(5).trimmed());
+        return true;
+    }
+    else if (cmd == "restore")
+    {
+        emit transferStatusChanged("Restoring...");
+        WorkspaceFiles::restore(pythonEngine, WorkspaceFiles::defaultDirectory(settingsManager), transferFinished(command));
+        return true;
+    }
+    else if (cmd == "replay" || cmd.startsWith("replay "))
+    {
+        // File names keep their case, so parse the original command
+        QString result = startReplay(command.trimmed().mid(6).split(' ', Qt::SkipEmptyParts));
+        appendOutput(formatResult(result));
+        emit commandExecuted(command, result);
+        return true;
     }
     else if (cmd == "ls")
     {
-        // List pickle files in current data directory
-        QString result = listPickleFiles();
+        // List workspace files in current data directory
+        QString result = WorkspaceFiles::describeFiles(WorkspaceFiles::defaultDirectory(settingsManager));
+        appendOutput(formatResult(result));
+        emit commandExecuted(command, result);
+        return true;
+    }
+    else if (cmd == "sessions" || cmd.startsWith("session "))
+    {
+        // Session names keep their case, so parse the original command
+        QString result = cmd == "sessions" ? listSessions() : handleSessionCommand(command.trimmed().mid(8).trimmed());
         appendOutput(formatResult(result));
         emit commandExecuted(command, result);
         return true;
@@ -334,290 +463,248 @@ bool REPLInterface::handleSpecialCommand(const QString &command)
     return false; // Not a special command
 }
 
-void REPLInterface::clearVariables()
+void REPLInterface::setSessionJournal(SessionJournal *journal)
+{
+    sessionJournal = journal;
+}
+
+void REPLInterface::setFrameInjector(FrameInjector injector)
 {
-    if (!pythonEngine || !pythonEngine->isInitialized())
+    frameInjector = std::move(injector);
+}
+
+QString REPLInterface::startReplay(QStringList arguments)
+{
+    bool paced = !arguments.isEmpty() && arguments[0].toLower() == "paced";
+    if (paced)
     {
-        return;
+        arguments.removeFirst();
+    }
+    if (arguments.size() > 1)
+    {
+        return "Error: Usage: replay [paced] [journal]";
     }
 
-    // Get all user variables and delete them
-    auto variables = pythonEngine->getUserVariables();
-
-    for (const auto &var : variables)
+    // Without a file, the journal the previous session left behind
+    QString directory = WorkspaceFiles::defaultDirectory(settingsManager);
+    QString path = arguments.isEmpty() ? WorkspaceFiles::previousJournalPath(directory)
+                                       : QDir(directory).absoluteFilePath(arguments[0]);
+    std::vector<SessionJournal::Entry> entries;
+    std::string error;
+    if (!SessionJournal::read(path.toStdString(), entries, error))
+    {
+        return QString("Error: %1").arg(QString::fromStdString(error));
+    }
+    if (entries.empty())
     {
-        QString deleteCmd = QString("del %1").arg(QString::fromStdString(var.name));
-        pythonEngine->evaluateExpression(deleteCmd.toStdString());
+        return QString("Error: Nothing to replay in %1").arg(QFileInfo(path).fileName());
     }
+
+    size_t frames = static_cast<size_t>(std::count_if(entries.begin(), entries.end(), [](const SessionJournal::Entry &entry) {
+        return entry.kind == SessionJournal::EntryKind::Frame;
+    }));
+    replayEntries = std::move(entries);
+    replayIndex = 0;
+    replayPaced = paced;
+    replaying = true;
+    replayClock.start();
+
+    // The first entry runs once this command has been reported
+    return QString("Replaying %1 commands and %2 frames from %3%4")
+        .arg(replayEntries.size() - frames).arg(frames).arg(QFileInfo(path).fileName(), paced ? QString(" at the recorded pace") : QString());
 }
 
-QString REPLInterface::getDefaultPickleDirectory() const
+void REPLInterface::scheduleReplay()
 {
-    // First priority: Check for custom data_dir in configuration
-    if (settingsManager && settingsManager->contains("data_dir")) {
-        QString customDir = settingsManager->getString("data_dir");
-        if (!customDir.isEmpty()) {
-            // Test if we can create/access this directory
-            QDir dir(customDir);
-            if (dir.exists() || dir.mkpath(customDir)) {
-                // Test write permissions by creating a temporary test file
-                QString testFile = customDir + "/.write_test";
-                QFile file(testFile);
-                if (file.open(QIODevice::WriteOnly)) {
-                    file.close();
-                    file.remove(); // Clean up test file
-                    return customDir;
-                }
-            }
-            // Custom directory failed, continue to fallbacks
-        }
+    if (replayIndex >= replayEntries.size())
+    {
+        finishReplay(QString("Replayed %1 entries in %2 s").arg(replayEntries.size()).arg(replayClock.elapsed() / 1000.0, 0, 'f', 2));
+        return;
     }
-    
-    // Second priority: Try Documents directory (preferred location)
-    QString documentsPath = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
-    if (!documentsPath.isEmpty()) {
-        QString preferredDir = documentsPath + "/LumosWorkspace";
-        
-        // Test if we can create/access this directory
-        QDir dir(preferredDir);
-        if (dir.exists() || dir.mkpath(preferredDir)) {
-            // Test write permissions by creating a temporary test file
-            QString testFile = preferredDir + "/.write_test";
-            QFile file(testFile);
-            if (file.open(QIODevice::WriteOnly)) {
-                file.close();
-                file.remove(); // Clean up test file
-                return preferredDir;
-            }
-        }
+
+    // At the recorded pace an entry waits for its time after the first one
+    qint64 delay = 0;
+    if (replayPaced)
+    {
+        auto offset = std::chrono::duration_cast<std::chrono::milliseconds>(replayEntries[replayIndex].time - replayEntries.front().time);
+        delay = std::max<qint64>(0, offset.count() - replayClock.elapsed());
     }
-    
-    // Final fallback: /tmp/LumosWorkspace
-    return "/tmp/LumosWorkspace";
+    QTimer::singleShot(delay, this, &REPLInterface::replayNext);
 }
 
-QString REPLInterface::saveVariablesToPickle(const QString& customName, const QString& varName)
+void REPLInterface::replayNext()
 {
-    if (!pythonEngine || !pythonEngine->isInitialized())
+    // Stopped while this step was scheduled
+    if (!replaying || replayIndex >= replayEntries.size())
     {
-        return "Error: Python engine not initialized";
+        return;
     }
 
-    // Get default pickle directory
-    QString pickleDir = getDefaultPickleDirectory();
-    
-    // Ensure directory exists
-    QDir dir(pickleDir);
-    if (!dir.exists()) {
-        if (!dir.mkpath(pickleDir)) {
-            return QString("Error: Could not create directory %1").arg(pickleDir);
-        }
-    }
-    
-    // Determine filename
-    QString filename;
-    if (customName.isEmpty()) {
-        // Use timestamp with variable-specific prefix if saving single variable
-        QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss");
-        if (varName.isEmpty()) {
-            filename = QString("saved_variables_%1.pickle").arg(timestamp);
-        } else {
-            filename = QString("saved_%1_%2.pickle").arg(varName).arg(timestamp);
-        }
-    } else {
-        // Use custom name, ensure .pickle extension
-        filename = customName;
-        if (!filename.endsWith(".pickle")) {
-            filename += ".pickle";
-        }
-    }
-    
-    QString fullPath = pickleDir + "/" + filename;
-    
-    // Execute save operation step by step to avoid compilation issues
-    pythonEngine->evaluateExpression("import pickle, os");
-    pythonEngine->evaluateExpression("globals_snapshot = dict(globals())");
-    
-    QString filterCode;
-    if (varName.isEmpty()) {
-        // Save all user variables
-        filterCode = QString(R"(
-user_vars = {}
-for name, value in globals_snapshot.items():
-    if not name.startswith('__') and name not in ['pickle', 'os', 'user_vars', 'globals_snapshot', 'name', 'value', 'f', 'saved_count', 'result_message']:
-        try:
-            user_vars[name] = value
-        except:
-            pass
-)");
-    } else {
-        // Save only the specified variable
-        filterCode = QString(R"(
-user_vars = {}
-if '%1' in globals_snapshot:
-    try:
-        user_vars['%1'] = globals_snapshot['%1']
-    except:
-        pass
-)").arg(varName);
-    }
-    pythonEngine->evaluateExpression(filterCode.toStdString());
-    
-    QString saveCode;
-    if (varName.isEmpty()) {
-        saveCode = QString(R"(
-try:
-    with open(r'%1', 'wb') as f:
-        pickle.dump(user_vars, f)
-    saved_count = len(user_vars)
-    result_message = f'Saved {saved_count} variables to %2'
-except Exception as e:
-    result_message = f'Error saving variables: {str(e)}'
-)").arg(fullPath).arg(filename);
-    } else {
-        saveCode = QString(R"(
-try:
-    with open(r'%1', 'wb') as f:
-        pickle.dump(user_vars, f)
-    if len(user_vars) > 0:
-        result_message = f'Saved variable "%3" to %2'
-    else:
-        result_message = f'Error: Variable "%3" not found'
-except Exception as e:
-    result_message = f'Error saving variable: {str(e)}'
-)").arg(fullPath).arg(filename).arg(varName);
+    const SessionJournal::Entry &entry = replayEntries[replayIndex++];
+    emit transferStatusChanged(QString("Replaying %1/%2").arg(replayIndex).arg(replayEntries.size()));
+    if (entry.kind == SessionJournal::EntryKind::Command)
+    {
+        runCommand(QString::fromStdString(entry.payload));
+        return;
     }
-    
-    pythonEngine->evaluateExpression(saveCode.toStdString());
-    std::string result = pythonEngine->evaluateExpression("result_message");
-    
-    // Clean up variables that were created during save operation
-    pythonEngine->evaluateExpression(R"(
-try:
-    del pickle, os, user_vars, globals_snapshot, name, value, f, saved_count, result_message
-except:
-    pass
-)");
-    
-    if (result.empty()) {
-        return QString("Variables saved to %1").arg(filename);
+
+    // Frames are bound one at a time, in journal order
+    QJsonObject data = QJsonDocument::fromJson(QByteArray::fromStdString(entry.payload)).object();
+    bool queued = frameInjector && frameInjector(QString::fromStdString(entry.name), data, [this](const QString &error) {
+        QMetaObject::invokeMethod(this, [this, error]() {
+            if (!error.isEmpty())
+            {
+                appendOutput(formatResult(error));
+            }
+            if (replaying)
+            {
+                scheduleReplay();
+            }
+        }, Qt::QueuedConnection);
+    });
+    if (!queued)
+    {
+        finishReplay("Error: Python engine not initialized");
     }
-    
-    return QString::fromStdString(result);
 }
 
-QString REPLInterface::loadVariablesFromPickle(const QString& filename)
+void REPLInterface::finishReplay(const QString &message)
+{
+    replaying = false;
+    replayEntries.clear();
+    replayIndex = 0;
+    emit transferStatusChanged(QString());
+    appendOutput(formatResult(message));
+}
+
+void REPLInterface::setSessionManager(SessionManager *sessionManager)
 {
-    if (!pythonEngine || !pythonEngine->isInitialized())
+    this->sessionManager = sessionManager;
+    if (sessionManager)
     {
-        return "Error: Python engine not initialized";
+        activeSession = QString::fromStdString(sessionManager->getMainSessionName());
     }
+}
 
-    // Get default pickle directory
-    QString pickleDir = getDefaultPickleDirectory();
-    
-    // Determine full file path
-    QString actualFilename = filename;
-    if (!actualFilename.endsWith(".pickle")) {
-        actualFilename += ".pickle";
+QString REPLInterface::listSessions() const
+{
+    if (!sessionManager)
+    {
+        return "Error: Sessions are not available";
     }
-    
-    QString fullPath = pickleDir + "/" + actualFilename;
-    
-    // Create Python code to load variables from pickle
-    QString pythonCode = QString(R"(
-import pickle
-import os
-
-# Check if file exists
-if not os.path.exists(r'%1'):
-    result_message = 'Error: File not found: %2'
-else:
-    try:
-        # Load variables from pickle file
-        with open(r'%1', 'rb') as f:
-            loaded_vars = pickle.load(f)
-        
-        # Add variables to global namespace
-        loaded_count = 0
-        if isinstance(loaded_vars, dict):
-            for var_name, var_value in loaded_vars.items():
-                if not var_name.startswith('__'):
-                    globals()[var_name] = var_value
-                    loaded_count += 1
-            
-            result_message = f'Loaded {loaded_count} variables from %2'
-        else:
-            result_message = 'Error: Pickle file does not contain a dictionary'
-            
-    except Exception as e:
-        result_message = f'Error loading variables: {str(e)}'
-
-print(result_message)
-)").arg(fullPath).arg(actualFilename);
-
-    // Execute the Python code
-    std::string result = pythonEngine->evaluateExpression(pythonCode.toStdString());
-    
-    // Clean up variables that were created during load operation (but keep loaded user variables)
-    pythonEngine->evaluateExpression(R"(
-try:
-    del pickle, os, loaded_vars, loaded_count, var_name, var_value, result_message, f
-except:
-    pass
-)");
-    
-    if (result.empty()) {
-        return QString("Variables loaded from %1").arg(actualFilename);
+
+    QStringList lines;
+    for (const std::string &name : sessionManager->getSessionNames())
+    {
+        QString session = QString::fromStdString(name);
+        lines << (session == activeSession ? "* " : "  ") + session;
     }
-    
-    return QString::fromStdString(result);
+    return lines.join("\n");
 }
 
-QString REPLInterface::listPickleFiles() const
+QString REPLInterface::handleSessionCommand(const QString &arguments)
 {
-    QString pickleDir = getDefaultPickleDirectory();
-    
-    // Check if directory exists
-    QDir dir(pickleDir);
-    if (!dir.exists()) {
-        return QString("No data directory found at: %1").arg(pickleDir);
+    if (!sessionManager)
+    {
+        return "Error: Sessions are not available";
     }
-    
-    // Get all .pickle files in the directory
-    QStringList nameFilters;
-    nameFilters << "*.pickle";
-    QFileInfoList fileList = dir.entryInfoList(nameFilters, QDir::Files, QDir::Time | QDir::Reversed);
-    
-    if (fileList.isEmpty()) {
-        return QString("No pickle files found in: %1").arg(pickleDir);
+    if (!SessionManager::isSupported())
+    {
+        return "Error: Sessions need Python 3.12 or newer";
     }
-    
-    // Format the file list
-    QString result = QString("Pickle files in %1:\n").arg(pickleDir);
-    for (const QFileInfo& fileInfo : fileList) {
-        QString fileName = fileInfo.fileName();
-        QString fileSize;
-        
-        qint64 size = fileInfo.size();
-        if (size < 1024) {
-            fileSize = QString("%1 B").arg(size);
-        } else if (size < 1024 * 1024) {
-            fileSize = QString("%.1f KB").arg(size / 1024.0);
-        } else {
-            fileSize = QString("%.1f MB").arg(size / (1024.0 * 1024.0));
+
+    QStringList parts = arguments.split(' ', Qt::SkipEmptyParts);
+    if (parts.isEmpty() || parts.size() > 2 || (parts.size() == 2 && parts[0] != "close"))
+    {
+        return "Usage: session <name> | session close <name>";
+    }
+
+    QString mainSession = QString::fromStdString(sessionManager->getMainSessionName());
+
+    if (parts.size() == 2)
+    {
+        QString name = parts[1];
+        if (name == mainSession)
+        {
+            return "Error: The main session cannot be closed";
         }
-        
-        QString lastModified = fileInfo.lastModified().toString("yyyy-MM-dd hh:mm:ss");
-        result += QString("  %1 (%2, %3)\n").arg(fileName, fileSize, lastModified);
+        if (name == activeSession)
+        {
+            // Leave the session before its interpreter goes away
+            pythonEngine = sessionManager->getSession(mainSession.toStdString());
+            activeSession = mainSession;
+            emit sessionChanged(activeSession, pythonEngine);
+        }
+        if (!sessionManager->closeSession(name.toStdString()))
+        {
+            return QString("Error: No session named '%1'").arg(name);
+        }
+        return QString("Closed session '%1'").arg(name);
     }
-    
-    return result.trimmed(); // Remove trailing newline
+
+    QString name = parts[0];
+    bool existed = sessionManager->getSession(name.toStdString()) != nullptr;
+    PythonEngine *session = sessionManager->createSession(name.toStdString());
+    if (!session)
+    {
+        return QString("Error: Failed to start session '%1'").arg(name);
+    }
+
+    pythonEngine = session;
+    activeSession = name;
+    emit sessionChanged(activeSession, pythonEngine);
+
+    return QString(existed ? "Switched to session '%1'" : "Started session '%1'").arg(name);
+}
+
+void REPLInterface::clearVariables(const QString &command)
+{
+    // One queued job behind the running command, so the GUI does not wait
+    bool queued = pythonEngine && pythonEngine->isInitialized() &&
+                  pythonEngine->clearUserVariables([this, command]() {
+                      QMetaObject::invokeMethod(this, [this, command]() {
+                          emit commandExecuted(command, "Variables cleared");
+                      }, Qt::QueuedConnection);
+                  });
+    if (!queued)
+    {
+        emit commandExecuted(command, "Variables cleared");
+    }
+}
+
+void REPLInterface::loadVariables(const QString &command, const QString &filename)
+{
+    emit transferStatusChanged("Loading...");
+    WorkspaceFiles::load(pythonEngine, WorkspaceFiles::defaultDirectory(settingsManager), filename,
+                         transferProgress("Loading"), transferFinished(command));
+}
+
+PythonEngine::TransferProgress REPLInterface::transferProgress(const QString &action)
+{
+    // Progress arrives on the transfer thread; hop to the GUI thread before emitting
+    return [this, action](uint64_t bytes, uint64_t totalBytes) {
+        QString status = WorkspaceFiles::formatProgress(action, bytes, totalBytes);
+        QMetaObject::invokeMethod(this, [this, status]() {
+            emit transferStatusChanged(status);
+        }, Qt::QueuedConnection);
+    };
+}
+
+WorkspaceFiles::Finished REPLInterface::transferFinished(const QString &command)
+{
+    // Commands typed meanwhile have printed their own output; the result goes below them
+    return [this, command](const QString &message) {
+        QMetaObject::invokeMethod(this, [this, command, message]() {
+            emit transferStatusChanged(QString());
+            appendOutput(formatResult(message));
+            emit commandExecuted(command, message);
+        }, Qt::QueuedConnection);
+    };
 }
 
 void REPLInterface::startFilePicker()
 {
-    QString pickleDir = getDefaultPickleDirectory();
+    QString pickleDir = WorkspaceFiles::defaultDirectory(settingsManager);
     QDir dir(pickleDir);
     
     if (!dir.exists()) {
@@ -626,18 +713,10 @@ void REPLInterface::startFilePicker()
         return;
     }
     
-    // Get all .pickle files
-    QStringList nameFilters;
-    nameFilters << "*.pickle";
-    QFileInfoList fileInfoList = dir.entryInfoList(nameFilters, QDir::Files, QDir::Time | QDir::Reversed);
-    
-    availableFiles.clear();
-    for (const QFileInfo& info : fileInfoList) {
-        availableFiles.append(info.fileName());
-    }
+    availableFiles = WorkspaceFiles::listFiles(pickleDir);
     
     if (availableFiles.isEmpty()) {
-        QString error = QString("No pickle files found in: %1").arg(pickleDir);
+        QString error = QString("No workspace files found in: %1").arg(pickleDir);
         appendOutput(formatResult(error));
         return;
     }
@@ -724,10 +803,11 @@ void REPLInterface::confirmFileSelection()
     // Exit file picker mode
     cancelFilePicker();
     
-    // Load the selected file
-    QString result = loadVariablesFromPickle(selectedFile);
-    appendOutput(formatResult(result));
-    emit commandExecuted("load", result);
+    // Load the selected file; a replay loads the same one
+    if (sessionJournal) {
+        sessionJournal->recordCommand(QString("load %1").arg(selectedFile).toStdString());
+    }
+    loadVariables("load", selectedFile);
 }
 
 void REPLInterface::cancelFilePicker()
@@ -767,22 +847,40 @@ LumosWorkspace REPL - Help & Commands
   Enter               - Execute command
   Shift+Enter         - Multi-line input (new line)
   Up/Down arrows      - Navigate command history
+  Ctrl+C              - Interrupt the running command (KeyboardInterrupt)
   
 🔧 SPECIAL COMMANDS:
   help                - Show this help message
   clear               - Clear REPL output (keep variables)
   clear vars          - Clear all Python variables from memory
   
+🧵 SESSIONS:
+  sessions            - List sessions (* marks the active one)
+  session <name>      - Switch to a session, starting it if needed
+                       Each session has its own variables and runs
+                       in parallel with the others
+  session close <name> - Stop a session and drop its variables
+  
 💾 VARIABLE PERSISTENCE:
   save [name]         - Save all variables to pickle file
                        'save' → saved_variables_TIMESTAMP.pickle
                        'save my_data' → my_data.pickle
+                       'save my_data.lumos' → numeric arrays only,
+                       loaded as views of the file without copying
                        
   load [filename]     - Load variables from pickle file
                        'load' → interactive file picker with ↑↓ navigation
                        'load my_data' → loads my_data.pickle directly
                        
-  ls                  - List all pickle files in data directory
+  restore             - Restore the variables of the previous session
+                       from its last automatic checkpoint
+                       
+  replay [paced] [journal] - Run the commands and injected frames of a
+                       session journal again, by default the previous
+                       session's; 'paced' keeps the recorded timing.
+                       Sessions are journaled when journal.enabled is set
+                       
+  ls                  - List all workspace files in data directory
                        Shows filename, size, and modification date
   
 📝 EXAMPLES:
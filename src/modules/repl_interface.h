@@ -9,9 +9,17 @@
 #include <QStringList>
 #include <QKeyEvent>
 #include <QStandardPaths>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <functional>
+#include <vector>
 #include "python_engine.h"
+#include "workspace_files.h"
+#include "session_journal.h"
 
 class SettingsManager;
+class SessionManager;
 
 class REPLInterface : public QWidget {
     Q_OBJECT
@@ -23,32 +31,66 @@ public:
     void focusInput();
     void clearOutput();
     void appendOutput(const QString& text);
+    
+    // Enables the 'sessions' and 'session <name>' commands
+    void setSessionManager(SessionManager* sessionManager);
+    QString getActiveSession() const { return activeSession; }
+    
+    // Commands are recorded in `journal`; 'replay' runs a journal's commands
+    // again and hands its frames to `injector`, which calls back when the
+    // frame is bound (on any thread, with an empty string on success)
+    using FrameInjector = std::function<bool(const QString& name, const QJsonObject& data,
+                                             std::function<void(const QString& error)> onFinished)>;
+    void setSessionJournal(SessionJournal* journal);
+    void setFrameInjector(FrameInjector injector);
 
 signals:
     void commandExecuted(const QString& command, const QString& result);
     void layoutModeChangeRequested(const QString& mode);
+    
+    // Emitted from the interpreter thread; connected queued to onCommandFinished
+    void commandFinished(const QString& command, const QString& result);
+    
+    // Progress of a running save or load; empty once it is done
+    void transferStatusChanged(const QString& status);
+    
+    // The REPL now runs commands in another session
+    void sessionChanged(const QString& name, PythonEngine* engine);
 
 protected:
     bool eventFilter(QObject* obj, QEvent* event) override;
 
 private slots:
     void executeCommand();
+    void onCommandFinished(const QString& command, const QString& result);
+    void drainStreamedOutput();
+    void replayNext();
 
 private:
     void setupUI();
     void setupConnections();
     void setupEventFilters();
     bool handleKeyPress(QKeyEvent* keyEvent);
+    bool isInterruptKey(QKeyEvent* keyEvent) const;
+    void interruptCommand();
+    void runCommand(const QString& command);
+    void appendStreamedOutput(size_t maxBytes);
     void addToHistory(const QString& command);
     void navigateHistory(int direction);
     bool handleSpecialCommand(const QString& command);
-    void clearVariables();
-    QString saveVariablesToPickle(const QString& customName = "", const QString& varName = "");
-    QString loadVariablesFromPickle(const QString& filename);
-    QString listPickleFiles() const;
-    QString getDefaultPickleDirectory() const;
+    QString handleSessionCommand(const QString& command);
+    QString listSessions() const;
+    void clearVariables(const QString &command);
+    void loadVariables(const QString& command, const QString& filename);
+    PythonEngine::TransferProgress transferProgress(const QString& action);
+    WorkspaceFiles::Finished transferFinished(const QString& command);
     QString getHelpText() const;
     
+    // Replay of a session journal, one entry at a time
+    QString startReplay(QStringList arguments);
+    void scheduleReplay();
+    void finishReplay(const QString& message);
+    
     // File picker methods
     void startFilePicker();
     void updateFilePickerDisplay();
@@ -60,6 +102,8 @@ private:
     
     PythonEngine* pythonEngine;
     SettingsManager* settingsManager;
+    SessionManager* sessionManager;
+    QString activeSession;
     
     // UI Components
     QVBoxLayout* mainLayout;
@@ -74,6 +118,20 @@ private:
     int historyIndex;
     bool executingCommand;
     
+    // Output streamed from the running command, drained once per frame
+    QTimer* outputTimer;
+    std::string outputChunk;
+    QString partialOutputLine;
+    
+    // Session journal and the replay in progress
+    SessionJournal* sessionJournal;
+    FrameInjector frameInjector;
+    std::vector<SessionJournal::Entry> replayEntries;
+    size_t replayIndex;
+    bool replaying;
+    bool replayPaced;
+    QElapsedTimer replayClock;
+    
     // File picker state
     bool filePickerMode;
     QStringList availableFiles;
@@ -0,0 +1,205 @@
+#include "session_journal.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+const char fileMagic[8] = {'L', 'U', 'M', 'O', 'S', 'J', 'N', 'L'};
+const uint32_t byteOrderMark = 0x01020304;
+const uint32_t fileVersion = 1;
+
+// Past this much unwritten data, say behind a stalled disk, entries are dropped
+const size_t maxQueuedBytes = size_t(256) << 20;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t version;
+    int64_t openedAt;
+};
+
+struct EntryHeader {
+    uint8_t kind;
+    uint8_t reserved;
+    uint16_t nameLength;
+    uint32_t payloadLength;
+    int64_t time;
+};
+static_assert(sizeof(EntryHeader) == 16, "entries start with a fixed 16-byte header");
+
+}  // namespace
+
+SessionJournal::~SessionJournal() {
+    close();
+}
+
+bool SessionJournal::open(const std::string& path, uint64_t maxFileBytes, std::string& error) {
+    close();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    
+    FileHeader header = {};
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.byteOrder = byteOrderMark;
+    header.version = fileVersion;
+    header.openedAt = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1 || std::fflush(file) != 0) {
+        error = path + ": " + std::strerror(errno);
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+    
+    openedAt = std::chrono::steady_clock::now();
+    stopping = false;
+    dropped = 0;
+    queuedBytes = 0;
+    fileBytes = sizeof(header);
+    this->maxFileBytes = maxFileBytes;
+    writerRunning = true;
+    writerThread = std::thread(&SessionJournal::writerLoop, this);
+    return true;
+}
+
+void SessionJournal::close() {
+    if (!writerThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueReady.notify_one();
+    writerThread.join();
+    std::fclose(file);
+    file = nullptr;
+}
+
+void SessionJournal::recordCommand(const std::string& command) {
+    record({EntryKind::Command, std::chrono::steady_clock::now(), std::string(), command, nullptr,
+            sizeof(PendingEntry) + command.size()});
+}
+
+void SessionJournal::recordFrame(const std::string& name, Encoder encodeData, size_t dataBytes,
+                                 std::chrono::steady_clock::time_point received) {
+    record({EntryKind::Frame, received, name, std::string(), std::move(encodeData),
+            sizeof(PendingEntry) + name.size() + dataBytes});
+}
+
+void SessionJournal::record(PendingEntry entry) {
+    if (!writerRunning) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (queuedBytes + entry.bytes > maxQueuedBytes) {
+            ++dropped;
+            return;
+        }
+        queuedBytes += entry.bytes;
+        queue.push_back(std::move(entry));
+    }
+    queueReady.notify_one();
+}
+
+bool SessionJournal::write(const PendingEntry& entry) {
+    std::string payload = entry.encodePayload ? entry.encodePayload() : entry.payload;
+    if (entry.name.size() > UINT16_MAX || payload.size() > UINT32_MAX) {
+        ++dropped;
+        return true;
+    }
+    
+    // A journal at its size limit takes nothing more
+    uint64_t entryBytes = sizeof(EntryHeader) + entry.name.size() + payload.size();
+    if (fileBytes + entryBytes > maxFileBytes) {
+        ++dropped;
+        return false;
+    }
+    fileBytes += entryBytes;
+    
+    EntryHeader header = {};
+    header.kind = static_cast<uint8_t>(entry.kind);
+    header.nameLength = static_cast<uint16_t>(entry.name.size());
+    header.payloadLength = static_cast<uint32_t>(payload.size());
+    header.time = std::chrono::duration_cast<std::chrono::nanoseconds>(entry.time - openedAt).count();
+    return std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+           std::fwrite(entry.name.data(), 1, entry.name.size(), file) == entry.name.size() &&
+           std::fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+}
+
+void SessionJournal::writerLoop() {
+    std::vector<PendingEntry> pending;
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while (true) {
+        queueReady.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            break;
+        }
+        pending.swap(queue);
+        lock.unlock();
+        
+        // Flushed per batch, so what was recorded survives a crash of the app
+        bool written = true;
+        size_t batchBytes = 0;
+        for (const PendingEntry& entry : pending) {
+            written = written && write(entry);
+            batchBytes += entry.bytes;
+        }
+        written = std::fflush(file) == 0 && written;
+        pending.clear();
+        
+        lock.lock();
+        queuedBytes -= batchBytes;
+        if (!written) {
+            break;
+        }
+    }
+    // Nothing more is recorded after a write error or once the file is full
+    writerRunning = false;
+}
+
+bool SessionJournal::read(const std::string& path, std::vector<Entry>& entries, std::string& error) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    
+    FileHeader header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0 ||
+        header.byteOrder != byteOrderMark || header.version != fileVersion) {
+        std::fclose(file);
+        error = path + " is not a session journal";
+        return false;
+    }
+    
+    EntryHeader entryHeader;
+    while (std::fread(&entryHeader, sizeof(entryHeader), 1, file) == 1) {
+        if (entryHeader.kind != static_cast<uint8_t>(EntryKind::Command) &&
+            entryHeader.kind != static_cast<uint8_t>(EntryKind::Frame)) {
+            break;
+        }
+        Entry entry;
+        entry.kind = static_cast<EntryKind>(entryHeader.kind);
+        entry.time = std::chrono::nanoseconds(entryHeader.time);
+        entry.name.resize(entryHeader.nameLength);
+        entry.payload.resize(entryHeader.payloadLength);
+        if (std::fread(&entry.name[0], 1, entry.name.size(), file) != entry.name.size() ||
+            std::fread(&entry.payload[0], 1, entry.payload.size(), file) != entry.payload.size()) {
+            break;
+        }
+        entries.push_back(std::move(entry));
+    }
+    std::fclose(file);
+    
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.time < b.time;
+    });
+    return true;
+}
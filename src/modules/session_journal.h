@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Append-only log of a session: the commands run in the REPL and the frames
+// injected over TCP, each with its time since the journal was opened, for
+// replaying the session later. Recording only queues the entry; a writer
+// thread encodes it and puts it on disk, so callers on the GUI thread and on
+// ingest threads never wait for the file.
+//
+// Layout, native byte order:
+//   header   magic "LUMOSJNL", byte order mark, version, wall-clock time
+//            the journal was opened (ns since the Unix epoch)
+//   entries  kind, name length, payload length, time (ns since opening),
+//            then the name (the variable a frame binds) and the payload
+//            (the command text, or the frame's data as compact JSON)
+class SessionJournal {
+public:
+    enum class EntryKind : uint8_t { Command = 1, Frame = 2 };
+
+    struct Entry {
+        EntryKind kind = EntryKind::Command;
+        std::chrono::nanoseconds time{0};
+        std::string name;
+        std::string payload;
+    };
+
+    SessionJournal() = default;
+    ~SessionJournal();
+    SessionJournal(const SessionJournal&) = delete;
+    SessionJournal& operator=(const SessionJournal&) = delete;
+
+    // Start a new journal at `path`, replacing any file there. Recording
+    // stops once the file would grow past `maxFileBytes`.
+    bool open(const std::string& path, uint64_t maxFileBytes, std::string& error);
+    // Write what is buffered and stop the writer thread
+    void close();
+    bool isOpen() const { return writerRunning; }
+
+    // Thread-safe and non-blocking. A frame's data is encoded by `encodeData`
+    // on the writer thread, so it must own what it encodes; `dataBytes` is
+    // about what that holds. Entries that would take the unwritten ones past
+    // the queue's byte budget are dropped and counted rather than holding up
+    // the caller.
+    using Encoder = std::function<std::string()>;
+    void recordCommand(const std::string& command);
+    void recordFrame(const std::string& name, Encoder encodeData, size_t dataBytes,
+                     std::chrono::steady_clock::time_point received);
+    uint64_t droppedEntries() const { return dropped; }
+
+    // The entries of the journal at `path` in time order: commands are timed
+    // when submitted and frames when received, but a frame is only written
+    // once bound, so the file may hold them out of order. An entry cut short
+    // at the end, say by a crash, ends the journal rather than failing it.
+    static bool read(const std::string& path, std::vector<Entry>& entries, std::string& error);
+
+private:
+    struct PendingEntry {
+        EntryKind kind;
+        std::chrono::steady_clock::time_point time;
+        std::string name;
+        std::string payload;
+        Encoder encodePayload;   // Set instead of `payload` for frames
+        size_t bytes;            // Held until written, for the queue's budget
+    };
+    void record(PendingEntry entry);
+    bool write(const PendingEntry& entry);
+    void writerLoop();
+
+    std::FILE* file = nullptr;
+    std::chrono::steady_clock::time_point openedAt;
+    std::thread writerThread;
+    std::atomic<bool> writerRunning{false};
+    std::atomic<uint64_t> dropped{0};
+    uint64_t fileBytes = 0;
+    uint64_t maxFileBytes = 0;
+
+    // Entries waiting for the writer; swapped out whole
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::vector<PendingEntry> queue;
+    size_t queuedBytes = 0;   // Of entries not written yet, queued or in the writer's batch
+    bool stopping = false;
+};
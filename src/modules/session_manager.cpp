@@ -0,0 +1,75 @@
+#include "session_manager.h"
+#include "python_engine.h"
+#include <iostream>
+
+SessionManager::SessionManager(PythonEngine* mainEngine, const std::string& mainName)
+    : mainEngine(mainEngine), mainName(mainName) {
+}
+
+SessionManager::~SessionManager() {
+    closeAll();
+}
+
+bool SessionManager::isSupported() {
+    return PythonEngine::subinterpretersSupported();
+}
+
+PythonEngine* SessionManager::createSession(const std::string& name) {
+    if (PythonEngine* existing = getSession(name)) {
+        return existing;
+    }
+    
+    if (name.empty() || !mainEngine || !mainEngine->isInitialized()) {
+        return nullptr;
+    }
+    
+    auto engine = std::make_unique<PythonEngine>(PythonEngine::InterpreterKind::Subinterpreter);
+    if (!engine->initialize()) {
+        std::cerr << "Failed to start session '" << name << "'" << std::endl;
+        return nullptr;
+    }
+    
+    PythonEngine* session = engine.get();
+    sessions.emplace_back(name, std::move(engine));
+    return session;
+}
+
+bool SessionManager::closeSession(const std::string& name) {
+    for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+        if (it->first == name) {
+            it->second->finalize();
+            sessions.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void SessionManager::closeAll() {
+    // Sub-interpreters have to be gone before the main interpreter finalizes
+    for (auto& session : sessions) {
+        session.second->finalize();
+    }
+    sessions.clear();
+}
+
+PythonEngine* SessionManager::getSession(const std::string& name) const {
+    if (name == mainName) {
+        return mainEngine;
+    }
+    for (const auto& session : sessions) {
+        if (session.first == name) {
+            return session.second.get();
+        }
+    }
+    return nullptr;
+}
+
+std::vector<std::string> SessionManager::getSessionNames() const {
+    std::vector<std::string> names;
+    names.push_back(mainName);
+    for (const auto& session : sessions) {
+        names.push_back(session.first);
+    }
+    return names;
+}
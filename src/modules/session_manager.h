@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class PythonEngine;
+
+// Named Python sessions. The main session is the application's engine; every
+// other session is a sub-interpreter with its own GIL, namespace and thread,
+// so commands in different sessions run in parallel.
+class SessionManager {
+public:
+    explicit SessionManager(PythonEngine* mainEngine, const std::string& mainName = "main");
+    ~SessionManager();
+
+    // Returns the existing session of that name or starts a new one;
+    // nullptr when sub-interpreters are unavailable
+    PythonEngine* createSession(const std::string& name);
+    bool closeSession(const std::string& name);
+    void closeAll();
+
+    PythonEngine* getSession(const std::string& name) const;
+    std::vector<std::string> getSessionNames() const;
+    const std::string& getMainSessionName() const { return mainName; }
+
+    static bool isSupported();
+
+private:
+    PythonEngine* mainEngine;
+    std::string mainName;
+    std::vector<std::pair<std::string, std::unique_ptr<PythonEngine>>> sessions;
+};
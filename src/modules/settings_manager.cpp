@@ -31,7 +31,19 @@ void SettingsManager::setDefaults() {
         {"ui.background_color", "#2b2b2b"},
         {"ui.text_color", "#ffffff"},
         {"ui.border_color", "#555555"},
-        {"tcp.port", 8080}
+        {"tcp.port", 8080},
+        {"python.command_timeout", 0},
+        {"python.import_site", true},
+        {"python.trace_imports", false},
+        {"python.extra_paths", QJsonArray{}},
+        {"python.warmup_modules", QJsonArray{}},
+        {"python.warmup_scripts", QJsonArray{}},
+        {"repl.output_overflow", "elide"},
+        {"repl.max_output_lines", 20000},
+        {"checkpoint.interval_seconds", 60},
+        {"checkpoint.max_mb", 512},
+        {"journal.enabled", false},
+        {"journal.max_mb", 256}
     };
 }
 
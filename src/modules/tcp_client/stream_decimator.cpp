@@ -0,0 +1,202 @@
+#include "stream_decimator.h"
+#include <algorithm>
+
+DecimationPolicy DecimationPolicy::none() {
+    return DecimationPolicy();
+}
+
+DecimationPolicy DecimationPolicy::everyNth(size_t n) {
+    DecimationPolicy policy;
+    policy.mode = Mode::EveryNth;
+    policy.factor = std::max<size_t>(n, 1);
+    return policy;
+}
+
+DecimationPolicy DecimationPolicy::latestOnly(std::chrono::steady_clock::duration interval) {
+    DecimationPolicy policy;
+    policy.mode = Mode::LatestOnly;
+    policy.min_interval = interval;
+    return policy;
+}
+
+DecimationPolicy DecimationPolicy::minMax(size_t window) {
+    DecimationPolicy policy;
+    policy.mode = Mode::MinMax;
+    policy.factor = std::max<size_t>(window, 1);
+    return policy;
+}
+
+StreamDecimator::StreamDecimator(const DecimationPolicy& policy)
+    : policy(policy), phase(0), has_sent(false), has_pending(false), held_frame(false) {
+    this->policy.factor = std::max<size_t>(policy.factor, 1);
+}
+
+void StreamDecimator::setPolicy(const DecimationPolicy& policy) {
+    this->policy = policy;
+    this->policy.factor = std::max<size_t>(policy.factor, 1);
+    reset();
+}
+
+void StreamDecimator::reset() {
+    phase = 0;
+    has_sent = false;
+    has_pending = false;
+    held_frame = false;
+    pending.clear();
+}
+
+std::chrono::steady_clock::time_point StreamDecimator::heldDeadline() const {
+    if (policy.mode != DecimationPolicy::Mode::LatestOnly || !isHolding()) {
+        return std::chrono::steady_clock::time_point::max();
+    }
+    return last_sent + policy.min_interval;
+}
+
+void StreamDecimator::markReleased(std::chrono::steady_clock::time_point now) {
+    last_sent = now;
+    has_sent = true;
+}
+
+bool StreamDecimator::intervalElapsed(std::chrono::steady_clock::time_point now) const {
+    return !has_sent || now - last_sent >= policy.min_interval;
+}
+
+bool StreamDecimator::processSamples(const int* data, size_t count, std::chrono::steady_clock::time_point now, std::vector<int>& out) {
+    out.clear();
+    
+    switch (policy.mode) {
+    case DecimationPolicy::Mode::None:
+        out.assign(data, data + count);
+        return true;
+        
+    case DecimationPolicy::Mode::EveryNth: {
+        // Keep the sample positions that continue the stride across frame boundaries
+        size_t factor = policy.factor;
+        size_t first = (factor - phase) % factor;
+        if (first < count) {
+            out.reserve((count - first + factor - 1) / factor);
+            for (size_t i = first; i < count; i += factor) {
+                out.push_back(data[i]);
+            }
+        }
+        phase = (phase + count) % factor;
+        return !out.empty();
+    }
+        
+    case DecimationPolicy::Mode::LatestOnly:
+        if (intervalElapsed(now)) {
+            out.assign(data, data + count);
+            last_sent = now;
+            has_sent = true;
+            has_pending = false;
+            pending.clear();
+            return true;
+        }
+        // Too soon: remember only the newest frame
+        pending.assign(data, data + count);
+        has_pending = true;
+        return false;
+        
+    case DecimationPolicy::Mode::MinMax: {
+        size_t window = policy.factor;
+        size_t i = 0;
+        
+        // Complete the window left over from the previous frame
+        if (!pending.empty()) {
+            size_t take = std::min(window - pending.size(), count);
+            pending.insert(pending.end(), data, data + take);
+            i = take;
+            if (pending.size() < window) {
+                return false;
+            }
+            reduceWindow(pending.data(), pending.size(), out);
+            pending.clear();
+        }
+        
+        for (; i + window <= count; i += window) {
+            reduceWindow(data + i, window, out);
+        }
+        pending.assign(data + i, data + count);
+        return !out.empty();
+    }
+    }
+    
+    return false;
+}
+
+void StreamDecimator::reduceWindow(const int* window, size_t count, std::vector<int>& out) const {
+    if (count == 0) {
+        return;
+    }
+    
+    // Branch-free reduction over a contiguous block, which the compiler vectorizes
+    int lo = window[0];
+    int hi = window[0];
+    for (size_t i = 1; i < count; ++i) {
+        lo = std::min(lo, window[i]);
+        hi = std::max(hi, window[i]);
+    }
+    
+    if (lo == hi) {
+        out.push_back(lo);
+        return;
+    }
+    
+    // Emit both extremes in the order they occurred so plots keep their shape
+    const int* first_lo = std::find(window, window + count, lo);
+    const int* first_hi = std::find(window, window + count, hi);
+    if (first_lo < first_hi) {
+        out.push_back(lo);
+        out.push_back(hi);
+    } else {
+        out.push_back(hi);
+        out.push_back(lo);
+    }
+}
+
+StreamDecimator::FrameDecision StreamDecimator::admitFrame(std::chrono::steady_clock::time_point now) {
+    switch (policy.mode) {
+    case DecimationPolicy::Mode::EveryNth: {
+        bool keep = phase == 0;
+        phase = (phase + 1) % policy.factor;
+        return keep ? FrameDecision::Send : FrameDecision::Drop;
+    }
+        
+    case DecimationPolicy::Mode::LatestOnly:
+        if (intervalElapsed(now)) {
+            last_sent = now;
+            has_sent = true;
+            held_frame = false;
+            return FrameDecision::Send;
+        }
+        held_frame = true;
+        return FrameDecision::Hold;
+        
+    case DecimationPolicy::Mode::None:
+    case DecimationPolicy::Mode::MinMax:
+        // Min/max has no meaning for opaque payloads
+        return FrameDecision::Send;
+    }
+    
+    return FrameDecision::Send;
+}
+
+bool StreamDecimator::flushSamples(std::vector<int>& out) {
+    out.clear();
+    held_frame = false;
+    
+    if (policy.mode == DecimationPolicy::Mode::LatestOnly && has_pending) {
+        out.swap(pending);
+        pending.clear();
+        has_pending = false;
+        return true;
+    }
+    
+    if (policy.mode == DecimationPolicy::Mode::MinMax && !pending.empty()) {
+        reduceWindow(pending.data(), pending.size(), out);
+        pending.clear();
+        return true;
+    }
+    
+    return false;
+}
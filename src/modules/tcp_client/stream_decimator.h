@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// Client-side reduction applied to a stream before its frames are serialized
+struct DecimationPolicy {
+    enum class Mode {
+        None,        // Send everything
+        EveryNth,    // Keep one sample (or frame, for non-numeric streams) in N
+        LatestOnly,  // Send at most one frame per interval, always the newest; a held
+                     // frame is due when its interval ends, see heldDeadline()
+        MinMax       // Replace each window of N samples by its min and max, in order
+    };
+
+    Mode mode = Mode::None;
+    size_t factor = 1;
+    std::chrono::steady_clock::duration min_interval = std::chrono::steady_clock::duration::zero();
+
+    static DecimationPolicy none();
+    static DecimationPolicy everyNth(size_t n);
+    static DecimationPolicy latestOnly(std::chrono::steady_clock::duration interval);
+    static DecimationPolicy minMax(size_t window);
+};
+
+class StreamDecimator {
+public:
+    enum class FrameDecision { Send, Hold, Drop };
+
+    explicit StreamDecimator(const DecimationPolicy& policy = DecimationPolicy::none());
+
+    const DecimationPolicy& getPolicy() const { return policy; }
+    void setPolicy(const DecimationPolicy& policy);
+
+    // Numeric path: reduce one frame of samples. Returns true when `out` holds samples to send now.
+    bool processSamples(const int* data, size_t count, std::chrono::steady_clock::time_point now, std::vector<int>& out);
+
+    // Frame path for payloads that cannot be reduced sample by sample
+    FrameDecision admitFrame(std::chrono::steady_clock::time_point now);
+
+    // Hand out samples still held back (latest frame or partial min/max window)
+    bool flushSamples(std::vector<int>& out);
+
+    // LatestOnly: when the frame held back is due to be sent without waiting
+    // for a newer one, or time_point::max() if nothing is held. Call
+    // markReleased() when sending it so the next interval starts.
+    bool isHolding() const { return has_pending || held_frame; }
+    std::chrono::steady_clock::time_point heldDeadline() const;
+    void markReleased(std::chrono::steady_clock::time_point now);
+
+    void reset();
+
+private:
+    bool intervalElapsed(std::chrono::steady_clock::time_point now) const;
+    void reduceWindow(const int* window, size_t count, std::vector<int>& out) const;
+
+    DecimationPolicy policy;
+    size_t phase;                                      // Samples or frames seen modulo factor
+    bool has_sent;
+    bool has_pending;
+    bool held_frame;                                   // A frame path payload was held
+    std::chrono::steady_clock::time_point last_sent;
+    std::vector<int> pending;                          // Held frame or partial window
+};
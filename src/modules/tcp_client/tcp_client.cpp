@@ -1,18 +1,37 @@
 #include "tcp_client.h"
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstring>
 #include <iostream>
 #include <vector>
-#include <sstream>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <limits>
+#include <nlohmann/json.hpp>
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
 
 TCPClient::TCPClient(const std::string& host, int port) 
-    : host(host), port(port), socket_fd(-1), connected(false) {
+    : host(host), port(port), socket_fd(-1), connected(false), release_stopping(false) {
 }
 
 TCPClient::~TCPClient() {
+    if (release_thread.joinable()) {
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+            release_stopping = true;
+        }
+        release_wake.notify_one();
+        release_thread.join();
+    }
     disconnect();
 }
 
@@ -31,9 +50,15 @@ void TCPClient::closeSocket() {
         socket_fd = -1;
     }
     connected = false;
+    
+    // Interned stream ids only live as long as the server side connection
+    for (Stream& stream : streams) {
+        stream.interned = false;
+    }
 }
 
 bool TCPClient::connect() {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     if (connected) {
         return true;
     }
@@ -64,48 +89,96 @@ bool TCPClient::connect() {
 }
 
 void TCPClient::disconnect() {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     closeSocket();
 }
 
 bool TCPClient::isConnected() const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     return connected;
 }
 
 bool TCPClient::sendMessage(const std::string& header, const std::string& payload) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return sendFrame(static_cast<uint32_t>(header.size()), header, payload);
+}
+
+bool TCPClient::sendFrame(uint32_t header_field, const std::string& header, const std::string& payload) {
     if (!connected) {
         std::cerr << "Not connected to server" << std::endl;
         return false;
     }
     
-    // Send header size (network byte order)
-    uint32_t header_size = htonl(header.size());
-    if (send(socket_fd, &header_size, sizeof(header_size), 0) < 0) {
-        std::cerr << "Failed to send header size" << std::endl;
-        return false;
-    }
+    // Header size (or interned stream id), header, payload size and payload in one syscall
+    uint32_t header_field_net = htonl(header_field);
+    uint32_t payload_size = htonl(payload.size());
     
-    // Send header
-    if (send(socket_fd, header.c_str(), header.size(), 0) < 0) {
-        std::cerr << "Failed to send header" << std::endl;
-        return false;
-    }
+    struct iovec iov[4];
+    iov[0].iov_base = &header_field_net;
+    iov[0].iov_len = sizeof(header_field_net);
+    iov[1].iov_base = const_cast<char*>(header.data());
+    iov[1].iov_len = header.size();
+    iov[2].iov_base = &payload_size;
+    iov[2].iov_len = sizeof(payload_size);
+    iov[3].iov_base = const_cast<char*>(payload.data());
+    iov[3].iov_len = payload.size();
     
-    // Send payload size (network byte order)
-    uint32_t payload_size = htonl(payload.size());
-    if (send(socket_fd, &payload_size, sizeof(payload_size), 0) < 0) {
-        std::cerr << "Failed to send payload size" << std::endl;
-        return false;
-    }
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 4;
     
-    // Send payload
-    if (send(socket_fd, payload.c_str(), payload.size(), 0) < 0) {
-        std::cerr << "Failed to send payload" << std::endl;
-        return false;
+    // Large payloads may be written partially, continue where the kernel stopped
+    while (msg.msg_iovlen > 0) {
+        ssize_t sent = sendmsg(socket_fd, &msg, SEND_FLAGS);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Failed to send message" << std::endl;
+            return false;
+        }
+        
+        size_t remaining = static_cast<size_t>(sent);
+        while (msg.msg_iovlen > 0 && remaining >= msg.msg_iov->iov_len) {
+            remaining -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = static_cast<char*>(msg.msg_iov->iov_base) + remaining;
+            msg.msg_iov->iov_len -= remaining;
+        }
     }
     
     return true;
 }
 
+std::string TCPClient::formatIntList(const std::vector<int>& data) {
+    // Up to 11 characters per int plus the ", " separator
+    std::string payload;
+    payload.resize(2 + data.size() * 13);
+    
+    char* out = &payload[0];
+    char* end = out + payload.size();
+    *out++ = '[';
+    for (size_t i = 0; i < data.size(); ++i) {
+        if (i > 0) {
+            *out++ = ',';
+            *out++ = ' ';
+        }
+        out = std::to_chars(out, end, data[i]).ptr;
+    }
+    *out++ = ']';
+    
+    payload.resize(out - payload.data());
+    return payload;
+}
+
+std::string TCPClient::quoteJson(const std::string& text) {
+    // Quotes, backslashes and control characters escaped; invalid UTF-8 is
+    // replaced rather than failing the frame
+    return nlohmann::json(text).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
 bool TCPClient::sendIntList(const std::vector<int>& data, const std::string& name) {
     std::string header;
     if (name.empty()) {
@@ -114,15 +187,7 @@ bool TCPClient::sendIntList(const std::vector<int>& data, const std::string& nam
         header = "{\"type\": \"int_list\", \"name\": \"" + name + "\"}";
     }
     
-    std::ostringstream payload_stream;
-    payload_stream << "[";
-    for (size_t i = 0; i < data.size(); ++i) {
-        if (i > 0) payload_stream << ", ";
-        payload_stream << data[i];
-    }
-    payload_stream << "]";
-    
-    return sendMessage(header, payload_stream.str());
+    return sendMessage(header, formatIntList(data));
 }
 
 bool TCPClient::sendString(const std::string& data, const std::string& name) {
@@ -141,6 +206,186 @@ bool TCPClient::sendRawData(const std::string& header_json, const std::string& p
     return sendMessage(header_json, payload);
 }
 
+TCPClient::StreamId TCPClient::openStream(const std::string& name, const std::string& type) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    StreamId id = static_cast<StreamId>(streams.size());
+    
+    Stream stream;
+    stream.name = name;
+    stream.type = type;
+    stream.interned = false;
+    stream.has_held_payload = false;
+    stream.header = "{\"type\": " + quoteJson(type);
+    if (!name.empty()) {
+        stream.header += ", \"name\": " + quoteJson(name);
+    }
+    stream.header += ", \"stream_id\": " + std::to_string(id) + "}";
+    
+    streams.push_back(stream);
+    return id;
+}
+
+std::string TCPClient::getStreamHeader(StreamId stream) const {
+    // A copy, since openStream() may move the streams once the lock is gone
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return stream < streams.size() ? streams[stream].header : std::string();
+}
+
+bool TCPClient::sendStreamPayload(StreamId stream, const std::string& payload) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    bool send_now = false;
+    if (!admitStreamFrame(stream, payload, send_now)) {
+        return false;
+    }
+    return !send_now || sendStreamFrame(stream, payload);
+}
+
+bool TCPClient::sendStreamFrame(StreamId stream, const std::string& payload) {
+    Stream& entry = streams[stream];
+    if (entry.interned) {
+        static const std::string no_header;
+        return sendFrame(INTERNED_HEADER_FLAG | stream, no_header, payload);
+    }
+    
+    if (!sendMessage(entry.header, payload)) {
+        return false;
+    }
+    entry.interned = true;
+    return true;
+}
+
+bool TCPClient::admitStreamFrame(StreamId stream, const std::string& payload, bool& send_now) {
+    if (stream >= streams.size()) {
+        std::cerr << "Unknown stream id: " << stream << std::endl;
+        return false;
+    }
+    
+    auto now = std::chrono::steady_clock::now();
+    releaseDueFrames(now, stream);
+    
+    Stream& entry = streams[stream];
+    switch (entry.decimator.admitFrame(now)) {
+    case StreamDecimator::FrameDecision::Send:
+        entry.has_held_payload = false;
+        send_now = true;
+        break;
+    case StreamDecimator::FrameDecision::Hold:
+        // Wake the release thread when a new hold starts its deadline
+        if (!entry.has_held_payload) {
+            release_wake.notify_one();
+        }
+        entry.held_payload = payload;
+        entry.has_held_payload = true;
+        send_now = false;
+        break;
+    case StreamDecimator::FrameDecision::Drop:
+        send_now = false;
+        break;
+    }
+    return true;
+}
+
+bool TCPClient::sendStreamIntList(StreamId stream, const std::vector<int>& data) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (stream >= streams.size()) {
+        std::cerr << "Unknown stream id: " << stream << std::endl;
+        return false;
+    }
+    
+    auto now = std::chrono::steady_clock::now();
+    releaseDueFrames(now, stream);
+    
+    Stream& entry = streams[stream];
+    if (entry.decimator.getPolicy().mode == DecimationPolicy::Mode::None) {
+        return sendStreamFrame(stream, formatIntList(data));
+    }
+    
+    // Reduce the raw samples first so dropped data is never serialized
+    bool was_holding = entry.decimator.isHolding();
+    if (!entry.decimator.processSamples(data.data(), data.size(), now, entry.decimated)) {
+        if (!was_holding && entry.decimator.isHolding()) {
+            release_wake.notify_one();
+        }
+        return true;
+    }
+    return sendStreamFrame(stream, formatIntList(entry.decimated));
+}
+
+bool TCPClient::sendStreamString(StreamId stream, const std::string& data) {
+    return sendStreamPayload(stream, quoteJson(data));
+}
+
+bool TCPClient::setStreamPolicy(StreamId stream, const DecimationPolicy& policy) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (stream >= streams.size()) {
+        std::cerr << "Unknown stream id: " << stream << std::endl;
+        return false;
+    }
+    
+    streams[stream].decimator.setPolicy(policy);
+    streams[stream].has_held_payload = false;
+    if (policy.mode == DecimationPolicy::Mode::LatestOnly && !release_thread.joinable()) {
+        release_thread = std::thread(&TCPClient::releaseLoop, this);
+    }
+    return true;
+}
+
+bool TCPClient::flushStream(StreamId stream) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (stream >= streams.size()) {
+        std::cerr << "Unknown stream id: " << stream << std::endl;
+        return false;
+    }
+    
+    Stream& entry = streams[stream];
+    if (entry.has_held_payload) {
+        entry.has_held_payload = false;
+        if (!sendStreamFrame(stream, entry.held_payload)) {
+            return false;
+        }
+    }
+    
+    if (entry.decimator.flushSamples(entry.decimated)) {
+        return sendStreamFrame(stream, formatIntList(entry.decimated));
+    }
+    return true;
+}
+
+std::chrono::steady_clock::time_point TCPClient::nextReleaseDeadline() const {
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    for (const Stream& stream : streams) {
+        deadline = std::min(deadline, stream.decimator.heldDeadline());
+    }
+    return deadline;
+}
+
+void TCPClient::releaseDueFrames(std::chrono::steady_clock::time_point now, StreamId except) {
+    // `except` is the stream being sent on, whose newer frame replaces the held
+    // one. A held frame that fails to go out is dropped, as a failed send is.
+    for (StreamId id = 0; id < streams.size(); ++id) {
+        if (id == except || streams[id].decimator.heldDeadline() > now) {
+            continue;
+        }
+        streams[id].decimator.markReleased(now);
+        flushStream(id);
+    }
+}
+
+void TCPClient::releaseLoop() {
+    std::unique_lock<std::recursive_mutex> lock(mutex);
+    while (!release_stopping) {
+        auto deadline = nextReleaseDeadline();
+        if (deadline == std::chrono::steady_clock::time_point::max()) {
+            release_wake.wait(lock);
+        } else {
+            release_wake.wait_until(lock, deadline);
+        }
+        if (!release_stopping) {
+            releaseDueFrames(std::chrono::steady_clock::now(), std::numeric_limits<StreamId>::max());
+        }
+    }
+}
+
 std::string TCPClient::getHost() const {
     return host;
 }
@@ -150,6 +395,7 @@ int TCPClient::getPort() const {
 }
 
 void TCPClient::setTarget(const std::string& host, int port) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     if (connected) {
         disconnect();
     }
@@ -1,17 +1,61 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
+#include "stream_decimator.h"
 
 class TCPClient {
+public:
+    // Identifies a stream opened with openStream()
+    using StreamId = uint32_t;
+    
+    // Header size values with this bit set carry an interned stream id instead of a header
+    static constexpr uint32_t INTERNED_HEADER_FLAG = 0x80000000u;
+    
 private:
+    // Header serialized once per stream; interned after the first frame on a connection
+    struct Stream {
+        std::string name;
+        std::string type;
+        std::string header;
+        bool interned;
+    
+        // Client-side decimation applied before serialization
+        StreamDecimator decimator;
+        std::vector<int> decimated;
+        std::string held_payload;
+        bool has_held_payload;
+    };
+    
     std::string host;
     int port;
     int socket_fd;
     bool connected;
+    std::vector<Stream> streams;
+    
+    // Sends held LatestOnly frames once due when no newer frame comes along.
+    // Started by the first LatestOnly policy; the mutex makes the client safe
+    // to share with it.
+    mutable std::recursive_mutex mutex;
+    std::thread release_thread;
+    std::condition_variable_any release_wake;
+    bool release_stopping;
     
     bool createSocket();
     void closeSocket();
+    bool sendFrame(uint32_t header_field, const std::string& header, const std::string& payload);
+    bool sendStreamFrame(StreamId stream, const std::string& payload);
+    bool admitStreamFrame(StreamId stream, const std::string& payload, bool& send_now);
+    static std::string formatIntList(const std::vector<int>& data);
+    static std::string quoteJson(const std::string& text);
+    void releaseLoop();
+    std::chrono::steady_clock::time_point nextReleaseDeadline() const;
+    void releaseDueFrames(std::chrono::steady_clock::time_point now, StreamId except);
     
 public:
     TCPClient(const std::string& host = "127.0.0.1", int port = 8080);
@@ -34,6 +78,21 @@ public:
     bool sendString(const std::string& data, const std::string& name = "");
     bool sendRawData(const std::string& header_json, const std::string& payload);
     
+    // Streams: the header is built once, sent in full on the first frame of a
+    // connection and replaced by the stream id on every later frame
+    StreamId openStream(const std::string& name, const std::string& type);
+    std::string getStreamHeader(StreamId stream) const;
+    bool sendStreamPayload(StreamId stream, const std::string& payload);
+    bool sendStreamIntList(StreamId stream, const std::vector<int>& data);
+    bool sendStreamString(StreamId stream, const std::string& data);
+    
+    // Per-stream decimation. Frames removed by the policy count as sent; flushStream()
+    // pushes out a held latest frame or a partial min/max window. A held latest
+    // frame also goes out on its own once its interval ends, from a background
+    // thread or from the next send on another stream, whichever comes first.
+    bool setStreamPolicy(StreamId stream, const DecimationPolicy& policy);
+    bool flushStream(StreamId stream);
+    
     // Getters/setters
     std::string getHost() const;
     int getPort() const;
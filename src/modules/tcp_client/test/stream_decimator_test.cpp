@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include "../stream_decimator.h"
+#include <chrono>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+TEST(StreamDecimatorTest, NonePassesEverything) {
+    StreamDecimator decimator;
+    std::vector<int> out;
+    int data[] = {1, 2, 3};
+    
+    EXPECT_TRUE(decimator.processSamples(data, 3, Clock::now(), out));
+    EXPECT_EQ(out, std::vector<int>({1, 2, 3}));
+    EXPECT_EQ(decimator.admitFrame(Clock::now()), StreamDecimator::FrameDecision::Send);
+    EXPECT_FALSE(decimator.flushSamples(out));
+}
+
+TEST(StreamDecimatorTest, EveryNthKeepsStrideAcrossFrames) {
+    StreamDecimator decimator(DecimationPolicy::everyNth(3));
+    std::vector<int> out;
+    int first[] = {0, 1, 2, 3, 4};
+    int second[] = {5, 6, 7, 8};
+    int third[] = {9};
+    
+    EXPECT_TRUE(decimator.processSamples(first, 5, Clock::now(), out));
+    EXPECT_EQ(out, std::vector<int>({0, 3}));
+    EXPECT_TRUE(decimator.processSamples(second, 4, Clock::now(), out));
+    EXPECT_EQ(out, std::vector<int>({6}));
+    EXPECT_TRUE(decimator.processSamples(third, 1, Clock::now(), out));
+    EXPECT_EQ(out, std::vector<int>({9}));
+}
+
+TEST(StreamDecimatorTest, EveryNthAdmitsOneFrameInN) {
+    StreamDecimator decimator(DecimationPolicy::everyNth(2));
+    auto now = Clock::now();
+    
+    EXPECT_EQ(decimator.admitFrame(now), StreamDecimator::FrameDecision::Send);
+    EXPECT_EQ(decimator.admitFrame(now), StreamDecimator::FrameDecision::Drop);
+    EXPECT_EQ(decimator.admitFrame(now), StreamDecimator::FrameDecision::Send);
+    EXPECT_EQ(decimator.admitFrame(now), StreamDecimator::FrameDecision::Drop);
+}
+
+TEST(StreamDecimatorTest, MinMaxKeepsExtremesInOrder) {
+    StreamDecimator decimator(DecimationPolicy::minMax(4));
+    std::vector<int> out;
+    int data[] = {5, 9, 1, 3,   2, 2, 2, 2,   7, 8};
+    
+    EXPECT_TRUE(decimator.processSamples(data, 10, Clock::now(), out));
+    EXPECT_EQ(out, std::vector<int>({9, 1, 2}));
+    
+    // The partial window is completed by the next frame
+    int more[] = {0, 4};
+    EXPECT_TRUE(decimator.processSamples(more, 2, Clock::now(), out));
+    EXPECT_EQ(out, std::vector<int>({8, 0}));
+    
+    int tail[] = {6};
+    EXPECT_FALSE(decimator.processSamples(tail, 1, Clock::now(), out));
+    EXPECT_TRUE(decimator.flushSamples(out));
+    EXPECT_EQ(out, std::vector<int>({6}));
+    EXPECT_FALSE(decimator.flushSamples(out));
+}
+
+TEST(StreamDecimatorTest, LatestOnlyHoldsNewestFrameUntilIntervalEnds) {
+    StreamDecimator decimator(DecimationPolicy::latestOnly(milliseconds(100)));
+    std::vector<int> out;
+    auto start = Clock::now();
+    int a[] = {1};
+    int b[] = {2};
+    int c[] = {3};
+    
+    EXPECT_TRUE(decimator.processSamples(a, 1, start, out));
+    EXPECT_EQ(out, std::vector<int>({1}));
+    EXPECT_FALSE(decimator.isHolding());
+    EXPECT_EQ(decimator.heldDeadline(), Clock::time_point::max());
+    
+    // Frames inside the interval replace each other; the newest is due at its end
+    EXPECT_FALSE(decimator.processSamples(b, 1, start + milliseconds(10), out));
+    EXPECT_FALSE(decimator.processSamples(c, 1, start + milliseconds(20), out));
+    EXPECT_TRUE(decimator.isHolding());
+    EXPECT_EQ(decimator.heldDeadline(), start + milliseconds(100));
+    
+    EXPECT_TRUE(decimator.flushSamples(out));
+    EXPECT_EQ(out, std::vector<int>({3}));
+    decimator.markReleased(start + milliseconds(100));
+    EXPECT_FALSE(decimator.isHolding());
+    
+    // The release starts the next interval
+    EXPECT_FALSE(decimator.processSamples(a, 1, start + milliseconds(150), out));
+    EXPECT_EQ(decimator.heldDeadline(), start + milliseconds(200));
+    EXPECT_TRUE(decimator.processSamples(b, 1, start + milliseconds(200), out));
+    EXPECT_EQ(out, std::vector<int>({2}));
+    EXPECT_FALSE(decimator.isHolding());
+}
+
+TEST(StreamDecimatorTest, LatestOnlyFramePath) {
+    StreamDecimator decimator(DecimationPolicy::latestOnly(milliseconds(50)));
+    auto start = Clock::now();
+    
+    EXPECT_EQ(decimator.admitFrame(start), StreamDecimator::FrameDecision::Send);
+    EXPECT_EQ(decimator.admitFrame(start + milliseconds(10)), StreamDecimator::FrameDecision::Hold);
+    EXPECT_TRUE(decimator.isHolding());
+    EXPECT_EQ(decimator.heldDeadline(), start + milliseconds(50));
+    
+    // A frame after the interval goes out and supersedes the held one
+    EXPECT_EQ(decimator.admitFrame(start + milliseconds(60)), StreamDecimator::FrameDecision::Send);
+    EXPECT_FALSE(decimator.isHolding());
+}
+
+TEST(StreamDecimatorTest, SetPolicyResetsState) {
+    StreamDecimator decimator(DecimationPolicy::minMax(4));
+    std::vector<int> out;
+    int data[] = {1, 2};
+    
+    EXPECT_FALSE(decimator.processSamples(data, 2, Clock::now(), out));
+    decimator.setPolicy(DecimationPolicy::everyNth(0));
+    EXPECT_EQ(decimator.getPolicy().factor, 1u);
+    EXPECT_FALSE(decimator.flushSamples(out));
+    EXPECT_TRUE(decimator.processSamples(data, 2, Clock::now(), out));
+    EXPECT_EQ(out, std::vector<int>({1, 2}));
+}
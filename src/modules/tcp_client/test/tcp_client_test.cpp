@@ -4,6 +4,12 @@
 #include <thread>
 #include <chrono>
 #include <atomic>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
 
 class TCPClientTest : public ::testing::Test {
 protected:
@@ -262,4 +268,318 @@ TEST_F(TCPClientTest, ReconnectionTest) {
     // Should be able to reconnect
     EXPECT_TRUE(client->connect());
     EXPECT_TRUE(client->isConnected());
-}
\ No newline at end of file
+}
+TEST_F(TCPClientTest, OpenStreamBuildsHeaderOnce) {
+    TCPClient::StreamId list_stream = client->openStream("sensor", "int_list");
+    TCPClient::StreamId anon_stream = client->openStream("", "string");
+    
+    EXPECT_EQ(list_stream, 0u);
+    EXPECT_EQ(anon_stream, 1u);
+    EXPECT_EQ(client->getStreamHeader(list_stream), "{\"type\": \"int_list\", \"name\": \"sensor\", \"stream_id\": 0}");
+    EXPECT_EQ(client->getStreamHeader(anon_stream), "{\"type\": \"string\", \"stream_id\": 1}");
+    
+    // Unknown streams cannot be sent on
+    EXPECT_TRUE(client->connect());
+    EXPECT_FALSE(client->sendStreamPayload(42, "[1]"));
+}
+
+TEST_F(TCPClientTest, StreamFramesOnPersistentConnection) {
+    std::vector<std::string> received_headers;
+    std::vector<std::string> received_payloads;
+    
+    server->onDataReceived = [&](const std::string& header, const std::string& payload) {
+        received_headers.push_back(header);
+        received_payloads.push_back(payload);
+    };
+    
+    TCPClient::StreamId stream = client->openStream("samples", "int_list");
+    
+    // All frames share one connection; only the first carries the full header
+    EXPECT_TRUE(client->connect());
+    EXPECT_TRUE(client->sendStreamIntList(stream, {1, 2}));
+    EXPECT_TRUE(client->sendStreamIntList(stream, {3, 4}));
+    EXPECT_TRUE(client->sendStreamIntList(stream, {5, 6}));
+    
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    
+    ASSERT_EQ(received_headers.size(), 3u);
+    for (const std::string& header : received_headers) {
+        EXPECT_EQ(header, client->getStreamHeader(stream));
+    }
+    EXPECT_EQ(received_payloads[0], "[1, 2]");
+    EXPECT_EQ(received_payloads[1], "[3, 4]");
+    EXPECT_EQ(received_payloads[2], "[5, 6]");
+}
+
+TEST_F(TCPClientTest, StreamReannouncedAfterReconnect) {
+    std::vector<std::string> received_headers;
+    
+    server->onDataReceived = [&](const std::string& header, const std::string&) {
+        received_headers.push_back(header);
+    };
+    
+    TCPClient::StreamId stream = client->openStream("status", "string");
+    
+    EXPECT_TRUE(client->connect());
+    EXPECT_TRUE(client->sendStreamString(stream, "first"));
+    client->disconnect();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    
+    // A new connection has an empty intern table, so the full header is sent again
+    EXPECT_TRUE(client->connect());
+    EXPECT_TRUE(client->sendStreamString(stream, "second"));
+    EXPECT_TRUE(client->sendStreamString(stream, "third"));
+    
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    
+    ASSERT_EQ(received_headers.size(), 3u);
+    EXPECT_EQ(received_headers[2], client->getStreamHeader(stream));
+}
+
+TEST_F(TCPClientTest, StreamStringIsEscaped) {
+    std::mutex received_mutex;
+    std::vector<std::string> received_payloads;
+    
+    server->onDataReceived = [&](const std::string&, const std::string& payload) {
+        std::lock_guard<std::mutex> lock(received_mutex);
+        received_payloads.push_back(payload);
+    };
+    
+    // Quotes, backslashes and control characters must not break the JSON
+    const std::string text = "say \"hi\"\\path\n\ttab\x01";
+    TCPClient::StreamId stream = client->openStream("quo\"ted", "string");
+    EXPECT_TRUE(nlohmann::json::accept(client->getStreamHeader(stream)));
+    
+    EXPECT_TRUE(client->connect());
+    EXPECT_TRUE(client->sendStreamString(stream, text));
+    
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    
+    std::lock_guard<std::mutex> lock(received_mutex);
+    ASSERT_EQ(received_payloads.size(), 1u);
+    nlohmann::json parsed = nlohmann::json::parse(received_payloads[0], nullptr, false);
+    ASSERT_TRUE(parsed.is_string());
+    EXPECT_EQ(parsed.get<std::string>(), text);
+}
+
+TEST_F(TCPClientTest, CallbacksFromConcurrentConnectionsDoNotOverlap) {
+    std::atomic<bool> in_callback(false);
+    std::atomic<bool> overlapped(false);
+    std::atomic<int> received(0);
+    
+    server->onDataReceived = [&](const std::string&, const std::string&) {
+        if (in_callback.exchange(true)) {
+            overlapped = true;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        ++received;
+        in_callback = false;
+    };
+    
+    // Each sender has its own connection, so its own server thread
+    std::vector<std::thread> senders;
+    for (int i = 0; i < 4; ++i) {
+        senders.emplace_back([i]() {
+            TCPClient sender("127.0.0.1", 8081);
+            TCPClient::StreamId stream = sender.openStream("sender_" + std::to_string(i), "int_list");
+            sender.connect();
+            for (int frame = 0; frame < 25; ++frame) {
+                sender.sendStreamIntList(stream, {i, frame});
+            }
+        });
+    }
+    for (auto& sender : senders) {
+        sender.join();
+    }
+    
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    
+    EXPECT_FALSE(overlapped);
+    EXPECT_EQ(received, 100);
+}
+
+TEST_F(TCPClientTest, StreamIdInsideStringIsNotInterned) {
+    std::vector<std::string> received_headers;
+    std::mutex received_mutex;
+    
+    server->onDataReceived = [&](const std::string& header, const std::string&) {
+        std::lock_guard<std::mutex> lock(received_mutex);
+        received_headers.push_back(header);
+    };
+    
+    // Only a top-level stream_id announces a stream
+    std::string announced = "{\"type\": \"string\", \"stream_id\": 6}";
+    std::string quoted = "{\"type\": \"string\", \"name\": \"\\\"stream_id\\\": 5\"}";
+    EXPECT_TRUE(client->connect());
+    EXPECT_TRUE(client->sendRawData(announced, "\"a\""));
+    EXPECT_TRUE(client->sendRawData(quoted, "\"b\""));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    {
+        std::lock_guard<std::mutex> lock(received_mutex);
+        ASSERT_EQ(received_headers.size(), 2u);
+    }
+    
+    // A compact frame for stream 6 resolves; one for stream 5 is unknown
+    int socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(socket_fd, 0);
+    struct sockaddr_in server_addr = {};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(8081);
+    server_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    ASSERT_EQ(connect(socket_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)), 0);
+    
+    auto sendFrame = [&](uint32_t header_field, const std::string& header, const std::string& payload) {
+        uint32_t header_size = htonl(header_field);
+        uint32_t payload_size = htonl(static_cast<uint32_t>(payload.size()));
+        send(socket_fd, &header_size, sizeof(header_size), 0);
+        send(socket_fd, header.data(), header.size(), 0);
+        send(socket_fd, &payload_size, sizeof(payload_size), 0);
+        send(socket_fd, payload.data(), payload.size(), 0);
+    };
+    sendFrame(static_cast<uint32_t>(quoted.size()), quoted, "\"c\"");
+    sendFrame(TCPServer::INTERNED_HEADER_FLAG | 5, "", "\"d\"");
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    close(socket_fd);
+    
+    std::lock_guard<std::mutex> lock(received_mutex);
+    ASSERT_EQ(received_headers.size(), 3u);
+    EXPECT_EQ(received_headers[2], quoted);
+}
+
+TEST(StreamDecimatorTest, EveryNthKeepsStrideAcrossFrames) {
+    StreamDecimator decimator(DecimationPolicy::everyNth(3));
+    auto now = std::chrono::steady_clock::now();
+    std::vector<int> out;
+    
+    std::vector<int> first = {0, 1, 2, 3, 4};
+    EXPECT_TRUE(decimator.processSamples(first.data(), first.size(), now, out));
+    EXPECT_EQ(out, std::vector<int>({0, 3}));
+    
+    std::vector<int> second = {5, 6, 7, 8, 9, 10};
+    EXPECT_TRUE(decimator.processSamples(second.data(), second.size(), now, out));
+    EXPECT_EQ(out, std::vector<int>({6, 9}));
+    
+    // A frame that falls entirely between kept samples produces nothing
+    std::vector<int> third = {11};
+    EXPECT_FALSE(decimator.processSamples(third.data(), third.size(), now, out));
+}
+
+TEST(StreamDecimatorTest, MinMaxPreservesExtremesInOrder) {
+    StreamDecimator decimator(DecimationPolicy::minMax(4));
+    auto now = std::chrono::steady_clock::now();
+    std::vector<int> out;
+    
+    std::vector<int> samples = {5, 9, -2, 4, 7, 7, 1, 3, 8, 0};
+    EXPECT_TRUE(decimator.processSamples(samples.data(), samples.size(), now, out));
+    EXPECT_EQ(out, std::vector<int>({9, -2, 7, 1}));
+    
+    // The last two samples complete the next window together with new data
+    std::vector<int> more = {6, 2};
+    EXPECT_TRUE(decimator.processSamples(more.data(), more.size(), now, out));
+    EXPECT_EQ(out, std::vector<int>({8, 0}));
+    
+    std::vector<int> tail = {4};
+    EXPECT_FALSE(decimator.processSamples(tail.data(), tail.size(), now, out));
+    EXPECT_TRUE(decimator.flushSamples(out));
+    EXPECT_EQ(out, std::vector<int>({4}));
+}
+
+TEST(StreamDecimatorTest, LatestOnlyHoldsNewestFrame) {
+    StreamDecimator decimator(DecimationPolicy::latestOnly(std::chrono::milliseconds(20)));
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> out;
+    
+    std::vector<int> a = {1}, b = {2}, c = {3}, d = {4};
+    EXPECT_TRUE(decimator.processSamples(a.data(), a.size(), start, out));
+    EXPECT_FALSE(decimator.processSamples(b.data(), b.size(), start + std::chrono::milliseconds(5), out));
+    EXPECT_FALSE(decimator.processSamples(c.data(), c.size(), start + std::chrono::milliseconds(10), out));
+    
+    EXPECT_TRUE(decimator.flushSamples(out));
+    EXPECT_EQ(out, std::vector<int>({3}));
+    
+    EXPECT_TRUE(decimator.processSamples(d.data(), d.size(), start + std::chrono::milliseconds(25), out));
+    EXPECT_EQ(out, std::vector<int>({4}));
+    EXPECT_FALSE(decimator.flushSamples(out));
+}
+
+TEST(StreamDecimatorTest, LatestOnlyHeldFrameIsDueAtEndOfInterval) {
+    StreamDecimator decimator(DecimationPolicy::latestOnly(std::chrono::milliseconds(20)));
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> out;
+    
+    std::vector<int> a = {1}, b = {2};
+    EXPECT_TRUE(decimator.processSamples(a.data(), a.size(), start, out));
+    EXPECT_EQ(decimator.heldDeadline(), std::chrono::steady_clock::time_point::max());
+    EXPECT_FALSE(decimator.processSamples(b.data(), b.size(), start + std::chrono::milliseconds(5), out));
+    EXPECT_EQ(decimator.heldDeadline(), start + std::chrono::milliseconds(20));
+    
+    // Releasing it starts the next interval
+    decimator.markReleased(start + std::chrono::milliseconds(20));
+    EXPECT_TRUE(decimator.flushSamples(out));
+    EXPECT_EQ(out, std::vector<int>({2}));
+    EXPECT_EQ(decimator.heldDeadline(), std::chrono::steady_clock::time_point::max());
+    
+    // Frames held on the opaque path have a deadline too
+    EXPECT_EQ(decimator.admitFrame(start + std::chrono::milliseconds(25)), StreamDecimator::FrameDecision::Hold);
+    EXPECT_EQ(decimator.heldDeadline(), start + std::chrono::milliseconds(40));
+}
+
+TEST_F(TCPClientTest, LatestOnlyReleasesHeldFrameWithoutFlush) {
+    std::vector<std::string> received_payloads;
+    std::mutex received_mutex;
+    
+    server->onDataReceived = [&](const std::string&, const std::string& payload) {
+        std::lock_guard<std::mutex> lock(received_mutex);
+        received_payloads.push_back(payload);
+    };
+    
+    TCPClient::StreamId samples = client->openStream("samples", "int_list");
+    TCPClient::StreamId status = client->openStream("status", "string");
+    EXPECT_TRUE(client->setStreamPolicy(samples, DecimationPolicy::latestOnly(std::chrono::milliseconds(50))));
+    EXPECT_TRUE(client->setStreamPolicy(status, DecimationPolicy::latestOnly(std::chrono::milliseconds(50))));
+    
+    EXPECT_TRUE(client->connect());
+    EXPECT_TRUE(client->sendStreamIntList(samples, {1}));
+    EXPECT_TRUE(client->sendStreamIntList(samples, {2}));
+    EXPECT_TRUE(client->sendStreamIntList(samples, {3}));
+    EXPECT_TRUE(client->sendStreamString(status, "a"));
+    EXPECT_TRUE(client->sendStreamString(status, "b"));
+    
+    // Nothing else is sent; the newest held frames go out once their interval ends
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    
+    std::lock_guard<std::mutex> lock(received_mutex);
+    ASSERT_EQ(received_payloads.size(), 4u);
+    EXPECT_EQ(received_payloads[0], "[1]");
+    EXPECT_EQ(received_payloads[1], "\"a\"");
+    EXPECT_TRUE((received_payloads[2] == "[3]" && received_payloads[3] == "\"b\"") ||
+                (received_payloads[2] == "\"b\"" && received_payloads[3] == "[3]"));
+}
+
+TEST_F(TCPClientTest, StreamPolicyReducesFramesBeforeSending) {
+    std::vector<std::string> received_payloads;
+    
+    server->onDataReceived = [&](const std::string&, const std::string& payload) {
+        received_payloads.push_back(payload);
+    };
+    
+    TCPClient::StreamId samples = client->openStream("samples", "int_list");
+    TCPClient::StreamId status = client->openStream("status", "string");
+    EXPECT_TRUE(client->setStreamPolicy(samples, DecimationPolicy::minMax(4)));
+    EXPECT_TRUE(client->setStreamPolicy(status, DecimationPolicy::everyNth(2)));
+    
+    EXPECT_TRUE(client->connect());
+    EXPECT_TRUE(client->sendStreamIntList(samples, {1, 8, 3, 2, 5}));
+    EXPECT_TRUE(client->sendStreamString(status, "a"));
+    EXPECT_TRUE(client->sendStreamString(status, "b"));
+    EXPECT_TRUE(client->sendStreamString(status, "c"));
+    EXPECT_TRUE(client->flushStream(samples));
+    
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    
+    ASSERT_EQ(received_payloads.size(), 4u);
+    EXPECT_EQ(received_payloads[0], "[1, 8]");
+    EXPECT_EQ(received_payloads[1], "\"a\"");
+    EXPECT_EQ(received_payloads[2], "\"c\"");
+    EXPECT_EQ(received_payloads[3], "[5]");
+}
@@ -1,12 +1,37 @@
 #include "tcp_server.h"
 #include "python_engine.h"
+#include "json_to_python.h"
+#include "session_journal.h"
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QHostAddress>
 #include <QDebug>
+#include <QPointer>
+
+namespace {
+
+// About the memory a parsed value holds, for the journal's queue budget
+size_t jsonBytes(const QJsonValue& value) {
+    size_t bytes = sizeof(QJsonValue);
+    if (value.isString()) {
+        bytes += static_cast<size_t>(value.toString().size()) * sizeof(QChar);
+    } else if (value.isArray()) {
+        for (const QJsonValue& item : value.toArray()) {
+            bytes += jsonBytes(item);
+        }
+    } else if (value.isObject()) {
+        QJsonObject object = value.toObject();
+        for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+            bytes += static_cast<size_t>(it.key().size()) * sizeof(QChar) + jsonBytes(it.value());
+        }
+    }
+    return bytes;
+}
+
+}  // namespace
 
 TCPServer::TCPServer(PythonEngine* pythonEngine, QObject* parent)
-    : QObject(parent), pythonEngine(pythonEngine) {
+    : QObject(parent), pythonEngine(pythonEngine), sessionJournal(nullptr) {
     
     server = std::make_unique<QTcpServer>(this);
     
@@ -23,6 +48,7 @@ TCPServer::TCPServer(PythonEngine* pythonEngine, QObject* parent)
         clients.removeAll(nullptr);
         for (auto it = clients.begin(); it != clients.end();) {
             if ((*it)->state() == QAbstractSocket::UnconnectedState) {
+                streamHeaders.remove(*it);
                 (*it)->deleteLater();
                 it = clients.erase(it);
             } else {
@@ -64,6 +90,7 @@ void TCPServer::stopServer() {
             }
         }
         clients.clear();
+        streamHeaders.clear();
         
         qDebug() << "TCP Server stopped";
     }
@@ -107,6 +134,7 @@ void TCPServer::onClientDisconnected() {
     
     QString clientAddress = client->peerAddress().toString();
     clients.removeAll(client);
+    streamHeaders.remove(client);
     client->deleteLater();
     
     emit clientDisconnected(clientAddress);
@@ -131,96 +159,163 @@ void TCPServer::processClientMessage(QTcpSocket* client, const QByteArray& data)
     emit dataReceived(message);
     
     // Handle the message
-    QJsonObject response;
     QString command = message["command"].toString();
     
     if (command == "inject_data") {
-        response = handleDataInjection(message);
+        QString streamError;
+        if (!resolveStream(client, message, streamError)) {
+            sendResponse(client, createResponse(false, streamError));
+            return;
+        }
+        handleDataInjection(client, message);
     } else {
-        response = createResponse(false, "Unknown command: " + command);
+        sendResponse(client, createResponse(false, "Unknown command: " + command));
+    }
+}
+
+bool TCPServer::resolveStream(QTcpSocket* client, QJsonObject& message, QString& error) {
+    // A message with a stream_id and a name announces the stream on this
+    // connection; later ones may carry only the id and the data, the way
+    // TCPClient streams intern their header
+    QJsonValue id = message["stream_id"];
+    if (id.isUndefined()) {
+        return true;
+    }
+    qint64 streamId = id.toInteger(-1);
+    if (streamId < 0 || streamId >= 0x80000000LL) {
+        error = "stream_id must be an integer from 0 to 2^31 - 1";
+        return false;
+    }
+    
+    QHash<qint64, QJsonObject>& announced = streamHeaders[client];
+    if (message.contains("name")) {
+        QJsonObject header;
+        header["name"] = message["name"];
+        header["type"] = message["type"];
+        announced.insert(streamId, header);
+        return true;
     }
     
-    // Send response
+    auto it = announced.constFind(streamId);
+    if (it == announced.constEnd()) {
+        error = QString("Unknown stream id: %1").arg(streamId);
+        return false;
+    }
+    message["name"] = it->value("name");
+    message["type"] = it->value("type");
+    return true;
+}
+
+void TCPServer::sendResponse(QTcpSocket* client, const QJsonObject& response) {
     client->write(QJsonDocument(response).toJson(QJsonDocument::Compact));
 }
 
-QJsonObject TCPServer::handleDataInjection(const QJsonObject& message) {
+void TCPServer::handleDataInjection(QTcpSocket* client, const QJsonObject& message) {
     QString variableName = message["name"].toString();
     QJsonObject data = message["data"].toObject();
     QString dataType = message["type"].toString();
     
     if (variableName.isEmpty()) {
-        return createResponse(false, "Variable name is required");
+        sendResponse(client, createResponse(false, "Variable name is required"));
+        return;
     }
     
     if (!pythonEngine || !pythonEngine->isInitialized()) {
-        return createResponse(false, "Python engine not initialized");
+        sendResponse(client, createResponse(false, "Python engine not initialized"));
+        return;
     }
     
-    try {
-        injectPythonVariable(variableName, data);
-        return createResponse(true, "Data injected successfully");
-    } catch (const std::exception& e) {
-        return createResponse(false, QString("Injection failed: %1").arg(e.what()));
-    } catch (...) {
-        return createResponse(false, "Injection failed: Unknown error");
+    // Python code can stop ingest through lumos.pause()
+    if (pythonEngine->isIngestPaused()) {
+        pythonEngine->recordDroppedIngest(variableName.toStdString());
+        sendResponse(client, createResponse(false, "Ingest paused"));
+        return;
+    }
+    
+    // Reply once the frame is bound
+    QPointer<QTcpSocket> socket(client);
+    bool queued = injectFrame(variableName, data, [this, socket](const QString& error) {
+        QJsonObject response = error.isEmpty() ? createResponse(true, "Data injected successfully")
+                                               : createResponse(false, error);
+        QMetaObject::invokeMethod(this, [this, socket, response]() {
+            if (socket) {
+                sendResponse(socket, response);
+            }
+        }, Qt::QueuedConnection);
+    });
+    
+    if (!queued) {
+        sendResponse(client, createResponse(false, "Python engine not initialized"));
     }
 }
 
-void TCPServer::injectPythonVariable(const QString& name, const QJsonObject& data) {
-    // Thread-safe Python operations
-    pythonEngine->acquireGIL();
+bool TCPServer::injectFrame(const QString& name, const QJsonObject& data, InjectFinished onFinished) {
+    if (!pythonEngine || !pythonEngine->isInitialized()) {
+        return false;
+    }
     
-    try {
-        // Convert JSON to Python object based on type
-        QString pythonCode;
-        
-        if (data.contains("list")) {
-            // Handle list data
-            QJsonArray array = data["list"].toArray();
-            QStringList items;
-            for (const QJsonValue& value : array) {
-                if (value.isString()) {
-                    items.append("'" + value.toString() + "'");
-                } else {
-                    items.append(QString::number(value.toDouble()));
-                }
-            }
-            pythonCode = name + " = [" + items.join(", ") + "]";
-        } else if (data.contains("dict")) {
-            // Handle dictionary data
-            QJsonObject dict = data["dict"].toObject();
-            QStringList items;
-            for (auto it = dict.begin(); it != dict.end(); ++it) {
-                QString key = "'" + it.key() + "'";
-                QString value = it.value().isString() ? 
-                    "'" + it.value().toString() + "'" : 
-                    QString::number(it.value().toDouble());
-                items.append(key + ": " + value);
-            }
-            pythonCode = name + " = {" + items.join(", ") + "}";
-        } else if (data.contains("string")) {
-            // Handle string data
-            pythonCode = name + " = '" + data["string"].toString() + "'";
-        } else if (data.contains("number")) {
-            // Handle numeric data
-            pythonCode = name + " = " + QString::number(data["number"].toDouble());
-        } else {
-            throw std::runtime_error("Unsupported data type");
+    // Inject next to the running command: right away without a GIL, otherwise
+    // on the engine's ingest thread the next time the command yields the GIL
+    auto received = std::chrono::steady_clock::now();
+    return pythonEngine->postIngest([this, name, data, received, onFinished = std::move(onFinished)]() {
+        QString error;
+        try {
+            injectPythonVariable(name, data, received);
+        } catch (const std::exception& e) {
+            error = QString("Injection failed: %1").arg(e.what());
+        } catch (...) {
+            error = "Injection failed: Unknown error";
         }
-        
-        // Execute the Python code to create the variable
-        std::string result = pythonEngine->evaluateExpression(pythonCode.toStdString());
-        if (result.find("Error:") == 0) {
-            throw std::runtime_error(result);
+        onFinished(error);
+    });
+}
+
+void TCPServer::injectPythonVariable(const QString& name, const QJsonObject& data,
+                                     std::chrono::steady_clock::time_point received) {
+    // Runs as an ingest job, attached to the interpreter
+    
+    // Build the objects directly instead of generating Python source and
+    // compiling it; numeric arrays stay packed in a C++ buffer behind a
+    // lumos.Array
+    PyObject* object = nullptr;
+    if (data.contains("array")) {
+        LumosArray::ElementType elementType;
+        QString dtype = data["dtype"].toString("float64");
+        if (!LumosArray::parseElementType(dtype.toStdString(), elementType)) {
+            throw std::runtime_error("Unsupported dtype: " + dtype.toStdString());
         }
-        
-    } catch (...) {
-        pythonEngine->releaseGIL();
-        throw;
+        object = jsonToArray(*pythonEngine, data["array"], elementType);
+    } else if (data.contains("list")) {
+        object = jsonToPython(data["list"]);
+    } else if (data.contains("dict")) {
+        object = jsonToPython(data["dict"]);
+    } else if (data.contains("string")) {
+        object = jsonToPython(data["string"]);
+    } else if (data.contains("number")) {
+        object = jsonToPython(data["number"]);
+    } else {
+        throw std::runtime_error("Unsupported data type");
     }
     
-    pythonEngine->releaseGIL();
+    // Bind it in __main__ without queueing behind the running command; the
+    // stream keeps it for lumos.get_latest()
+    std::string error;
+    bool ok = pythonEngine->setVariable(name.toStdString(), object, error);
+    if (ok) {
+        pythonEngine->recordIngest(name.toStdString(), object, received);
+        
+        // Encoded on the journal's writer thread; the copy it holds keeps the
+        // frame's data alive until then and counts against the journal's budget
+        if (sessionJournal) {
+            sessionJournal->recordFrame(name.toStdString(), [data]() {
+                return QJsonDocument(data).toJson(QJsonDocument::Compact).toStdString();
+            }, jsonBytes(data), received);
+        }
+    }
+    Py_XDECREF(object);
+    if (!ok) {
+        throw std::runtime_error(error);
+    }
 }
 
 QJsonObject TCPServer::createResponse(bool success, const QString& message, const QJsonObject& data) {
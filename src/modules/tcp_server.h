@@ -4,10 +4,14 @@
 #include <QTcpServer>
 #include <QTcpSocket>
 #include <QJsonObject>
+#include <QHash>
 #include <QTimer>
+#include <chrono>
+#include <functional>
 #include <memory>
 
 class PythonEngine;
+class SessionJournal;
 
 class TCPServer : public QObject {
     Q_OBJECT
@@ -21,6 +25,15 @@ public:
     
     bool isListening() const;
     int serverPort() const;
+    
+    // Injected frames are recorded here once bound
+    void setSessionJournal(SessionJournal* journal) { sessionJournal = journal; }
+    
+    // Inject a frame the way a client's inject_data does, for replaying a
+    // journal. `onFinished` runs on the ingest thread with an empty string on
+    // success. Returns false if the engine is not running.
+    using InjectFinished = std::function<void(const QString& error)>;
+    bool injectFrame(const QString& name, const QJsonObject& data, InjectFinished onFinished);
 
 signals:
     void clientConnected(const QString& address);
@@ -36,12 +49,19 @@ private slots:
 
 private:
     void processClientMessage(QTcpSocket* client, const QByteArray& data);
-    QJsonObject handleDataInjection(const QJsonObject& message);
+    bool resolveStream(QTcpSocket* client, QJsonObject& message, QString& error);
+    void handleDataInjection(QTcpSocket* client, const QJsonObject& message);
+    void sendResponse(QTcpSocket* client, const QJsonObject& response);
     QJsonObject createResponse(bool success, const QString& message = "", const QJsonObject& data = QJsonObject());
-    void injectPythonVariable(const QString& name, const QJsonObject& data);
+    void injectPythonVariable(const QString& name, const QJsonObject& data,
+                              std::chrono::steady_clock::time_point received);
     
     PythonEngine* pythonEngine;
+    SessionJournal* sessionJournal;
     std::unique_ptr<QTcpServer> server;
     QList<QTcpSocket*> clients;
     QTimer* heartbeatTimer;
+    
+    // Name and type of the streams each connection announced, by stream id
+    QHash<QTcpSocket*, QHash<qint64, QJsonObject>> streamHeaders;
 };
\ No newline at end of file
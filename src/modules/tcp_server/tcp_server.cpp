@@ -2,8 +2,29 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <unistd.h>
+#include <nlohmann/json.hpp>
 #include <iostream>
 #include <cstring>
+#include <vector>
+
+namespace {
+
+// Extracts the "stream_id" announced in a full header, if any
+bool parseStreamId(const std::string& header, uint32_t& stream_id) {
+    nlohmann::json parsed = nlohmann::json::parse(header, nullptr, false);
+    if (!parsed.is_object()) return false;
+    
+    auto it = parsed.find("stream_id");
+    if (it == parsed.end() || !it->is_number_unsigned()) return false;
+    
+    uint64_t value = it->get<uint64_t>();
+    if (value >= TCPServer::INTERNED_HEADER_FLAG) return false;
+    
+    stream_id = static_cast<uint32_t>(value);
+    return true;
+}
+
+}  // namespace
 
 TCPServer::TCPServer(int port) : running(false), port(port), server_socket(-1) {
 }
@@ -61,6 +82,7 @@ void TCPServer::stop() {
         running.store(false);
         
         if (server_socket >= 0) {
+            shutdown(server_socket, SHUT_RDWR);
             close(server_socket);
             server_socket = -1;
         }
@@ -69,6 +91,22 @@ void TCPServer::stop() {
             server_thread.join();
         }
         
+        // Wake up client threads blocked on persistent connections
+        std::list<ClientConnection> connections;
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            for (auto& connection : client_connections) {
+                shutdown(connection.socket_fd, SHUT_RDWR);
+            }
+            connections.swap(client_connections);
+        }
+        for (auto& connection : connections) {
+            if (connection.thread.joinable()) {
+                connection.thread.join();
+            }
+            close(connection.socket_fd);
+        }
+        
         std::cout << "TCP server stopped" << std::endl;
     }
 }
@@ -91,38 +129,89 @@ void TCPServer::serverLoop() {
             continue;
         }
         
+        reapFinishedClients();
+        
+        // Each connection is served on its own thread so persistent clients do not block others
         std::cout << "Client connected, handling request..." << std::endl;
-        handleClient(client_socket);
-        close(client_socket);
-        std::cout << "Client disconnected" << std::endl;
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        auto finished = std::make_shared<std::atomic<bool>>(false);
+        client_connections.push_back(ClientConnection{client_socket, std::thread(), finished});
+        client_connections.back().thread = std::thread([this, client_socket, finished]() {
+            handleClient(client_socket);
+            finished->store(true);
+        });
+    }
+}
+
+void TCPServer::reapFinishedClients() {
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    for (auto it = client_connections.begin(); it != client_connections.end();) {
+        if (it->finished->load()) {
+            it->thread.join();
+            close(it->socket_fd);
+            it = client_connections.erase(it);
+        } else {
+            ++it;
+        }
     }
 }
 
 void TCPServer::handleClient(int client_socket) {
-    std::cout << "Reading header size..." << std::endl;
+    // Stream ids announced on this connection, mapped to their full header
+    std::unordered_map<uint32_t, std::string> interned_headers;
+    
+    while (running.load() && handleFrame(client_socket, interned_headers)) {
+    }
     
+    // The descriptor itself is closed once this thread has been joined
+    shutdown(client_socket, SHUT_RDWR);
+    std::cout << "Client disconnected" << std::endl;
+}
+
+bool TCPServer::handleFrame(int client_socket, std::unordered_map<uint32_t, std::string>& interned_headers) {
     // Read header size first (4 bytes)
     uint32_t header_size;
     ssize_t bytes_read = recv(client_socket, &header_size, sizeof(header_size), MSG_WAITALL);
+    if (bytes_read == 0) {
+        // Client closed the connection between frames
+        return false;
+    }
     if (bytes_read != sizeof(header_size)) {
         std::cerr << "Failed to read header size, got " << bytes_read << " bytes" << std::endl;
-        return;
+        return false;
     }
     
     // Convert from network byte order
     header_size = ntohl(header_size);
     
-    if (header_size > 1024) {
-        std::cerr << "Header too large: " << header_size << std::endl;
-        return;
-    }
-    
-    // Read header
-    std::string header(header_size, '\0');
-    bytes_read = recv(client_socket, &header[0], header_size, MSG_WAITALL);
-    if (bytes_read != static_cast<ssize_t>(header_size)) {
-        std::cerr << "Failed to read header" << std::endl;
-        return;
+    std::string header;
+    if (header_size & INTERNED_HEADER_FLAG) {
+        // Compact frame: reuse the header announced earlier on this connection
+        uint32_t stream_id = header_size & ~INTERNED_HEADER_FLAG;
+        auto it = interned_headers.find(stream_id);
+        if (it == interned_headers.end()) {
+            std::cerr << "Unknown stream id: " << stream_id << std::endl;
+            return false;
+        }
+        header = it->second;
+    } else {
+        if (header_size > 1024) {
+            std::cerr << "Header too large: " << header_size << std::endl;
+            return false;
+        }
+        
+        // Read header
+        header.assign(header_size, '\0');
+        bytes_read = recv(client_socket, &header[0], header_size, MSG_WAITALL);
+        if (bytes_read != static_cast<ssize_t>(header_size)) {
+            std::cerr << "Failed to read header" << std::endl;
+            return false;
+        }
+        
+        uint32_t stream_id;
+        if (parseStreamId(header, stream_id)) {
+            interned_headers[stream_id] = header;
+        }
     }
     
     // Read payload size (4 bytes)
@@ -130,7 +219,7 @@ void TCPServer::handleClient(int client_socket) {
     bytes_read = recv(client_socket, &payload_size, sizeof(payload_size), MSG_WAITALL);
     if (bytes_read != sizeof(payload_size)) {
         std::cerr << "Failed to read payload size" << std::endl;
-        return;
+        return false;
     }
     
     // Convert from network byte order
@@ -138,7 +227,7 @@ void TCPServer::handleClient(int client_socket) {
     
     if (payload_size > 1024 * 1024) {  // 1MB limit
         std::cerr << "Payload too large: " << payload_size << std::endl;
-        return;
+        return false;
     }
     
     // Read payload
@@ -146,14 +235,17 @@ void TCPServer::handleClient(int client_socket) {
     bytes_read = recv(client_socket, &payload[0], payload_size, MSG_WAITALL);
     if (bytes_read != static_cast<ssize_t>(payload_size)) {
         std::cerr << "Failed to read payload" << std::endl;
-        return;
+        return false;
     }
     
     std::cout << "Received - Header: " << header << std::endl;
     std::cout << "Received - Payload: " << payload << std::endl;
     
-    // Call callback if set
+    // Call callback if set; connections run on their own threads, so one at a time
     if (onDataReceived) {
+        std::lock_guard<std::mutex> lock(callback_mutex);
         onDataReceived(header, payload);
     }
+    
+    return true;
 }
\ No newline at end of file
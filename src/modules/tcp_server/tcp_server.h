@@ -2,28 +2,52 @@
 
 #include <thread>
 #include <atomic>
+#include <cstdint>
 #include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 class TCPServer {
 private:
+    struct ClientConnection {
+        int socket_fd;
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> finished;
+    };
+
     std::thread server_thread;
     std::atomic<bool> running;
     int port;
     int server_socket;
-    
+
+    std::mutex clients_mutex;
+    std::list<ClientConnection> client_connections;
+
+    // Serializes onDataReceived across connection threads
+    std::mutex callback_mutex;
+
     void serverLoop();
     void handleClient(int client_socket);
-    
+    bool handleFrame(int client_socket, std::unordered_map<uint32_t, std::string>& interned_headers);
+    void reapFinishedClients();
+
 public:
+    // Header size values with this bit set carry an interned stream id instead of a header
+    static constexpr uint32_t INTERNED_HEADER_FLAG = 0x80000000u;
+
     TCPServer(int port = 8080);
     ~TCPServer();
-    
+
     bool start();
     void stop();
     bool isRunning() const;
-    
+
     // Callback for when data is received
     // Parameters: header (JSON string), payload (raw data)
+    // Called on the thread of the connection the frame arrived on, but never
+    // for two frames at once
     std::function<void(const std::string&, const std::string&)> onDataReceived;
-};
\ No newline at end of file
+};
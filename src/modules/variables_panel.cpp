@@ -4,12 +4,14 @@
 #include <QFrame>
 
 VariablesPanel::VariablesPanel(PythonEngine *pythonEngine, QWidget *parent)
-    : QWidget(parent), pythonEngine(pythonEngine), autoUpdateEnabled(true)
+    : QWidget(parent), pythonEngine(pythonEngine), autoUpdateEnabled(true), refreshPending(false),
+      variablesVersion(0)
 {
     setupUI();
     setupConnections();
 
-    // Set up auto-update timer
+    // Set up auto-update timer; a tick only checks the engine's change flag,
+    // so an idle namespace costs nothing
     autoUpdateTimer = new QTimer(this);
     autoUpdateTimer->setInterval(1000); // 1 second
     connect(autoUpdateTimer, &QTimer::timeout, this, &VariablesPanel::onAutoUpdateTimer);
@@ -71,13 +73,43 @@ void VariablesPanel::updateVariables()
         return;
     }
 
-    std::vector<PythonVariable> variables = pythonEngine->getUserVariables();
-    populateVariablesList(variables);
+    // Collect on the interpreter thread and populate back on the UI thread, so a
+    // long-running command delays the refresh instead of freezing the window
+    if (refreshPending)
+        return;
+
+    // Nothing was bound, rebound or deleted since the last refresh
+    if (variablesVersion != 0 && !pythonEngine->hasVariableChanges())
+        return;
+
+    // Only entries that changed since the version on screen come back
+    PythonEngine *engine = pythonEngine;
+    uint64_t sinceVersion = variablesVersion;
+    refreshPending = engine->post([this, engine, sinceVersion]() {
+        PythonEngine::VariableDiff diff = engine->getVariableDiff(sinceVersion);
+        QMetaObject::invokeMethod(this, [this, engine, diff]() {
+            // Drop listings from a session the panel has since switched away from
+            if (engine != pythonEngine)
+                return;
+            refreshPending = false;
+            applyVariableDiff(diff);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void VariablesPanel::setPythonEngine(PythonEngine *pythonEngine, const QString &sessionName)
+{
+    this->pythonEngine = pythonEngine;
+    refreshPending = false;
+    variablesVersion = 0;
+    headerLabel->setText(sessionName == "main" ? QString("Variables") : QString("Variables (%1)").arg(sessionName));
+    updateVariables();
 }
 
 void VariablesPanel::populateVariablesList(const std::vector<PythonVariable> &variables)
 {
     variablesList->clear();
+    variableItems.clear();
 
     if (variables.empty())
     {
@@ -89,30 +121,73 @@ void VariablesPanel::populateVariablesList(const std::vector<PythonVariable> &va
 
     for (const PythonVariable &var : variables)
     {
-        QListWidgetItem *item = new QListWidgetItem(formatVariableDisplay(var));
+        QListWidgetItem *item = new QListWidgetItem();
+        fillVariableItem(item, var);
+        variablesList->addItem(item);
+        variableItems.insert(QString::fromStdString(var.name), item);
+    }
+}
+
+void VariablesPanel::applyVariableDiff(const PythonEngine::VariableDiff &diff)
+{
+    variablesVersion = diff.version;
+    if (diff.reset)
+    {
+        populateVariablesList(diff.changed);
+        return;
+    }
 
-        // Store variable data
-        item->setData(Qt::UserRole, QString::fromStdString(var.name));
-        item->setData(Qt::UserRole + 1, QString::fromStdString(var.value));
-        item->setData(Qt::UserRole + 2, QString::fromStdString(var.type));
+    for (const std::string &removedName : diff.removed)
+    {
+        delete variableItems.take(QString::fromStdString(removedName));
+    }
 
-        // Set tooltip with full information
-        QString tooltip = QString("Name: %1\nType: %2\nValue: %3")
-                              .arg(QString::fromStdString(var.name))
-                              .arg(QString::fromStdString(var.type))
-                              .arg(QString::fromStdString(var.value));
-        item->setToolTip(tooltip);
+    for (const PythonVariable &var : diff.changed)
+    {
+        QString name = QString::fromStdString(var.name);
+        QListWidgetItem *item = variableItems.value(name, nullptr);
+        if (!item)
+        {
+            // New names go last, as they do in the namespace
+            item = new QListWidgetItem();
+            variablesList->addItem(item);
+            variableItems.insert(name, item);
+        }
+        fillVariableItem(item, var);
+    }
+}
 
-        variablesList->addItem(item);
+void VariablesPanel::fillVariableItem(QListWidgetItem *item, const PythonVariable &var)
+{
+    item->setText(formatVariableDisplay(var));
+
+    // Store variable data
+    item->setData(Qt::UserRole, QString::fromStdString(var.name));
+    item->setData(Qt::UserRole + 1, QString::fromStdString(var.value));
+    item->setData(Qt::UserRole + 2, QString::fromStdString(var.type));
+
+    // Set tooltip with full information
+    QString tooltip = QString("Name: %1\nType: %2\nValue: %3")
+                          .arg(QString::fromStdString(var.name))
+                          .arg(QString::fromStdString(var.type))
+                          .arg(QString::fromStdString(var.value));
+    if (var.hasSummary)
+    {
+        tooltip += "\nSummary: " + formatSummary(var.summary);
     }
+    item->setToolTip(tooltip);
 }
 
 QString VariablesPanel::formatVariableDisplay(const PythonVariable &var)
 {
     QString display = QString::fromStdString(var.name) + ": " + QString::fromStdString(var.type);
 
-    // Add value if it's short enough
-    if (var.value.length() < 80)
+    // Large numeric containers read better as a summary than as a cut repr
+    if (var.hasSummary)
+    {
+        display += "  " + formatSummary(var.summary);
+    }
+    else if (var.value.length() < 80)
     {
         display += " = " + QString::fromStdString(var.value);
     }
@@ -120,6 +195,20 @@ QString VariablesPanel::formatVariableDisplay(const PythonVariable &var)
     return display;
 }
 
+QString VariablesPanel::formatSummary(const NumericSummary &summary)
+{
+    QString text = QString("len=%1 min=%2 max=%3 mean=%4")
+        .arg(static_cast<qulonglong>(summary.count))
+        .arg(summary.minimum, 0, 'g', 6)
+        .arg(summary.maximum, 0, 'g', 6)
+        .arg(summary.mean, 0, 'g', 6);
+    if (summary.nanCount > 0)
+    {
+        text += QString(" nan=%1").arg(static_cast<qulonglong>(summary.nanCount));
+    }
+    return text;
+}
+
 void VariablesPanel::setAutoUpdate(bool enabled, int intervalMs)
 {
     autoUpdateEnabled = enabled;
@@ -5,6 +5,7 @@
 #include <QLabel>
 #include <QListWidget>
 #include <QTimer>
+#include <QHash>
 #include "python_engine.h"
 
 class VariablesPanel : public QWidget {
@@ -15,6 +16,9 @@ public:
     
     void updateVariables();
     void setAutoUpdate(bool enabled, int intervalMs = 1000);
+    
+    // Show the variables of another session
+    void setPythonEngine(PythonEngine* pythonEngine, const QString& sessionName);
 
 public slots:
     void onVariablesChanged();
@@ -30,7 +34,10 @@ private:
     void setupUI();
     void setupConnections();
     void populateVariablesList(const std::vector<PythonVariable>& variables);
+    void applyVariableDiff(const PythonEngine::VariableDiff& diff);
+    void fillVariableItem(QListWidgetItem* item, const PythonVariable& var);
     QString formatVariableDisplay(const PythonVariable& var);
+    QString formatSummary(const NumericSummary& summary);
     
     PythonEngine* pythonEngine;
     QVBoxLayout* layout;
@@ -38,5 +45,9 @@ private:
     QListWidget* variablesList;
     QTimer* autoUpdateTimer;
     
+    QHash<QString, QListWidgetItem*> variableItems;
+    
     bool autoUpdateEnabled;
+    bool refreshPending;    // A variable listing is queued on the interpreter thread
+    uint64_t variablesVersion;  // Engine snapshot version the list reflects, 0 for none
 };
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "workspace_files.h"
+#include "settings_manager.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+namespace {
+
+bool isWritableDirectory(const QString& path) {
+    // Test write permissions by creating a temporary test file
+    QDir dir(path);
+    if (!dir.exists() && !dir.mkpath(path)) {
+        return false;
+    }
+    QFile file(path + "/.write_test");
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.close();
+    file.remove();
+    return true;
+}
+
+const QStringList fileFilters = {"*.pickle", "*.lumos"};
+
+QString withExtension(const QString& filename) {
+    return filename.endsWith(".pickle") || filename.endsWith(".lumos") ? filename : filename + ".pickle";
+}
+
+// Columnar files hold numeric arrays only, mapped on load
+PythonEngine::FileFormat formatOf(const QString& filename) {
+    return filename.endsWith(".lumos") ? PythonEngine::FileFormat::Columnar : PythonEngine::FileFormat::Pickle;
+}
+
+}  // namespace
+
+QString WorkspaceFiles::defaultDirectory(SettingsManager* settingsManager) {
+    // First priority: custom data_dir in the configuration
+    if (settingsManager && settingsManager->contains("data_dir")) {
+        QString customDir = settingsManager->getString("data_dir");
+        if (!customDir.isEmpty() && isWritableDirectory(customDir)) {
+            return customDir;
+        }
+    }
+    
+    // Second priority: the Documents directory
+    QString documentsPath = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
+    if (!documentsPath.isEmpty() && isWritableDirectory(documentsPath + "/LumosWorkspace")) {
+        return documentsPath + "/LumosWorkspace";
+    }
+    
+    return "/tmp/LumosWorkspace";
+}
+
+QStringList WorkspaceFiles::listFiles(const QString& directory) {
+    QStringList files;
+    for (const QFileInfo& info : QDir(directory).entryInfoList(fileFilters, QDir::Files, QDir::Time | QDir::Reversed)) {
+        files.append(info.fileName());
+    }
+    return files;
+}
+
+QString WorkspaceFiles::describeFiles(const QString& directory) {
+    QDir dir(directory);
+    if (!dir.exists()) {
+        return QString("No data directory found at: %1").arg(directory);
+    }
+    
+    QFileInfoList fileList = dir.entryInfoList(fileFilters, QDir::Files, QDir::Time | QDir::Reversed);
+    if (fileList.isEmpty()) {
+        return QString("No workspace files found in: %1").arg(directory);
+    }
+    
+    QString result = QString("Workspace files in %1:\n").arg(directory);
+    for (const QFileInfo& fileInfo : fileList) {
+        QString lastModified = fileInfo.lastModified().toString("yyyy-MM-dd hh:mm:ss");
+        result += QString("  %1 (%2, %3)\n").arg(fileInfo.fileName(), formatSize(fileInfo.size()), lastModified);
+    }
+    return result.trimmed();
+}
+
+void WorkspaceFiles::save(PythonEngine* engine, const QString& directory, const QStringList& arguments,
+                          PythonEngine::TransferProgress onProgress, Finished onFinished) {
+    if (!engine || !engine->isInitialized()) {
+        onFinished("Error: Python engine not initialized");
+        return;
+    }
+    if (arguments.size() > 2) {
+        onFinished("Error: Usage: save [variable] [filename]");
+        return;
+    }
+    
+    if (arguments.size() != 1) {
+        QString varName = arguments.size() == 2 ? arguments[0] : QString();
+        QString fileName = arguments.size() == 2 ? arguments[1] : QString();
+        startSave(engine, directory, varName, fileName, std::move(onProgress), std::move(onFinished));
+        return;
+    }
+    
+    // Whether the argument names a variable is only known on the interpreter
+    // thread; ask there instead of waiting for a running command here
+    QString argument = arguments[0];
+    bool posted = engine->post([engine, directory, argument, onProgress, onFinished]() {
+        bool isVariable = engine->hasVariable(argument.toStdString());
+        startSave(engine, directory, isVariable ? argument : QString(), isVariable ? QString() : argument,
+                  onProgress, onFinished);
+    });
+    if (!posted) {
+        onFinished("Error: Python engine not initialized");
+    }
+}
+
+void WorkspaceFiles::startSave(PythonEngine* engine, const QString& directory, const QString& varName,
+                               const QString& fileName, PythonEngine::TransferProgress onProgress, Finished onFinished) {
+    if (!QDir().mkpath(directory)) {
+        onFinished(QString("Error: Could not create directory %1").arg(directory));
+        return;
+    }
+    
+    // Use a timestamp, with a variable-specific prefix when saving one variable
+    QString filename = withExtension(fileName);
+    if (fileName.isEmpty()) {
+        QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss");
+        filename = varName.isEmpty() ? QString("saved_variables_%1.pickle").arg(timestamp)
+                                     : QString("saved_%1_%2.pickle").arg(varName, timestamp);
+    }
+    
+    std::vector<std::string> names;
+    if (!varName.isEmpty()) {
+        names.push_back(varName.toStdString());
+    }
+    PythonEngine::FileFormat format = formatOf(filename);
+    QString noun = format == PythonEngine::FileFormat::Columnar ? "arrays" : "variables";
+    bool started = engine->saveVariables(QDir(directory).filePath(filename).toStdString(), names, std::move(onProgress),
+        [varName, filename, noun, onFinished](bool ok, size_t count, const std::string& error) {
+            if (!ok) {
+                onFinished(QString::fromStdString(error));
+            } else if (!varName.isEmpty()) {
+                onFinished(QString("Saved variable \"%1\" to %2").arg(varName, filename));
+            } else {
+                onFinished(QString("Saved %1 %2 to %3").arg(count).arg(noun, filename));
+            }
+        }, format);
+    if (!started) {
+        onFinished("Error: A save or load is already running");
+    }
+}
+
+void WorkspaceFiles::load(PythonEngine* engine, const QString& directory, const QString& filename,
+                          PythonEngine::TransferProgress onProgress, Finished onFinished) {
+    if (!engine || !engine->isInitialized()) {
+        onFinished("Error: Python engine not initialized");
+        return;
+    }
+    
+    // Without an extension, a pickle file of that name comes first
+    QDir dir(directory);
+    QString actualFilename = withExtension(filename);
+    if (actualFilename != filename && !QFileInfo::exists(dir.filePath(actualFilename)) &&
+        QFileInfo::exists(dir.filePath(filename + ".lumos"))) {
+        actualFilename = filename + ".lumos";
+    }
+    QString fullPath = dir.filePath(actualFilename);
+    if (!QFileInfo::exists(fullPath)) {
+        onFinished(QString("Error: File not found: %1").arg(actualFilename));
+        return;
+    }
+    
+    bool started = engine->loadVariables(fullPath.toStdString(), std::move(onProgress),
+        [actualFilename, onFinished](bool ok, size_t count, const std::string& error) {
+            onFinished(ok ? QString("Loaded %1 variables from %2").arg(count).arg(actualFilename)
+                          : QString::fromStdString(error));
+        }, formatOf(actualFilename));
+    if (!started) {
+        onFinished("Error: A save or load is already running");
+    }
+}
+
+QString WorkspaceFiles::checkpointPath(const QString& directory) {
+    return directory + "/session.checkpoint";
+}
+
+QString WorkspaceFiles::previousCheckpointPath(const QString& directory) {
+    return directory + "/session.checkpoint.previous";
+}
+
+QString WorkspaceFiles::journalPath(const QString& directory) {
+    return directory + "/session.journal";
+}
+
+QString WorkspaceFiles::previousJournalPath(const QString& directory) {
+    return directory + "/session.journal.previous";
+}
+
+void WorkspaceFiles::restore(PythonEngine* engine, const QString& directory, Finished onFinished) {
+    if (!engine || !engine->isInitialized()) {
+        onFinished("Error: Python engine not initialized");
+        return;
+    }
+    QString path = previousCheckpointPath(directory);
+    if (!QFileInfo::exists(path)) {
+        onFinished("Error: No checkpoint from an earlier session");
+        return;
+    }
+    
+    bool started = engine->restoreCheckpoint(path.toStdString(),
+        [onFinished](bool ok, size_t count, const std::string& error) {
+            onFinished(ok ? QString("Restored %1 variables from the previous session").arg(count)
+                          : QString::fromStdString(error));
+        });
+    if (!started) {
+        onFinished("Error: A save or load is already running");
+    }
+}
+
+QString WorkspaceFiles::formatProgress(const QString& action, uint64_t bytes, uint64_t totalBytes) {
+    if (totalBytes == 0) {
+        return QString("%1 %2").arg(action, formatSize(static_cast<qint64>(bytes)));
+    }
+    return QString("%1 %2% of %3").arg(action).arg(bytes * 100 / totalBytes).arg(formatSize(static_cast<qint64>(totalBytes)));
+}
+
+QString WorkspaceFiles::formatSize(qint64 size) {
+    if (size < 1024) {
+        return QString("%1 B").arg(size);
+    } else if (size < 1024 * 1024) {
+        return QString("%1 KB").arg(size / 1024.0, 0, 'f', 1);
+    }
+    return QString("%1 MB").arg(size / (1024.0 * 1024.0), 0, 'f', 1);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include "python_engine.h"
+
+class SettingsManager;
+
+// The workspace files behind the 'save', 'load', 'restore' and 'ls' commands,
+// shared by the REPL and the debug API: .pickle for any variables, .lumos for
+// numeric arrays that load as views of the mapped file, and the session
+// checkpoints and journals. Saving and loading run on the engine's transfer thread; the
+// caller hears back through `onFinished`, on whichever thread finished the
+// work.
+class WorkspaceFiles {
+public:
+    using Finished = std::function<void(const QString& message)>;
+
+    // data_dir from the settings if it is writable, else Documents/LumosWorkspace,
+    // else /tmp/LumosWorkspace
+    static QString defaultDirectory(SettingsManager* settingsManager);
+
+    // Workspace file names in `directory`, oldest first
+    static QStringList listFiles(const QString& directory);
+    // The 'ls' listing with sizes and modification times
+    static QString describeFiles(const QString& directory);
+
+    // 'save' arguments: none saves every variable under a timestamped name;
+    // one is a variable if it is bound and a file name otherwise; two are a
+    // variable and a file name. File names are relative to `directory`
+    // unless absolute, for save and load alike.
+    static void save(PythonEngine* engine, const QString& directory, const QStringList& arguments,
+                     PythonEngine::TransferProgress onProgress, Finished onFinished);
+    static void load(PythonEngine* engine, const QString& directory, const QString& filename,
+                     PythonEngine::TransferProgress onProgress, Finished onFinished);
+
+    // The running session's checkpoint, and the one a session leaves behind,
+    // moved aside when the next one starts
+    static QString checkpointPath(const QString& directory);
+    static QString previousCheckpointPath(const QString& directory);
+    // The same for the session journal behind 'replay'
+    static QString journalPath(const QString& directory);
+    static QString previousJournalPath(const QString& directory);
+    // 'restore': bind what the previous session last checkpointed
+    static void restore(PythonEngine* engine, const QString& directory, Finished onFinished);
+    
+    // "Saving 12.0 MB" or "Loading 40% of 30.5 MB", for a status line
+    static QString formatProgress(const QString& action, uint64_t bytes, uint64_t totalBytes);
+
+private:
+    static QString formatSize(qint64 size);
+    static void startSave(PythonEngine* engine, const QString& directory, const QString& varName,
+                          const QString& fileName, PythonEngine::TransferProgress onProgress, Finished onFinished);
+};